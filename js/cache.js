@@ -0,0 +1,332 @@
+/*
+ * Chapter cache
+ * Holds chapter records, see chapterRecord(), within a budget of
+ * config.maxBytes and evicts the least recently used chapters beyond it.
+ * The cache is read from localStorage the first time it is used and
+ * written back shortly after it changes, together with its hit, miss and
+ * eviction counters. A hit only moves a chapter up the recency order,
+ * which is written back after config.idleSaveDelay unless a change writes
+ * it sooner.
+ * @param config Object with maxBytes, version, storageKey, saveDelay and
+ *               idleSaveDelay
+ */
+function ChapterCache(config) {
+
+    this.entries = null;
+    this.bytes = 0;
+    this.clock = 0;
+    this.counters = {hits: 0, misses: 0, evictions: 0};
+    this.saveTimer = null;
+    this.saveDue = 0;
+
+    /*
+     * Record for a chapter, or null on a miss
+     * @param key Book name followed by the chapter number
+     */
+    this.get = function(key) {
+        this.load();
+        var entry = this.entries[key];
+        if (typeof entry === 'undefined') {
+            this.counters.misses++;
+            return null;
+        }
+        this.counters.hits++;
+        entry.used = ++this.clock;
+        this.scheduleSave(config.idleSaveDelay);
+        return entry.record;
+    };
+
+    /*
+     * Record for a chapter, or null, leaving recency and counters alone
+     */
+    this.peek = function(key) {
+        this.load();
+        var entry = this.entries[key];
+        return typeof entry === 'undefined' ? null : entry.record;
+    };
+
+    /*
+     * Visit every cached chapter
+     * @param visit Called with the key and record of each chapter
+     */
+    this.each = function(visit) {
+        this.load();
+        for (var key in this.entries) {
+            visit(key, this.entries[key].record);
+        }
+    };
+
+    this.put = function(key, record) {
+        this.load();
+        this.remove(key);
+        var size = this.sizeOf(key, record);
+        if (size > config.maxBytes) {
+            return;
+        }
+        this.entries[key] = {record: record, size: size, used: ++this.clock};
+        this.bytes += size;
+        while (this.bytes > config.maxBytes) {
+            this.evictOldest();
+        }
+        this.scheduleSave(config.saveDelay);
+    };
+
+    this.remove = function(key) {
+        var entry = this.entries[key];
+        if (typeof entry !== 'undefined') {
+            this.bytes -= entry.size;
+            delete this.entries[key];
+        }
+    };
+
+    this.evictOldest = function() {
+        var oldest = null;
+        for (var key in this.entries) {
+            if (oldest === null || this.entries[key].used < this.entries[oldest].used) {
+                oldest = key;
+            }
+        }
+        if (oldest !== null) {
+            this.remove(oldest);
+            this.counters.evictions++;
+        }
+    };
+
+    /*
+     * Characters the record takes up once stored
+     */
+    this.sizeOf = function(key, record) {
+        return key.length + record.text.length + record.verses.length * 8 + 8;
+    };
+
+    this.load = function() {
+        if (this.entries !== null) {
+            return;
+        }
+        this.entries = {};
+        var stored = null;
+        try {
+            stored = JSON.parse(localStorage.getItem(config.storageKey));
+        } catch (e) {
+            logError('ERROR: Chapter cache unreadable, starting over', e);
+        }
+        if (stored === null || stored.version !== config.version) {
+            return;
+        }
+        this.counters = stored.counters || this.counters;
+        // stored oldest first, so the recency order survives
+        for (var i = 0; i < stored.chapters.length; i++) {
+            var chapter = stored.chapters[i];
+            var size = this.sizeOf(chapter[0], chapter[1]);
+            this.entries[chapter[0]] = {record: chapter[1], size: size, used: ++this.clock};
+            this.bytes += size;
+        }
+        while (this.bytes > config.maxBytes) {
+            this.evictOldest();
+        }
+        logDebug('Chapter cache loaded: ' + JSON.stringify(this.stats()));
+    };
+
+    /*
+     * Write the cache back in delay ms, or when a save already due sooner
+     */
+    this.scheduleSave = function(delay) {
+        var due = Date.now() + delay;
+        if (this.saveTimer !== null) {
+            if (this.saveDue <= due) {
+                return;
+            }
+            clearTimeout(this.saveTimer);
+        }
+        var self = this;
+        this.saveDue = due;
+        this.saveTimer = setTimeout(function() {
+            self.saveTimer = null;
+            self.save();
+        }, delay);
+    };
+
+    this.save = function() {
+        var self = this;
+        var keys = Object.keys(this.entries).sort(function(a, b) {
+            return self.entries[a].used - self.entries[b].used;
+        });
+        var chapters = [];
+        for (var i = 0; i < keys.length; i++) {
+            chapters.push([keys[i], this.entries[keys[i]].record]);
+        }
+        try {
+            localStorage.setItem(config.storageKey, JSON.stringify({version: config.version, counters: this.counters, chapters: chapters}));
+            logDebug('Chapter cache saved: ' + JSON.stringify(this.stats()));
+        } catch (e) {
+            // over the storage quota, make room and try again later
+            logError('ERROR: Failed saving chapter cache', e);
+            for (var j = 0; j < keys.length / 2; j++) {
+                this.evictOldest();
+            }
+            this.scheduleSave(config.saveDelay);
+        }
+    };
+
+    this.stats = function() {
+        this.load();
+        return {
+            chapters: Object.keys(this.entries).length,
+            bytes: this.bytes,
+            hits: this.counters.hits,
+            misses: this.counters.misses,
+            evictions: this.counters.evictions
+        };
+    };
+
+}
+
+/*
+ * Record of a chapter as returned by a passage provider, cleaned once on
+ * the way into the cache: the verses as one text of "<verse>) <text>\n"
+ * lines, the form PassageStream sends them in, along with the verse
+ * numbers and the offset of each line plus the end of the last one. Any
+ * range of verses is then a single substring, see recordSlice().
+ * @return Returns {verses, offsets, text}
+ */
+function chapterRecord(verses) {
+    var numbers = [];
+    var offsets = [];
+    var lines = [];
+    var offset = 0;
+    for (var i = 0; i < verses.length; i++) {
+        var number = parseInt(verses[i].verse, 10);
+        var line = number + ") " + cleanString(verses[i].text) + "\n";
+        numbers.push(number);
+        offsets.push(offset);
+        lines.push(line);
+        offset += line.length;
+    }
+    offsets.push(offset);
+    return {verses: numbers, offsets: offsets, text: lines.join('')};
+}
+
+/*
+ * Index in a record of a verse, or of the first verse after it. Verses
+ * almost always run on without gaps, so the first guess is usually it.
+ */
+function recordIndex(record, verse) {
+    var verses = record.verses;
+    var guess = verse - verses[0];
+    if (guess >= 0 && guess < verses.length && verses[guess] === verse) {
+        return guess;
+    }
+    var low = 0;
+    var high = verses.length;
+    while (low < high) {
+        var middle = (low + high) >> 1;
+        if (verses[middle] < verse) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/*
+ * Lines of the verses first to last, or to the end of the chapter if last
+ * is 0, without the final line break
+ */
+function recordSlice(record, first, last) {
+    var start = recordIndex(record, first);
+    var end = last ? recordIndex(record, last + 1) : record.verses.length;
+    if (end <= start) {
+        return '';
+    }
+    return record.text.substring(record.offsets[start], record.offsets[end] - 1);
+}
+
+/*
+ * Text of the verse at an index of the record, without its number
+ */
+function recordVerseAt(record, index) {
+    return record.text.substring(record.offsets[index] + String(record.verses[index]).length + 2, record.offsets[index + 1] - 1);
+}
+
+/*
+ * Text of a verse, or null if the chapter does not have it
+ */
+function recordVerse(record, verse) {
+    var index = recordIndex(record, verse);
+    return record.verses[index] === verse ? recordVerseAt(record, index) : null;
+}
+
+/*
+ * Verse lengths of every chapter seen so far, kept in localStorage apart
+ * from the chapter cache so verse ranges can be worked out again after a
+ * chapter has been evicted. A chapter's lengths are a flat array of verse
+ * number and byte length pairs, see verseLengthsOf().
+ * @param config Object with version, storageKey and saveDelay
+ */
+function VerseLengthTable(config) {
+
+    this.chapters = null;
+    this.saveTimer = null;
+
+    this.get = function(key) {
+        this.load();
+        return this.chapters.hasOwnProperty(key) ? this.chapters[key] : null;
+    };
+
+    /*
+     * Record the lengths of a chapter
+     * @param record Chapter record, see chapterRecord()
+     * @return Returns the lengths
+     */
+    this.put = function(key, record) {
+        this.load();
+        var lengths = verseLengthsOf(record);
+        this.chapters[key] = lengths;
+        this.scheduleSave();
+        return lengths;
+    };
+
+    this.load = function() {
+        if (this.chapters !== null) {
+            return;
+        }
+        this.chapters = {};
+        try {
+            var stored = JSON.parse(localStorage.getItem(config.storageKey));
+            if (stored !== null && stored.version === config.version) {
+                this.chapters = stored.chapters;
+            }
+        } catch (e) {
+            logError('ERROR: Verse lengths unreadable, starting over', e);
+        }
+    };
+
+    this.scheduleSave = function() {
+        if (this.saveTimer !== null) {
+            return;
+        }
+        var self = this;
+        this.saveTimer = setTimeout(function() {
+            self.saveTimer = null;
+            try {
+                localStorage.setItem(config.storageKey, JSON.stringify({version: config.version, chapters: self.chapters}));
+            } catch (e) {
+                logError('ERROR: Failed saving verse lengths', e);
+            }
+        }, config.saveDelay);
+    };
+
+}
+
+/*
+ * Verse numbers and the bytes each verse takes up in a passage stream,
+ * one line of "<verse>) <text>", see PassageStream
+ */
+function verseLengthsOf(record) {
+    var lengths = [];
+    for (var i = 0; i < record.verses.length; i++) {
+        lengths.push(record.verses[i], utf8Length(record.text.substring(record.offsets[i], record.offsets[i + 1])));
+    }
+    return lengths;
+}
@@ -19,19 +19,49 @@ function Favorite(jsonObject) {
     this.asJSONObject = function() {
         return {book: this.book, chapter: this.chapter, range: this.range};
     };
+
+    /*
+     * Key identifying the passage, equal favorites have equal keys
+     */
+    this.key = function() {
+        return this.book + ' ' + this.chapter + ':' + this.range;
+    };
     
 }
 
-function FavoriteList() {
+/*
+ * Favorites keyed by passage, kept in the order they were added. Every
+ * change bumps the revision and is logged as [revision, op, book, chapter,
+ * range], op being '+' or '-', so the watch's mirror can be brought up to
+ * date with just the changes it missed. The last config.maxChanges are
+ * kept. Changes are written to localStorage together, config.saveDelay ms
+ * after the first one, as {version, revision, favorites: [[book, chapter,
+ * range], ...], changes}.
+ * @param config Object with version, storageKey, legacyKey, saveDelay and
+ *               maxChanges
+ */
+function FavoriteList(config) {
     
-    this.favorites = [];
+    // insertion ordered, keys are never array indices
+    this.favorites = {};
+    this.size = 0;
+    this.ordered = null;
+    this.saveTimer = null;
+    this.revision = 0;
+    this.changes = [];
     
     this.count = function() {
-        return this.favorites.length;
+        return this.size;
     };
     
     this.favoriteAtIndex = function(index) {
-        return this.favorites[index];
+        if (this.ordered === null) {
+            this.ordered = [];
+            for (var key in this.favorites) {
+                this.ordered.push(this.favorites[key]);
+            }
+        }
+        return this.ordered[index];
     };
     
     /*
@@ -40,13 +70,7 @@ function FavoriteList() {
      * @return Returns true if favorite exists
      */
     this.contains = function (aFavorite) {
-        for (var i = 0; i < this.favorites.length; i++) {
-            var favorite = this.favorites[i];
-            if (favorite.isEqual(aFavorite)) {
-                return true;
-            }
-        }
-        return false;
+        return this.favorites.hasOwnProperty(aFavorite.key());
     };
     
     /*
@@ -58,11 +82,9 @@ function FavoriteList() {
         if (this.contains(aFavorite)) {
             return false;
         }
-        else {
-            this.favorites.push(aFavorite);
-            this.save();
-            return true;
-        }
+        this.insert(aFavorite);
+        this.logChange('+', aFavorite);
+        return true;
     };
 
     /*
@@ -71,52 +93,124 @@ function FavoriteList() {
      * @return Returns true if removed or false if it never existed
      */
     this.remove = function(aFavorite) {
-        
-        var favoriteIndex = -1;
-        for (var i = 0; i < this.favorites.length; i++) {
-            var favorite = this.favorites[i];
-            if (favorite.isEqual(aFavorite)) {
-                favoriteIndex = i;
-                break;
+        if (!this.contains(aFavorite)) {
+            return false;
+        }
+        delete this.favorites[aFavorite.key()];
+        this.size--;
+        this.ordered = null;
+        this.logChange('-', aFavorite);
+        return true;
+    };
+
+    this.logChange = function(op, aFavorite) {
+        this.revision++;
+        this.changes.push([this.revision, op, aFavorite.book, aFavorite.chapter, aFavorite.range]);
+        if (this.changes.length > config.maxChanges) {
+            this.changes.shift();
+        }
+        this.scheduleSave();
+    };
+
+    /*
+     * The net changes made after a revision, at most one per passage, so
+     * they can be applied in any order
+     * @return Returns the changes, or null if they are not all logged
+     */
+    this.changesSince = function(revision) {
+        var first = this.changes.length - (this.revision - revision);
+        if (revision > this.revision || first < 0) {
+            return null;
+        }
+        var latest = {};
+        for (var i = first; i < this.changes.length; i++) {
+            var change = this.changes[i];
+            latest[change[2] + ' ' + change[3] + ':' + change[4]] = i;
+        }
+        var changes = [];
+        for (var j = first; j < this.changes.length; j++) {
+            var key = this.changes[j][2] + ' ' + this.changes[j][3] + ':' + this.changes[j][4];
+            if (latest[key] === j) {
+                changes.push(this.changes[j]);
             }
         }
-        if (i > -1) {
-            this.favorites.splice(favoriteIndex, 1);
-            this.save();
-            return true;
-        } else {
-            return false;
+        return changes;
+    };
+
+    this.insert = function(aFavorite) {
+        this.favorites[aFavorite.key()] = aFavorite;
+        this.size++;
+        if (this.ordered !== null) {
+            this.ordered.push(aFavorite);
         }
     };
     
+    this.scheduleSave = function() {
+        if (this.saveTimer !== null) {
+            return;
+        }
+        var self = this;
+        this.saveTimer = setTimeout(function() {
+            self.saveTimer = null;
+            self.save();
+        }, config.saveDelay);
+    };
+
     /*
      * Saves the favorite list to persistent storage
      */
     this.save = function() {
-        var jsonFavorites = [];
-        for (var i = 0; i < this.favorites.length; i++) {
-            var favorite = this.favorites[i];
-            jsonFavorites.push(favorite.asJSONObject());
+        var rows = [];
+        for (var key in this.favorites) {
+            var favorite = this.favorites[key];
+            rows.push([favorite.book, favorite.chapter, favorite.range]);
+        }
+        try {
+            localStorage.setItem(config.storageKey, JSON.stringify({version: config.version, revision: this.revision, favorites: rows, changes: this.changes}));
+            localStorage.removeItem(config.legacyKey);
+        } catch (e) {
+            logError('ERROR: Failed saving favorites', e);
         }
-        localStorage.setItem('favoriteList', JSON.stringify(jsonFavorites));
     };
 
     /*
-     * Reloads the favorite list from persistent storage
+     * Reloads the favorite list from persistent storage, reading the array
+     * of objects older versions stored if there is nothing newer. Nothing is
+     * written back until the list changes.
      */
     this.reload = function() {
+        this.favorites = {};
+        this.size = 0;
+        this.ordered = null;
         try {
-            var jsonFavorites = JSON.parse(localStorage.getItem('favoriteList')) || [];
-            for (var i = 0; i < jsonFavorites.length; i++) {
-                var favorite = new Favorite(jsonFavorites[i]);
-                this.add(favorite);
+            var stored = JSON.parse(localStorage.getItem(config.storageKey));
+            if (stored !== null && stored.version === config.version) {
+                for (var i = 0; i < stored.favorites.length; i++) {
+                    var row = stored.favorites[i];
+                    this.insertIfNew(new Favorite({book: row[0], chapter: row[1], range: row[2]}));
+                }
+                this.revision = stored.revision;
+                this.changes = stored.changes;
+                return;
             }
+            var jsonFavorites = JSON.parse(localStorage.getItem(config.legacyKey)) || [];
+            for (var j = 0; j < jsonFavorites.length; j++) {
+                this.insertIfNew(new Favorite(jsonFavorites[j]));
+            }
+            // a list with no logged history, the watch gets all of it
+            this.revision = this.size > 0 ? 1 : 0;
         }
         catch (e) {
             // catch SyntaxError: Unexpected end of input for dirty
             logError(e);
         }
     };
+
+    this.insertIfNew = function(aFavorite) {
+        if (!this.contains(aFavorite)) {
+            this.insert(aFavorite);
+        }
+    };
     
     this.reload();
 }
@@ -0,0 +1,139 @@
+/*
+ * LZSS codec in the same format as src/lz.c: groups of a flag byte followed
+ * by 8 items, most significant flag bit first. A set bit is a literal byte,
+ * a clear bit a 2 byte match holding a 9 bit distance and a 7 bit length
+ * into the last LZ_WINDOW_SIZE bytes. Both ends start with LZ_DICTIONARY,
+ * generated from data/lz-dictionary.txt, in the window. Data is a binary
+ * string, one byte per character.
+ */
+var LZ_WINDOW_SIZE = 512;
+var LZ_MIN_MATCH = 3;
+var LZ_MAX_MATCH = LZ_MIN_MATCH + 127;
+var LZ_HASH_SIZE = 4096;
+var LZ_MAX_CHAIN = 32;
+
+/*
+ * Compress bytes. Candidate matches are found through hash chains over the
+ * window, so large inputs compress in linear time.
+ * @param bytes Binary string
+ * @return Returns the compressed binary string
+ */
+function lzEncode(bytes) {
+    var start = LZ_DICTIONARY.length;
+    bytes = LZ_DICTIONARY + bytes;
+    var length = bytes.length;
+    var head = new Int32Array(LZ_HASH_SIZE);
+    var prev = new Int32Array(LZ_WINDOW_SIZE);
+    var out = [];
+    var flagIndex = 0;
+    var items = 8;
+    var i;
+
+    for (i = 0; i < LZ_HASH_SIZE; i++) {
+        head[i] = -1;
+    }
+
+    var hash = function(position) {
+        return ((bytes.charCodeAt(position) << 6) ^ (bytes.charCodeAt(position + 1) << 3) ^ bytes.charCodeAt(position + 2)) & (LZ_HASH_SIZE - 1);
+    };
+    var insert = function(position) {
+        if (position + LZ_MIN_MATCH <= length) {
+            var h = hash(position);
+            prev[position % LZ_WINDOW_SIZE] = head[h];
+            head[h] = position;
+        }
+    };
+
+    for (i = 0; i < start; i++) {
+        insert(i);
+    }
+    while (i < length) {
+        if (items === 8) {
+            flagIndex = out.length;
+            out.push(0);
+            items = 0;
+        }
+
+        var bestLength = 0;
+        var bestDistance = 0;
+        if (i + LZ_MIN_MATCH <= length) {
+            var maxLength = Math.min(LZ_MAX_MATCH, length - i);
+            var candidate = head[hash(i)];
+            var tries = LZ_MAX_CHAIN;
+            while (candidate >= 0 && i - candidate <= LZ_WINDOW_SIZE && tries-- > 0) {
+                var n = 0;
+                while (n < maxLength && bytes.charCodeAt(candidate + n) === bytes.charCodeAt(i + n)) {
+                    n++;
+                }
+                if (n > bestLength) {
+                    bestLength = n;
+                    bestDistance = i - candidate;
+                    if (n === maxLength) {
+                        break;
+                    }
+                }
+                var next = prev[candidate % LZ_WINDOW_SIZE];
+                if (next >= candidate) {
+                    break;
+                }
+                candidate = next;
+            }
+        }
+
+        if (bestLength >= LZ_MIN_MATCH) {
+            out.push((bestDistance - 1) >> 1, (((bestDistance - 1) & 1) << 7) | (bestLength - LZ_MIN_MATCH));
+            for (var j = 0; j < bestLength; j++) {
+                insert(i + j);
+            }
+            i += bestLength;
+        } else {
+            out[flagIndex] |= 0x80 >> items;
+            out.push(bytes.charCodeAt(i));
+            insert(i);
+            i++;
+        }
+        items++;
+    }
+    return lzBytesToString(out);
+}
+
+/*
+ * Decompress what lzEncode() or the watch produced
+ * @param data Compressed binary string
+ * @return Returns the original binary string
+ */
+function lzDecode(data) {
+    var out = [];
+    var i;
+    for (i = 0; i < LZ_DICTIONARY.length; i++) {
+        out.push(LZ_DICTIONARY.charCodeAt(i));
+    }
+    i = 0;
+    while (i < data.length) {
+        var flags = data.charCodeAt(i++);
+        for (var bit = 0; bit < 8 && i < data.length; bit++) {
+            if (flags & (0x80 >> bit)) {
+                out.push(data.charCodeAt(i++));
+                continue;
+            }
+            if (i + 1 >= data.length) {
+                break;
+            }
+            var high = data.charCodeAt(i++);
+            var low = data.charCodeAt(i++);
+            var distance = ((high << 1) | (low >> 7)) + 1;
+            for (var n = (low & 0x7F) + LZ_MIN_MATCH; n > 0; n--) {
+                out.push(out[out.length - distance]);
+            }
+        }
+    }
+    return lzBytesToString(out).substring(LZ_DICTIONARY.length);
+}
+
+function lzBytesToString(codes) {
+    var pieces = [];
+    for (var i = 0; i < codes.length; i += 4096) {
+        pieces.push(String.fromCharCode.apply(null, codes.slice(i, i + 4096)));
+    }
+    return pieces.join('');
+}
@@ -0,0 +1,67 @@
+/*
+ * Text of a passage as UTF-8 bytes, so the watch can ask for any byte window
+ * of it and get back exactly the bytes it laid out before. A range with an
+ * open end ("5-") keeps reading the following chapters of the book, each
+ * introduced by a heading line, and only fetches them as the watch reads on.
+ * @param book Book name
+ * @param chapter First chapter
+ * @param range Verse range within the first chapter, e.g. "1-15" or "1-"
+ */
+function PassageStream(book, chapter, range) {
+
+    var bounds = range.split("-");
+    this.book = book;
+    this.nextChapter = parseInt(chapter, 10);
+    this.firstVerse = parseInt(bounds[0], 10) || 1;
+    this.lastVerse = bounds.length > 1 && bounds[1] !== '' ? parseInt(bounds[1], 10) : 0;
+    this.bytes = '';
+    this.complete = false;
+
+    /*
+     * Read a window of the passage
+     * @param token Request token, used to report fetch errors
+     * @param offset Byte offset of the window, on a character boundary
+     * @param length Maximum number of bytes to return
+     * @param completion Called with the bytes and whether they end the passage
+     */
+    this.read = function(token, offset, length, completion) {
+        var self = this;
+        if (this.complete || this.bytes.length >= offset + length) {
+            var end = Math.min(offset + length, this.bytes.length);
+            if (end < this.bytes.length) {
+                end = utf8Boundary(this.bytes, end);
+            }
+            completion(this.bytes.substring(offset, end), this.complete && end === this.bytes.length);
+            return;
+        }
+        this.loadNextChapter(token, function() {
+            self.read(token, offset, length, completion);
+        });
+    };
+
+    this.loadNextChapter = function(token, completion) {
+        var self = this;
+        var chapter = this.nextChapter;
+        getVerseText(token, this.book, chapter, function(response) {
+            if (self.nextChapter !== chapter) {
+                // another read already appended this chapter
+                completion();
+                return;
+            }
+            // one verse per line, the watch lays out and measures whole lines as blocks
+            var text = recordSlice(response, self.firstVerse, self.lastVerse);
+            if (self.bytes.length > 0) {
+                text = "\n" + self.book + " " + chapter + "\n" + text;
+            }
+            self.bytes += toUtf8Bytes(text);
+            self.nextChapter++;
+            self.firstVerse = 1;
+            var book = findBook(self.book);
+            if (self.lastVerse || book === null || self.nextChapter > book.chapters) {
+                self.complete = true;
+            }
+            completion();
+        });
+    };
+
+}
@@ -1,5 +1,3 @@
-var appMessageQueues = {};
-
 var DEBUG = true;
 var logDebug = function() {
     if (DEBUG) {
@@ -15,22 +13,68 @@ var options = {
 	appMessage: {
 		maxTries: 3,
 		retryTimeout: 3000,
-		timeout: 100,
-		packetLength: 80,
-        verseBatch: 15
+		minRetryTimeout: 250,
+		initialWindow: 2,
+		maxWindow: 8,
+		inboxSize: 128,
+		maxCancelled: 32,
+		compress: true,
+        rangeBytes: 2048,
+        passageStreams: 4
 	},
 	http: {
-		timeout: 20000
+		timeout: 20000,
+		maxConcurrent: 2,
+		maxBatchChapters: 3
+	},
+	prefetch: {
+		idleDelay: 500
+	},
+	offline: {
+		packUrl: '',
+		version: 2
+	},
+	cache: {
+		maxBytes: 512 * 1024,
+		version: 2,
+		storageKey: 'chapterCache',
+		saveDelay: 2000,
+		idleSaveDelay: 60000
+	},
+	favorites: {
+		version: 1,
+		storageKey: 'favorites',
+		legacyKey: 'favoriteList',
+		saveDelay: 500,
+		maxChanges: 64
+	},
+	verseLengths: {
+		version: 1,
+		storageKey: 'verseLengths',
+		saveDelay: 2000
+	},
+	search: {
+		maxResults: 16,
+		minWordLength: 2,
+		snippetBytes: 40
+	},
+	startup: {
+		warmFavorites: 3
 	}
 };
 
+// Bump together with PROTOCOL_VERSION in src/common.h
+var PROTOCOL_VERSION = 1;
+
 var MessageType = {
 	Book: 0,
     Verses: 1,
     Favorites: 2,
 	Viewer: 3,
 	FavoritesDidChange: 4,
-	PebbleJSInitialized: 5
+	PebbleJSInitialized: 5,
+	NextPassage: 6,
+	Search: 7
 };
 
 var Request = {
@@ -39,145 +83,370 @@ var Request = {
     Viewer: 2,
     Cancel: 3,
     Favorites: 4,
-    ToggleFavorite: 5
+    ToggleFavorite: 5,
+    Configure: 6,
+    NextPassage: 7,
+    Search: 8
 };
 
-// Bible structure
-var bible = [];
-bible.push([{"name":"Genesis","chapters":50},{"name":"Exodus","chapters":40},{"name":"Leviticus","chapters":27},{"name":"Numbers","chapters":36},{"name":"Deuteronomy","chapters":34},{"name":"Joshua","chapters":24},{"name":"Judges","chapters":21},{"name":"Ruth","chapters":4},{"name":"1 Samuel","chapters":31},{"name":"2 Samuel","chapters":24},{"name":"1 Kings","chapters":22},{"name":"2 Kings","chapters":25},{"name":"1 Chronicles","chapters":29},{"name":"2 Chronicles","chapters":36},{"name":"Ezra","chapters":10},{"name":"Nehemiah","chapters":13},{"name":"Esther","chapters":10},{"name":"Job","chapters":42},{"name":"Psalms","chapters":150},{"name":"Proverbs","chapters":31},{"name":"Ecclesiastes","chapters":12},{"name":"Song of Solomon","chapters":8},{"name":"Isaiah","chapters":66},{"name":"Jeremiah","chapters":52},{"name":"Lamentations","chapters":5},{"name":"Ezekiel","chapters":48},{"name":"Daniel","chapters":12},{"name":"Hosea","chapters":14},{"name":"Joel","chapters":3},{"name":"Amos","chapters":9},{"name":"Obadiah","chapters":1},{"name":"Jonah","chapters":4},{"name":"Micah","chapters":7},{"name":"Nahum","chapters":3},{"name":"Habakkuk","chapters":3},{"name":"Zephaniah","chapters":3},{"name":"Haggai","chapters":2},{"name":"Zechariah","chapters":14},{"name":"Malachi","chapters":4}]);
-bible.push([{"name":"Matthew","chapters":28},{"name":"Mark","chapters":16},{"name":"Luke","chapters":24},{"name":"John","chapters":21},{"name":"Acts","chapters":28},{"name":"Romans","chapters":16},{"name":"1 Corinthians","chapters":16},{"name":"2 Corinthians","chapters":13},{"name":"Galatians","chapters":6},{"name":"Ephesians","chapters":6},{"name":"Philippians","chapters":4},{"name":"Colossians","chapters":4},{"name":"1 Thessalonians","chapters":5},{"name":"2 Thessalonians","chapters":3},{"name":"1 Timothy","chapters":6},{"name":"2 Timothy","chapters":4},{"name":"Titus","chapters":3},{"name":"Philemon","chapters":1},{"name":"Hebrews","chapters":13},{"name":"James","chapters":5},{"name":"1 Peter","chapters":5},{"name":"2 Peter","chapters":3},{"name":"1 John","chapters":5},{"name":"2 John","chapters":1},{"name":"3 John","chapters":1},{"name":"Jude","chapters":1},{"name":"Revelation","chapters":22}]);
-
-var bibleCache = {};
-
-var favoriteList = new FavoriteList();
-
-function sendAppMessageQueue(token) {
-	if (typeof appMessageQueues[token] != 'undefined' && appMessageQueues[token].length > 0) {
-		currentAppMessage = appMessageQueues[token][0];
-		currentAppMessage.numTries = currentAppMessage.numTries || 0;
-		currentAppMessage.transactionId = currentAppMessage.transactionId || -1;
-		if (currentAppMessage.numTries < options.appMessage.maxTries) {
-			logDebug('Sending AppMessage to Pebble: ' + JSON.stringify(currentAppMessage.message) + ', tries: ' + currentAppMessage.numTries);
-			Pebble.sendAppMessage(
-				currentAppMessage.message,
-				function(e) {
-				    if (typeof appMessageQueues[token] === 'undefined') {
-				        return;
-				    }	
-					appMessageQueues[token].shift();
-					setTimeout(function() {
-						sendAppMessageQueue(token);
-					}, options.appMessage.timeout);
-				}, function(e) {
-					logError('ERROR: Failed sending AppMessage', e);
-					appMessageQueues[token][0].transactionId = e.data.transactionId;
-					appMessageQueues[token][0].numTries++;
-					setTimeout(function() {
-						sendAppMessageQueue(token);
-					}, options.appMessage.retryTimeout);
-				}
-			);
-		} else {
-			logError('ERROR: Failed sending AppMessage for transactionId:' + currentAppMessage.transactionId + '. Bailing. ' + JSON.stringify(currentAppMessage.message));
+// Separators for several rows packed into one content string
+var ROW_SEPARATOR = String.fromCharCode(0x1e);
+var FIELD_SEPARATOR = String.fromCharCode(0x1f);
+
+var bibleCache = new ChapterCache(options.cache);
+var verseLengths = new VerseLengthTable(options.verseLengths);
+var passageStreams = [];
+var pendingChapters = {};
+var idleTasks = {};
+var linkCompression = false;
+var rangeBytes = options.appMessage.rangeBytes;
+var readyTime = 0;
+var watchInfo = null;
+
+var favoriteList = new FavoriteList(options.favorites);
+
+var transport = new AppMessageTransport(options.appMessage);
+
+var httpProvider = new HttpProvider(options.http);
+var offlineProvider = new OfflineProvider(options.offline);
+
+var searchIndex = new SearchIndex(options.search);
+
+function sendRows(token, messageType, rows) {
+	transport.send(token, packRows(token, messageType, rows, {}));
+}
+
+/*
+ * Pack rows of fields into as few messages as fit the watch inbox. Each
+ * message carries the index of its first row and a copy of extra.
+ */
+function packRows(token, messageType, rows, extra) {
+	var messages = [];
+	var message = null;
+	var budget = 0;
+	for (var i = 0; i < rows.length; i++) {
+		var row = rows[i].join(FIELD_SEPARATOR);
+		var rowLength = utf8Length(row);
+		if (message !== null && rowLength + 1 <= budget) {
+			message.content += ROW_SEPARATOR + row;
+			budget -= rowLength + 1;
+			continue;
 		}
+		message = {
+			'token': token,
+			'messageType': messageType,
+			'index': i
+		};
+		copyFields(extra, message);
+		budget = transport.contentBudget(message) - rowLength;
+		message.content = row;
+		messages.push(message);
 	}
-	else
-	{
-		delete appMessageQueues[token];
+	if (messages.length === 0) {
+		message = {
+			'token': token,
+			'messageType': messageType
+		};
+		copyFields(extra, message);
+		messages.push(message);
 	}
+	return messages;
 }
 
-function cancelAppMessageQueue(token) {
-	appMessageQueues[token.toString()] = [];
-}
-
-function sendBooksForTestament(testament, token) {
-	var books = bible[testament];
-	appMessageQueues[token.toString()] = [];
-	for (var i = 0; i < books.length; i++) {
-		appMessageQueues[token.toString()].push({'message': {
-			'token': token,
-			'messageType': MessageType.Book,
-			'index': i,
-			'book': books[i].name,
-			'chapter': books[i].chapters
-		}});
+function copyFields(from, to) {
+	for (var key in from) {
+		to[key] = from[key];
 	}
-	sendAppMessageQueue(token.toString());
 }
 
 // API requests
 
 function requestVerseRanges(book, chapter, token) {
-  getVerseText(token, book, chapter, function(response) {
-    var batches = Math.ceil(response.length / options.appMessage.verseBatch);
-    appMessageQueues[token.toString()] = [];
-    for (var i = 0; i < batches; i++)
-    {
-     var batchName = ((i * options.appMessage.verseBatch) + 1).toString() + "-" + (Math.min((i + 1) * options.appMessage.verseBatch, response.length)).toString();
-      appMessageQueues[token.toString()].push({'message': {
-        'token': token,
-        'messageType': MessageType.Verses,
-        'index': i,
-        'content': batchName
-      }});
+  chapterRanges(token, book, chapter, function(ranges) {
+    var rows = [];
+    for (var i = 0; i < ranges.length; i++) {
+      rows.push([ranges[i]]);
     }
-    sendAppMessageQueue(token.toString());
+    sendRows(token, MessageType.Verses, rows);
   });
 }
 
-function requestFavorites(token) {
-    appMessageQueues[token.toString()] = [];
-    if (favoriteList.count() > 0) {
-        for (var i = 0; i < favoriteList.count(); i++) {
-            var favorite = favoriteList.favoriteAtIndex(i);
-            appMessageQueues[token.toString()].push({'message': {
-                'token': token,
-                'messageType': MessageType.Favorites,
-                'index': i,
-                'book': favorite.book,
-                'chapter': favorite.chapter,
-                'range': favorite.range,
-            }});
+/*
+ * The verse ranges a chapter is split into for the verses list, from the
+ * verse lengths when they are known and the chapter text otherwise
+ * @param completion Called with the ranges, see verseRanges()
+ */
+function chapterRanges(token, book, chapter, completion) {
+    var lengths = verseLengths.get(book + chapter);
+    if (lengths !== null) {
+        completion(verseRanges(lengths, rangeBytes));
+        return;
+    }
+    getVerseText(token, book, chapter, function(response) {
+        completion(verseRanges(verseLengths.put(book + chapter, response), rangeBytes));
+    });
+}
+
+/*
+ * Cut a chapter into ranges of whole verses of at most budget bytes of
+ * passage text each. A verse longer than the budget is a range of its own.
+ * @param lengths Verse numbers and byte lengths, see verseLengthsOf()
+ */
+function verseRanges(lengths, budget) {
+    var ranges = [];
+    var first = 0;
+    var bytes = 0;
+    for (var i = 0; i < lengths.length; i += 2) {
+        if (bytes > 0 && bytes + lengths[i + 1] > budget) {
+            ranges.push(first + "-" + lengths[i - 2]);
+            bytes = 0;
+        }
+        if (bytes === 0) {
+            first = lengths[i];
         }
+        bytes += lengths[i + 1];
     }
-    else {
-        appMessageQueues[token.toString()].push({'message': {
-            'token': token,
-            'messageType': MessageType.Favorites
-        }});
+    if (bytes > 0) {
+        ranges.push(first + "-" + lengths[lengths.length - 2]);
     }
-    sendAppMessageQueue(token.toString());
+    return ranges;
 }
 
-function requestVerseText(book, chapter, rangeString, token) {
-  var range = rangeString.split("-");
-  getVerseText(token, book, chapter, function(response) {
-    var verseText = "";
-    for (var i in response)
-    {
-      if (parseInt(response[i].verse) >= parseInt(range[0]) && parseInt(response[i].verse) <= parseInt(range[1]))
-      {
-        verseText += response[i].verse + ") " + response[i].text + " ";
-      }
+/*
+ * The chapter after the given one, moving on to the next book at the end of
+ * a book
+ * @return Returns {book, chapter}, or null after the last chapter
+ */
+function chapterAfter(book, chapter) {
+    var info = findBook(book);
+    if (info === null) {
+        return null;
+    }
+    if (chapter < info.chapters) {
+        return {book: book, chapter: chapter + 1};
+    }
+    var books = bible[0].concat(bible[1]);
+    for (var i = 0; i < books.length - 1; i++) {
+        if (books[i].name === book) {
+            return {book: books[i + 1].name, chapter: 1};
+        }
+    }
+    return null;
+}
+
+/*
+ * Resolve the passage that follows a range: the next range of the verses
+ * list in the same chapter, otherwise the first range of the next chapter.
+ * An open ended range continues with the whole of the next chapter.
+ * @param completion Called with {book, chapter, range}, or null at the end
+ */
+function nextPassage(token, book, chapter, range, completion) {
+    chapter = parseInt(chapter, 10);
+    var bounds = range.split("-");
+    var openEnded = bounds.length > 1 && bounds[1] === '';
+    var next = chapterAfter(book, chapter);
+
+    if (openEnded) {
+        completion(next === null ? null : {book: next.book, chapter: next.chapter, range: range.replace(/^\d+/, '1')});
+        return;
+    }
+
+    var lastVerse = parseInt(bounds[bounds.length - 1], 10);
+    chapterRanges(token, book, chapter, function(ranges) {
+        for (var i = 0; i < ranges.length; i++) {
+            if (parseInt(ranges[i], 10) > lastVerse) {
+                completion({book: book, chapter: chapter, range: ranges[i]});
+                return;
+            }
+        }
+        if (next === null) {
+            completion(null);
+            return;
+        }
+        chapterRanges(token, next.book, next.chapter, function(nextRanges) {
+            completion({book: next.book, chapter: next.chapter, range: nextRanges[0]});
+        });
+    });
+}
+
+function requestNextPassage(book, chapter, range, token) {
+    nextPassage(token, book, chapter, range, function(passage) {
+        var message = {'token': token, 'messageType': MessageType.NextPassage};
+        if (passage !== null) {
+            message.book = passage.book;
+            message.chapter = passage.chapter;
+            message.range = passage.range;
+        }
+        transport.send(token, [message]);
+    });
+}
+
+/*
+ * Fetch whatever the passage after this one needs into bibleCache, so the
+ * next passage gesture is answered without going to the network. Only the
+ * latest prefetch is kept and it waits for foreground traffic to finish.
+ */
+function prefetchNextPassage(book, chapter, range) {
+    runWhenIdle('prefetch', function() {
+        nextPassage(0, book, chapter, range, function(passage) {
+            if (passage !== null) {
+                runWhenIdle('prefetch', function() {
+                    getVerseText(0, passage.book, passage.chapter, function() {});
+                });
+            }
+        });
+    });
+}
+
+/*
+ * Run background work once nothing is being sent to the watch or fetched
+ * for it. A task replaces whatever is still waiting under the same name.
+ */
+function runWhenIdle(name, task) {
+    var scheduled = idleTasks.hasOwnProperty(name);
+    idleTasks[name] = task;
+    if (scheduled) {
+        return;
     }
+    var poll = function() {
+        if (!transport.isIdle() || httpProvider.inFlight > 0) {
+            setTimeout(poll, options.prefetch.idleDelay);
+            return;
+        }
+        var next = idleTasks[name];
+        delete idleTasks[name];
+        next();
+    };
+    setTimeout(poll, options.prefetch.idleDelay);
+}
 
-    text = cleanString(verseText);
-    var messageCount = Math.ceil(text.length / options.appMessage.packetLength);
-    appMessageQueues[token.toString()] = [];
-    for (var j = 0; j < messageCount; j++)
+/*
+ * Bring the watch's favorites mirror from its revision to the current one,
+ * with the logged changes if there are all of them and otherwise with the
+ * whole list after a reset. Every message carries the revision and the
+ * total number of rows, the watch takes the revision on once it has them
+ * all. Messages may arrive in any order.
+ */
+function requestFavorites(token, revision) {
+    var changes = favoriteList.changesSince(revision || 0);
+    var rows = [];
+    if (changes !== null) {
+        for (var i = 0; i < changes.length; i++) {
+            rows.push(changes[i].slice(1));
+        }
+    } else {
+        for (var j = 0; j < favoriteList.count(); j++) {
+            var favorite = favoriteList.favoriteAtIndex(j);
+            rows.push(['+', favorite.book, favorite.chapter, favorite.range]);
+        }
+    }
+    transport.send(token, packRows(token, MessageType.Favorites, rows, {'revision': favoriteList.revision, 'reset': changes === null ? 1 : 0, 'length': rows.length}));
+}
+
+/*
+ * Passage stream for a book/chapter/range, reusing a recent one so windows
+ * of the same passage are sliced from the same bytes
+ */
+function passageStream(book, chapter, range) {
+    for (var i = 0; i < passageStreams.length; i++) {
+        var stream = passageStreams[i];
+        if (stream.key === book + chapter + ':' + range) {
+            return stream.stream;
+        }
+    }
+    passageStreams.unshift({key: book + chapter + ':' + range, stream: new PassageStream(book, chapter, range)});
+    passageStreams.length = Math.min(passageStreams.length, options.appMessage.passageStreams);
+    return passageStreams[0].stream;
+}
+
+function requestVerseText(book, chapter, range, offset, length, token) {
+  passageStream(book, chapter, range).read(token, offset || 0, length, function(bytes, end) {
+    if (!offset) {
+      prefetchNextPassage(book, chapter, range);
+    }
+    var first = {'token': token, 'messageType': MessageType.Viewer, 'index': 0, 'length': bytes.length, 'end': end ? 1 : 0};
+    var chunks = linkCompression ? compressedChunks(bytes, transport.contentBudget(first)) : null;
+    if (chunks === null) {
+      chunks = splitUtf8Bytes(bytes, transport.contentBudget(first));
+    }
+    var messages = [];
+    for (var j = 0; j < Math.max(chunks.length, 1); j++)
     {
-      appMessageQueues[token.toString()].push({'message': {
-        'token': token,
-        'messageType': MessageType.Viewer,
-        'index': j,
-        'content': text.substring(j * options.appMessage.packetLength, (j+1) * options.appMessage.packetLength)
-      }});
+      var message = j === 0 ? first : {'token': token, 'messageType': MessageType.Viewer, 'index': j};
+      message.content = chunks.length > 0 ? chunks[j] : '';
+      messages.push(message);
     }
-    sendAppMessageQueue(token.toString());
+    transport.send(token, messages);
   });
 }
 
+/*
+ * Compress a window for the link and cut it into byte arrays of at most
+ * budget bytes. Each window is compressed on its own so the watch can ask
+ * for any of them.
+ * @return Returns the byte arrays, or null if compression does not pay off
+ */
+function compressedChunks(bytes, budget) {
+    var packed = lzEncode(bytes);
+    if (packed.length >= bytes.length) {
+        return null;
+    }
+    var chunks = [];
+    for (var start = 0; start < packed.length; start += budget) {
+        var chunk = [];
+        for (var i = start; i < Math.min(start + budget, packed.length); i++) {
+            chunk.push(packed.charCodeAt(i));
+        }
+        chunks.push(chunk);
+    }
+    return chunks;
+}
+
+/*
+ * Answer a search from the watch. A passage reference comes back as a
+ * single message with book, chapter and range for the watch to open, any
+ * other query as rows of book, chapter, verse and the start of the verse.
+ */
+function requestSearch(query, token) {
+    var reference = parseReference(query || '');
+    if (reference !== null) {
+        transport.send(token, [{
+            'token': token,
+            'messageType': MessageType.Search,
+            'book': reference.book,
+            'chapter': reference.chapter,
+            'range': reference.range
+        }]);
+        return;
+    }
+    var hits = searchIndex.search(query || '');
+    var rows = [];
+    for (var i = 0; i < hits.length; i++) {
+        rows.push([hits[i].book, hits[i].chapter, hits[i].verse, verseSnippet(hits[i])]);
+    }
+    logDebug('Search for "' + query + '": ' + JSON.stringify(searchIndex.stats()));
+    sendRows(token, MessageType.Search, rows);
+}
+
+/*
+ * The start of a verse the phone already has, at most
+ * options.search.snippetBytes of UTF-8, or an empty string
+ */
+function verseSnippet(hit) {
+    var text = '';
+    var record = bibleCache.peek(hit.book + hit.chapter);
+    if (record !== null) {
+        text = recordVerse(record, hit.verse) || '';
+    } else {
+        var chapters = offlineProvider.loadBook(hit.book);
+        if (chapters !== null && chapters[hit.chapter - 1]) {
+            text = chapters[hit.chapter - 1][hit.verse - 1] || '';
+        }
+    }
+    var bytes = toUtf8Bytes(text);
+    return fromUtf8Bytes(bytes.substring(0, utf8Boundary(bytes, options.search.snippetBytes)));
+}
+
 function toggleFavorite(book, chapter, range, token) {
     
     var favorite = new Favorite({book: book, chapter: chapter, range: range});
@@ -192,69 +461,115 @@ function toggleFavorite(book, chapter, range, token) {
     }
     
     if (didChange) {
-        appMessageQueues[token.toString()] = [];
-        appMessageQueues[token.toString()].push({'message': {
+        // the change itself, the watch applies it to its mirror
+        var change = favoriteList.changes[favoriteList.changes.length - 1];
+        transport.send(token, [{
             'token': token,
-            'messageType': MessageType.FavoritesDidChange
-        }});
-        sendAppMessageQueue(token.toString());
+            'messageType': MessageType.FavoritesDidChange,
+            'revision': change[0],
+            'content': change.slice(1).join(FIELD_SEPARATOR)
+        }]);
     }
 }
 
+function findBook(name) {
+    for (var t = 0; t < bible.length; t++) {
+        for (var i = 0; i < bible[t].length; i++) {
+            if (bible[t][i].name === name) {
+                return bible[t][i];
+            }
+        }
+    }
+    return null;
+}
+
+/*
+ * Look up a chapter, asking the passage providers in order
+ * @param completion Called with the chapter record, see chapterRecord()
+ */
 function getVerseText(token, book, chapter, completion) {
 
-    if (bibleCache.hasOwnProperty(book+chapter))
+    if (transport.isCancelled(token)) {
+        return;
+    }
+
+    var key = book + chapter;
+    var cached = bibleCache.get(key);
+    if (cached !== null)
     {
-        completion(bibleCache[book+chapter]);
+        completion(cached);
         return;
     }
 
-	var xhr = new XMLHttpRequest();
-	var url = "http://labs.bible.org/api/?passage="+encodeURI(book + ' ' + chapter)+"&type=json";
-	logDebug("Fetching verse data from: " + url);
-	xhr.open('GET', url);
-	xhr.timeout = options.http.timeout;
-	xhr.onload = function(e) {
-		if (xhr.readyState == 4) {
-			if (xhr.status == 200) {
-				if (xhr.responseText) {
-					var res = JSON.parse(xhr.responseText);
-                    bibleCache[book+chapter] = res;
-                    completion(res);
-				} else {
-					logError('ERROR: Invalid response received! ' + JSON.stringify(xhr));
-				}
-			} else {
-				logError('ERROR: Request returned error code ' + xhr.status.toString());
-			}
-		}
-	};
-	xhr.ontimeout = function() {
-		logError('ERROR: HTTP request timed out');
-		appMessageQueues[token.toString()].push({'message': {'error': 'Error: Request timed out!'}});
-		sendAppMessageQueue(token.toString());
-	};
-	xhr.onerror = function() {
-		logError('ERROR: HTTP request returned error');
-		appMessageQueues[token.toString()].push({'message': {'error': 'Error: Failed to connect!'}});
-		sendAppMessageQueue(token.toString());
-	};
-	xhr.send(null);
+    // whoever asks for a chapter already being fetched waits for that fetch
+    var waiter = {token: token, completion: completion};
+    if (pendingChapters.hasOwnProperty(key)) {
+        logDebug('Waiting for the fetch of ' + book + ' ' + chapter + ' in flight');
+        pendingChapters[key].push(waiter);
+        return;
+    }
+    var waiters = pendingChapters[key] = [waiter];
+
+    var providers = passageProviders();
+    var next = 0;
+    var tryNext = function(error) {
+        if (error) {
+            logDebug(providers[next - 1].name + ': ' + error);
+        }
+        if (next >= providers.length) {
+            logError('ERROR: ' + error);
+            delete pendingChapters[key];
+            for (var i = 0; i < waiters.length; i++) {
+                if (waiters[i].token) {
+                    transport.send(waiters[i].token, [{'error': error}]);
+                }
+            }
+            return;
+        }
+        providers[next++].getChapter(book, chapter, function(verses) {
+            var record = chapterRecord(verses);
+            delete pendingChapters[key];
+            bibleCache.put(key, record);
+            verseLengths.put(key, record);
+            searchIndex.addChapter(book, chapter, record);
+            for (var i = 0; i < waiters.length; i++) {
+                if (!transport.isCancelled(waiters[i].token)) {
+                    waiters[i].completion(record);
+                }
+            }
+        }, tryNext);
+    };
+    tryNext(null);
+}
+
+/*
+ * Providers getVerseText() asks for a chapter, in turn. Without a pack URL
+ * the offline provider never has a pack to serve, so it is left out rather
+ * than failing every lookup first.
+ */
+function passageProviders() {
+    return options.offline.packUrl ? [offlineProvider, httpProvider] : [httpProvider];
 }
 
+/*
+ * First half of the handshake, the watch holds everything back until it
+ * has this and answers with Request.Configure
+ */
 Pebble.addEventListener('ready', function(e) {
 	logDebug('JS application ready to go!');
-    setTimeout(function() {
-        Pebble.sendAppMessage({
-                'messageType': MessageType.PebbleJSInitialized
-            },
-            function(e) {	
-            }, 
-            function(e) {
-                logError('ERROR: Failed sending Initialization Message', e);
-            }
-        );
-	}, 10);
+    readyTime = Date.now();
+    searchIndex.catchUp(bibleCache, offlineProvider);
+    Pebble.sendAppMessage({
+            'messageType': MessageType.PebbleJSInitialized,
+            'version': PROTOCOL_VERSION,
+            'length': bibleCache.stats().chapters
+        },
+        function(e) {
+        },
+        function(e) {
+            logError('ERROR: Failed sending Initialization Message', e);
+        }
+    );
 });
 
 Pebble.addEventListener('appmessage', function(e) {
@@ -263,27 +578,93 @@ Pebble.addEventListener('appmessage', function(e) {
 	var request = e.payload.request;
 	var token = e.payload.token || 0;
 	switch (request) {
-		case Request.Books:
-			sendBooksForTestament(e.payload.testament, token);
-			break;
         case Request.Verses:
             requestVerseRanges(e.payload.book, e.payload.chapter, token);
             break;
 		case Request.Viewer:
-			requestVerseText(e.payload.book, e.payload.chapter, e.payload.range, token);
+			requestVerseText(e.payload.book, e.payload.chapter, e.payload.range, e.payload.offset, e.payload.length, token);
 			break;
 		case Request.Cancel:
-			cancelAppMessageQueue(token);
+			transport.cancel(token);
 			break;
         case Request.Favorites:
-            requestFavorites(token);
+            requestFavorites(token, e.payload.revision);
             break;
         case Request.ToggleFavorite:
             toggleFavorite(e.payload.book, e.payload.chapter, e.payload.range, token);
             break;
+        case Request.NextPassage:
+            requestNextPassage(e.payload.book, e.payload.chapter, e.payload.range, token);
+            break;
+        case Request.Search:
+            requestSearch(e.payload.content, token);
+            break;
+        case Request.Configure:
+            transport.inboxSize = e.payload.inboxSize || options.appMessage.inboxSize;
+            linkCompression = options.appMessage.compress && !!e.payload.compression;
+            rangeBytes = e.payload.rangeBytes || options.appMessage.rangeBytes;
+            watchInfo = {
+                version: e.payload.version || 0,
+                platform: e.payload.platform || 'unknown',
+                outboxSize: e.payload.outboxSize || 0
+            };
+            if (watchInfo.version !== PROTOCOL_VERSION) {
+                logError('WARNING: Watch speaks protocol ' + watchInfo.version + ', expected ' + PROTOCOL_VERSION);
+            }
+            logDebug('Handshake with ' + watchInfo.platform + ' watch ' + (Date.now() - readyTime) + ' ms after ready, inbox ' +
+                transport.inboxSize + ' bytes, compression ' + linkCompression);
+            warmCaches(e.payload);
+            break;
 	}
 });
 
+/*
+ * Passages the watch holds whole in its own cache, from the manifest rows
+ * of book number, chapter, range and complete sent with Request.Configure
+ * @return Returns an object keyed like Favorite.key()
+ */
+function watchManifest(content) {
+    var held = {};
+    var rows = content ? content.split(ROW_SEPARATOR) : [];
+    for (var i = 0; i < rows.length; i++) {
+        var fields = rows[i].split(FIELD_SEPARATOR);
+        var book = bookAtNumber(parseInt(fields[0], 10));
+        if (fields.length === 4 && book && fields[3] === '1') {
+            held[book.name + ' ' + parseInt(fields[1], 10) + ':' + fields[2]] = true;
+        }
+    }
+    return held;
+}
+
+/*
+ * Fetch what the watch is about to ask for while it draws its first
+ * screen: the passage it reopens straight away, then the chapters of the
+ * first favorites once the link is idle. Passages the watch holds whole
+ * are left out, it never asks for them.
+ */
+function warmCaches(payload) {
+    var held = watchManifest(payload.content);
+    var started = Date.now();
+    if (payload.book && payload.chapter) {
+        var position = new Favorite({book: payload.book, chapter: payload.chapter, range: payload.range || '1-'});
+        if (!held.hasOwnProperty(position.key())) {
+            getVerseText(0, position.book, position.chapter, function() {
+                logDebug('Warmed ' + position.key() + ' in ' + (Date.now() - started) + ' ms');
+            });
+        }
+        prefetchNextPassage(position.book, position.chapter, position.range);
+    }
+    runWhenIdle('warm', function() {
+        var count = Math.min(favoriteList.count(), options.startup.warmFavorites);
+        for (var i = 0; i < count; i++) {
+            var favorite = favoriteList.favoriteAtIndex(i);
+            if (!held.hasOwnProperty(favorite.key())) {
+                getVerseText(0, favorite.book, favorite.chapter, function() {});
+            }
+        }
+    });
+}
+
 function cleanString(dirtyString) {
 	dirtyString = dirtyString.replace(/<b>|<\/b>/g, "");
 	dirtyString = dirtyString.replace(/\&#8211;/g, "-");
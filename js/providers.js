@@ -0,0 +1,270 @@
+/*
+ * Passage providers
+ * A provider looks up the verses of a chapter and hands them over as an
+ * array of {verse, text} objects, the shape labs.bible.org returns.
+ * getVerseText() asks each provider in turn until one has the chapter.
+ */
+
+/*
+ * Fetches chapters from labs.bible.org. Requests wait in a queue for one of
+ * config.maxConcurrent connections, and queued requests for neighbouring
+ * chapters of a book go out together as one passage query of up to
+ * config.maxBatchChapters chapters.
+ * @param config Object with timeout, maxConcurrent and maxBatchChapters
+ */
+function HttpProvider(config) {
+
+    this.name = 'http';
+    this.inFlight = 0;
+    this.queue = [];
+    this.connections = 0;
+    this.fetches = 0;
+    this.chaptersFetched = 0;
+
+    /*
+     * Look up a chapter
+     * @param success Called with the verses
+     * @param failure Called with an error message if the chapter cannot be had
+     */
+    this.getChapter = function(book, chapter, success, failure) {
+        this.inFlight++;
+        this.queue.push({book: book, chapter: parseInt(chapter, 10), success: success, failure: failure});
+        this.startFetches();
+    };
+
+    this.startFetches = function() {
+        while (this.connections < config.maxConcurrent && this.queue.length > 0) {
+            this.fetch(this.takeBatch());
+        }
+    };
+
+    /*
+     * Take the oldest request off the queue along with the queued ones that
+     * extend its chapters into a contiguous run
+     */
+    this.takeBatch = function() {
+        var requests = this.queue.splice(0, 1);
+        var book = requests[0].book;
+        var first = requests[0].chapter;
+        var last = first;
+        var grown = true;
+        while (grown) {
+            grown = false;
+            for (var i = 0; i < this.queue.length; i++) {
+                var chapter = this.queue[i].chapter;
+                if (this.queue[i].book === book && chapter >= first - 1 && chapter <= last + 1 &&
+                        Math.max(last, chapter) - Math.min(first, chapter) < config.maxBatchChapters) {
+                    first = Math.min(first, chapter);
+                    last = Math.max(last, chapter);
+                    requests.push(this.queue.splice(i, 1)[0]);
+                    grown = true;
+                    break;
+                }
+            }
+        }
+        return {book: book, first: first, last: last, requests: requests};
+    };
+
+    /*
+     * One passage query for a batch, every request in it is answered from
+     * the response
+     */
+    this.fetch = function(batch) {
+        var self = this;
+        var xhr = new XMLHttpRequest();
+        var passage = batch.book + ' ' + batch.first + (batch.last > batch.first ? '-' + batch.last : '');
+        var url = "http://labs.bible.org/api/?passage="+encodeURI(passage)+"&type=json";
+        logDebug("Fetching verse data from: " + url);
+        this.connections++;
+        this.fetches++;
+        xhr.open('GET', url);
+        xhr.timeout = config.timeout;
+        xhr.onload = function(e) {
+            if (xhr.readyState == 4) {
+                var verses = null;
+                try {
+                    verses = xhr.status == 200 && xhr.responseText ? JSON.parse(xhr.responseText) : null;
+                } catch (error) {
+                    logError('ERROR: Invalid response for ' + passage, error);
+                }
+                self.finish(batch, verses, 'Error: Request returned error code ' + xhr.status.toString());
+            }
+        };
+        xhr.ontimeout = function() {
+            self.finish(batch, null, 'Error: Request timed out!');
+        };
+        xhr.onerror = function() {
+            self.finish(batch, null, 'Error: Failed to connect!');
+        };
+        xhr.send(null);
+    };
+
+    this.finish = function(batch, verses, error) {
+        this.connections--;
+        this.inFlight -= batch.requests.length;
+        var chapters = {};
+        if (verses !== null && batch.first === batch.last) {
+            chapters[batch.first] = verses;
+        } else if (verses !== null) {
+            for (var i = 0; i < verses.length; i++) {
+                var chapter = parseInt(verses[i].chapter, 10);
+                (chapters[chapter] = chapters[chapter] || []).push(verses[i]);
+            }
+        }
+        for (var j = 0; j < batch.requests.length; j++) {
+            var request = batch.requests[j];
+            if (chapters.hasOwnProperty(request.chapter) && chapters[request.chapter].length > 0) {
+                this.chaptersFetched++;
+                request.success(chapters[request.chapter]);
+            } else {
+                request.failure(verses !== null ? 'Error: ' + batch.book + ' ' + request.chapter + ' missing from response' : error);
+            }
+        }
+        this.startFetches();
+    };
+
+}
+
+/*
+ * Serves chapters from a translation kept in localStorage, one compressed
+ * entry per book. The translation is downloaded once, in the background,
+ * as a pack from config.packUrl: a JSON array of
+ * {"name": book, "chapters": [["verse 1 text", ...], ...]} objects. Only the
+ * book being read is held decompressed in memory.
+ * @param config Object with packUrl (empty to disable downloading) and
+ *               version, which is part of every storage key
+ */
+function OfflineProvider(config) {
+
+    this.name = 'offline';
+    this.books = null;
+    this.bookName = null;
+    this.chapters = null;
+    this.downloadAttempted = false;
+
+    this.storageKey = function(name) {
+        return 'pack:' + config.version + ':' + name;
+    };
+
+    /*
+     * Names of the books stored so far, read from storage on first use
+     */
+    this.installedBooks = function() {
+        if (this.books === null) {
+            try {
+                this.books = JSON.parse(localStorage.getItem(this.storageKey('index'))) || {};
+            } catch (e) {
+                this.books = {};
+            }
+        }
+        return this.books;
+    };
+
+    this.getChapter = function(book, chapter, success, failure) {
+        var chapters = this.loadBook(book);
+        var texts = chapters !== null ? chapters[chapter - 1] : null;
+        if (!texts) {
+            this.scheduleDownload();
+            failure('Error: ' + book + ' ' + chapter + ' is not available offline');
+            return;
+        }
+        var verses = [];
+        for (var i = 0; i < texts.length; i++) {
+            verses.push({bookname: book, chapter: chapter.toString(), verse: (i + 1).toString(), text: texts[i]});
+        }
+        success(verses);
+    };
+
+    /*
+     * Decompress a book, replacing the one held before
+     * @return Returns the book's array of chapters, or null if not installed
+     */
+    this.loadBook = function(book) {
+        if (this.bookName === book) {
+            return this.chapters;
+        }
+        if (!this.installedBooks().hasOwnProperty(book)) {
+            return null;
+        }
+        try {
+            this.chapters = JSON.parse(fromUtf8Bytes(lzDecode(localStorage.getItem(this.storageKey(book)))));
+            this.bookName = book;
+            return this.chapters;
+        } catch (e) {
+            logError('ERROR: Offline copy of ' + book + ' is unreadable', e);
+            delete this.books[book];
+            return null;
+        }
+    };
+
+    this.scheduleDownload = function() {
+        if (!config.packUrl || this.downloadAttempted) {
+            return;
+        }
+        this.downloadAttempted = true;
+        var self = this;
+        runWhenIdle('pack', function() {
+            self.download();
+        });
+    };
+
+    this.download = function() {
+        var self = this;
+        var xhr = new XMLHttpRequest();
+        logDebug("Downloading passage pack from: " + config.packUrl);
+        xhr.open('GET', config.packUrl);
+        xhr.onload = function(e) {
+            if (xhr.readyState == 4 && xhr.status == 200) {
+                try {
+                    self.install(JSON.parse(xhr.responseText), 0);
+                } catch (error) {
+                    logError('ERROR: Invalid passage pack', error);
+                }
+            } else {
+                logError('ERROR: Passage pack request returned error code ' + xhr.status.toString());
+            }
+        };
+        xhr.onerror = function() {
+            logError('ERROR: Failed to download passage pack');
+        };
+        xhr.send(null);
+    };
+
+    /*
+     * Compress and store one book of the pack per turn of the event loop so
+     * replies to the watch are not held up
+     */
+    this.install = function(pack, index) {
+        var self = this;
+        if (index === 0) {
+            this.removeOtherVersions();
+        }
+        if (index >= pack.length) {
+            logDebug('Passage pack installed, ' + Object.keys(this.installedBooks()).length + ' books');
+            return;
+        }
+        var book = pack[index];
+        try {
+            localStorage.setItem(this.storageKey(book.name), lzEncode(toUtf8Bytes(JSON.stringify(book.chapters))));
+            this.installedBooks()[book.name] = true;
+            localStorage.setItem(this.storageKey('index'), JSON.stringify(this.books));
+        } catch (e) {
+            logError('ERROR: No room to store ' + book.name + ' offline', e);
+            return;
+        }
+        setTimeout(function() {
+            self.install(pack, index + 1);
+        }, 0);
+    };
+
+    this.removeOtherVersions = function() {
+        var prefix = this.storageKey('');
+        for (var i = localStorage.length - 1; i >= 0; i--) {
+            var key = localStorage.key(i);
+            if (key.indexOf('pack:') === 0 && key.indexOf(prefix) !== 0) {
+                localStorage.removeItem(key);
+            }
+        }
+    };
+
+}
@@ -0,0 +1,246 @@
+/*
+ * Full text search
+ * An inverted index from words to the verses containing them, built from
+ * whatever text the phone already has: chapters as they go through
+ * getVerseText(), the chapter cache and the offline pack. Nothing is
+ * fetched for the sake of the index, so only those chapters are searched.
+ * A verse is referred to by a packed number, see packReference().
+ * @param config Object with maxResults and minWordLength
+ */
+function SearchIndex(config) {
+
+    this.postings = {};
+    this.indexed = {};
+    this.words = 0;
+    this.verses = 0;
+    this.refs = 0;
+    this.buildTime = 0;
+    this.queryTime = 0;
+
+    /*
+     * Add the verses of a chapter, once
+     * @param record Chapter record, see chapterRecord()
+     */
+    this.addChapter = function(book, chapter, record) {
+        chapter = parseInt(chapter, 10);
+        var key = book + chapter;
+        var number = bookNumber(book);
+        if (this.indexed.hasOwnProperty(key) || number < 0) {
+            return;
+        }
+        var started = Date.now();
+        this.indexed[key] = true;
+        for (var i = 0; i < record.verses.length; i++) {
+            var ref = packReference(number, chapter, record.verses[i]);
+            var words = this.tokenize(recordVerseAt(record, i));
+            for (var j = 0; j < words.length; j++) {
+                var list = this.postings[words[j]];
+                if (typeof list === 'undefined') {
+                    list = this.postings[words[j]] = [];
+                    this.words++;
+                }
+                list.push(ref);
+            }
+            this.refs += words.length;
+            this.verses++;
+        }
+        this.buildTime += Date.now() - started;
+    };
+
+    /*
+     * Verses matching the most words of a query, rarer words weighing more
+     * @return Returns up to config.maxResults {book, chapter, verse} objects
+     */
+    this.search = function(query) {
+        var started = Date.now();
+        var words = this.tokenize(query);
+        var scores = {};
+        var matches = {};
+        for (var i = 0; i < words.length; i++) {
+            var list = this.postings[words[i]];
+            if (typeof list === 'undefined') {
+                continue;
+            }
+            var weight = Math.log(1 + this.verses / list.length);
+            for (var j = 0; j < list.length; j++) {
+                var ref = list[j];
+                scores[ref] = (scores[ref] || 0) + weight;
+                matches[ref] = (matches[ref] || 0) + 1;
+            }
+        }
+        var refs = Object.keys(scores).sort(function(a, b) {
+            return (matches[b] - matches[a]) || (scores[b] - scores[a]) || (a - b);
+        });
+        var hits = [];
+        for (var k = 0; k < Math.min(refs.length, config.maxResults); k++) {
+            hits.push(unpackReference(parseInt(refs[k], 10)));
+        }
+        this.queryTime = Date.now() - started;
+        return hits;
+    };
+
+    /*
+     * Distinct words of a text worth indexing
+     */
+    this.tokenize = function(text) {
+        var found = text.toLowerCase().replace(/'/g, '').match(/[a-z0-9]+/g) || [];
+        var seen = {};
+        var words = [];
+        for (var i = 0; i < found.length; i++) {
+            var word = found[i];
+            if (word.length < config.minWordLength || STOP_WORDS.hasOwnProperty(word) || seen.hasOwnProperty(word)) {
+                continue;
+            }
+            seen[word] = true;
+            words.push(word);
+        }
+        return words;
+    };
+
+    /*
+     * Index what is already on the phone, the cached chapters in one go
+     * and then an offline book at a time whenever the link is idle
+     */
+    this.catchUp = function(cache, offline) {
+        var self = this;
+        runWhenIdle('search', function() {
+            cache.each(function(key, record) {
+                var reference = /^(.*?)(\d+)$/.exec(key);
+                if (reference !== null) {
+                    self.addChapter(reference[1], parseInt(reference[2], 10), record);
+                }
+            });
+            self.catchUpOffline(offline, Object.keys(offline.installedBooks()), 0);
+        });
+    };
+
+    this.catchUpOffline = function(offline, books, index) {
+        var self = this;
+        if (index >= books.length) {
+            logDebug('Search index built: ' + JSON.stringify(this.stats()));
+            return;
+        }
+        var chapters = offline.loadBook(books[index]) || [];
+        for (var i = 0; i < chapters.length; i++) {
+            var verses = [];
+            for (var j = 0; j < chapters[i].length; j++) {
+                verses.push({verse: j + 1, text: chapters[i][j]});
+            }
+            this.addChapter(books[index], i + 1, chapterRecord(verses));
+        }
+        runWhenIdle('search', function() {
+            self.catchUpOffline(offline, books, index + 1);
+        });
+    };
+
+    /*
+     * Size and timings of the index, bytes being a rough estimate of the
+     * memory held by the postings
+     */
+    this.stats = function() {
+        return {
+            chapters: Object.keys(this.indexed).length,
+            verses: this.verses,
+            words: this.words,
+            refs: this.refs,
+            bytes: this.refs * 8 + this.words * 32,
+            buildTime: this.buildTime,
+            queryTime: this.queryTime
+        };
+    };
+
+}
+
+// Words too common to tell verses apart
+var STOP_WORDS = {};
+['a', 'an', 'and', 'are', 'as', 'at', 'be', 'but', 'by', 'for', 'from', 'he', 'him', 'his', 'i', 'in', 'is',
+ 'it', 'me', 'my', 'not', 'of', 'or', 'that', 'the', 'thee', 'their', 'them', 'they', 'this', 'thou', 'thy',
+ 'to', 'unto', 'upon', 'was', 'were', 'which', 'with', 'ye'].forEach(function(word) {
+    STOP_WORDS[word] = true;
+});
+
+// Abbreviations that are not the start of the book they stand for
+var BOOK_ABBREVIATIONS = {
+    'jn': 'John', 'jhn': 'John', 'mt': 'Matthew', 'mk': 'Mark', 'mrk': 'Mark', 'lk': 'Luke',
+    'prv': 'Proverbs', 'jdg': 'Judges', 'jgs': 'Judges', 'sos': 'Song of Solomon', 'ezk': 'Ezekiel',
+    'php': 'Philippians', 'phm': 'Philemon', 'jas': 'James', 'jm': 'James', 'rv': 'Revelation', 'hb': 'Hebrews'
+};
+
+/*
+ * A verse packed into one number: book index, chapter and verse in bits
+ * 16 and up, 8-15 and 0-7, so refs sort in canonical order
+ */
+function packReference(number, chapter, verse) {
+    return number * 65536 + chapter * 256 + verse;
+}
+
+function unpackReference(ref) {
+    return {book: bookAtNumber(Math.floor(ref / 65536)).name, chapter: Math.floor(ref / 256) % 256, verse: ref % 256};
+}
+
+/*
+ * Index of a book counting from Genesis, or -1
+ */
+function bookNumber(name) {
+    var number = 0;
+    for (var t = 0; t < bible.length; t++) {
+        for (var i = 0; i < bible[t].length; i++, number++) {
+            if (bible[t][i].name === name) {
+                return number;
+            }
+        }
+    }
+    return -1;
+}
+
+function bookAtNumber(number) {
+    return number < bible[0].length ? bible[0][number] : bible[1][number - bible[0].length];
+}
+
+/*
+ * Read a query as a passage reference such as "Jn 3:16", "1 Cor 13:4-7" or
+ * "Genesis 1". A verse on its own becomes a one verse range, a chapter on
+ * its own reads on from its first verse.
+ * @return Returns {book, chapter, range}, or null if it is not one
+ */
+function parseReference(query) {
+    var parts = /^\s*([1-3]?)\s*([a-z][a-z ]*?)\.?\s*(\d+)(?:\s*[:.]\s*(\d+)(?:\s*-\s*(\d+))?)?\s*$/.exec(query.toLowerCase());
+    if (parts === null) {
+        return null;
+    }
+    var book = findBookByAbbreviation(parts[1], parts[2]);
+    var chapter = parseInt(parts[3], 10);
+    if (book === null || chapter < 1 || chapter > book.chapters) {
+        return null;
+    }
+    if (!parts[4]) {
+        return {book: book.name, chapter: chapter, range: '1-'};
+    }
+    var verses = book.verses[chapter - 1];
+    var first = parseInt(parts[4], 10);
+    var last = parts[5] ? Math.min(parseInt(parts[5], 10), verses) : first;
+    if (first < 1 || first > verses || last < first) {
+        return null;
+    }
+    return {book: book.name, chapter: chapter, range: first + '-' + last};
+}
+
+/*
+ * The first book, in canonical order, whose name starts with the given
+ * letters, ignoring case and spaces
+ */
+function findBookByAbbreviation(number, letters) {
+    letters = letters.replace(/ /g, '');
+    if (!number && BOOK_ABBREVIATIONS.hasOwnProperty(letters)) {
+        letters = BOOK_ABBREVIATIONS[letters].toLowerCase().replace(/ /g, '');
+    }
+    var abbreviation = number + letters;
+    for (var t = 0; t < bible.length; t++) {
+        for (var i = 0; i < bible[t].length; i++) {
+            if (bible[t][i].name.toLowerCase().replace(/ /g, '').indexOf(abbreviation) === 0) {
+                return bible[t][i];
+            }
+        }
+    }
+    return null;
+}
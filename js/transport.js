@@ -0,0 +1,307 @@
+/*
+ * Windowed AppMessage transport
+ * Keeps several messages in flight instead of waiting for each one to be
+ * acknowledged. The watch acks or nacks every message individually, so a
+ * failed message is retransmitted on its own while the rest of the window
+ * keeps flowing. The window grows while round-trip times stay close to the
+ * best one observed and shrinks as soon as messages start to queue up or fail.
+ * @param config Object with maxTries, retryTimeout, minRetryTimeout,
+ *               initialWindow, maxWindow, inboxSize and maxCancelled
+ */
+function AppMessageTransport(config) {
+
+    this.config = config;
+    this.queues = {};
+    this.inFlight = 0;
+    this.window = config.initialWindow;
+    this.srtt = 0;
+    this.minRtt = 0;
+    this.retryTimer = null;
+    this.inboxSize = config.inboxSize;
+    this.cancelled = {};
+    this.cancelledOrder = [];
+
+    /*
+     * Bytes a message takes up in the watch's inbox dictionary
+     * @param message AppMessage dictionary
+     * @return Returns the serialized size, including the dictionary header
+     */
+    this.dictSize = function(message) {
+        var size = 1;
+        for (var key in message) {
+            var value = message[key];
+            size += 7;
+            if (typeof value === 'string') {
+                size += utf8Length(value) + 1;
+            } else if (value instanceof Array) {
+                size += value.length;
+            } else {
+                size += 4;
+            }
+        }
+        return size;
+    };
+
+    /*
+     * Bytes left for a content string in a message
+     * @param message AppMessage dictionary without its content
+     * @return Returns the content length in bytes, excluding the terminator
+     */
+    this.contentBudget = function(message) {
+        return this.inboxSize - this.dictSize(message) - 7 - 1;
+    };
+
+    /*
+     * Queue messages for a request
+     * @param token Request token the messages belong to
+     * @param messages Array of AppMessage dictionaries, in order
+     */
+    this.send = function(token, messages) {
+        if (this.isCancelled(token)) {
+            return;
+        }
+        var key = token.toString();
+        var queue = this.queues[key] || [];
+        var seq = queue.nextSeq || 0;
+        for (var i = 0; i < messages.length; i++) {
+            queue.push({token: key, seq: seq++, message: messages[i], numTries: 0, retryAt: 0, inFlight: false});
+        }
+        queue.nextSeq = seq;
+        this.queues[key] = queue;
+        this.pump();
+    };
+
+    /*
+     * Drop everything still queued for a request. Messages already in flight
+     * are allowed to finish but are never retried, and anything sent for the
+     * request later on is discarded. Only the most recent cancellations are
+     * remembered, the watch never reuses a token.
+     * @param token Request token to cancel
+     */
+    this.cancel = function(token) {
+        var key = token.toString();
+        delete this.queues[key];
+        if (!this.cancelled[key]) {
+            this.cancelled[key] = true;
+            this.cancelledOrder.push(key);
+            if (this.cancelledOrder.length > this.config.maxCancelled) {
+                delete this.cancelled[this.cancelledOrder.shift()];
+            }
+        }
+    };
+
+    /*
+     * Whether nothing is queued or waiting for an acknowledgement
+     */
+    this.isIdle = function() {
+        return this.inFlight === 0 && Object.keys(this.queues).length === 0;
+    };
+
+    /*
+     * Whether a request has been cancelled, so work for it can stop early
+     * @param token Request token
+     */
+    this.isCancelled = function(token) {
+        return this.cancelled.hasOwnProperty(token.toString());
+    };
+
+    /*
+     * Fill the window with the next sendable messages
+     */
+    this.pump = function() {
+        while (this.inFlight < Math.floor(this.window)) {
+            var entry = this.nextEntry();
+            if (!entry) {
+                break;
+            }
+            this.transmit(entry);
+        }
+    };
+
+    /*
+     * Find the oldest message that is neither in flight nor waiting for a
+     * retry. A message is only sent while it is within maxWindow of the oldest
+     * unacknowledged message of its request, which bounds how far ahead of a
+     * gap the watch may have to hold chunks.
+     */
+    this.nextEntry = function() {
+        var now = Date.now();
+        var earliestRetry = 0;
+        for (var key in this.queues) {
+            var queue = this.queues[key];
+            for (var i = 0; i < queue.length; i++) {
+                var entry = queue[i];
+                if (entry.seq - queue[0].seq >= this.config.maxWindow) {
+                    break;
+                }
+                if (entry.inFlight) {
+                    continue;
+                }
+                if (entry.retryAt > now) {
+                    earliestRetry = earliestRetry ? Math.min(earliestRetry, entry.retryAt) : entry.retryAt;
+                    continue;
+                }
+                return entry;
+            }
+        }
+        if (earliestRetry) {
+            this.scheduleRetry(earliestRetry - now);
+        }
+        return null;
+    };
+
+    this.scheduleRetry = function(delay) {
+        if (this.retryTimer !== null) {
+            return;
+        }
+        var self = this;
+        this.retryTimer = setTimeout(function() {
+            self.retryTimer = null;
+            self.pump();
+        }, delay);
+    };
+
+    this.transmit = function(entry) {
+        var self = this;
+        entry.inFlight = true;
+        entry.numTries++;
+        entry.sentAt = Date.now();
+        this.inFlight++;
+        logDebug('Sending AppMessage to Pebble: ' + JSON.stringify(entry.message) + ', tries: ' + entry.numTries + ', window: ' + this.window.toFixed(2));
+        Pebble.sendAppMessage(entry.message,
+            function(e) {
+                self.acked(entry);
+            },
+            function(e) {
+                self.nacked(entry, e);
+            }
+        );
+    };
+
+    this.acked = function(entry) {
+        this.inFlight--;
+        entry.inFlight = false;
+        this.sampleRtt(Date.now() - entry.sentAt);
+        this.remove(entry);
+        this.pump();
+    };
+
+    this.nacked = function(entry, e) {
+        this.inFlight--;
+        entry.inFlight = false;
+        this.window = Math.max(1, this.window / 2);
+        if (typeof this.queues[entry.token] === 'undefined') {
+            return;
+        }
+        if (entry.numTries >= this.config.maxTries) {
+            logError('ERROR: Failed sending AppMessage for transactionId:' + (e && e.data ? e.data.transactionId : -1) + '. Bailing. ' + JSON.stringify(entry.message));
+            // the rest of the reply is no use to the watch without it. The
+            // watch is not told, it gives up on the request once it has heard
+            // nothing of it for REQUEST_TIMEOUT_MS, see src/request.h.
+            delete this.queues[entry.token];
+        } else {
+            logError('ERROR: Failed sending AppMessage', e);
+            entry.retryAt = Date.now() + this.retryTimeout();
+        }
+        this.pump();
+    };
+
+    this.remove = function(entry) {
+        var queue = this.queues[entry.token];
+        if (typeof queue === 'undefined') {
+            return;
+        }
+        var index = queue.indexOf(entry);
+        if (index > -1) {
+            queue.splice(index, 1);
+        }
+        if (queue.length === 0) {
+            delete this.queues[entry.token];
+        }
+    };
+
+    /*
+     * Update the round-trip estimate and resize the window. The number of
+     * messages the link is currently queueing is estimated from how far the
+     * smoothed RTT has drifted above the best one seen so far.
+     */
+    this.sampleRtt = function(rtt) {
+        this.srtt = this.srtt ? (7 * this.srtt + rtt) / 8 : rtt;
+        this.minRtt = this.minRtt ? Math.min(this.minRtt, rtt) : rtt;
+        var queued = this.srtt > 0 ? this.window * (1 - this.minRtt / this.srtt) : 0;
+        if (queued < 1) {
+            this.window += 1 / this.window;
+        } else if (queued > 2) {
+            this.window -= 1 / this.window;
+        }
+        this.window = Math.max(1, Math.min(this.config.maxWindow, this.window));
+    };
+
+    this.retryTimeout = function() {
+        return Math.min(this.config.retryTimeout, Math.max(this.config.minRetryTimeout, 2 * this.srtt));
+    };
+
+}
+
+/*
+ * Length of a string once UTF-8 encoded
+ */
+function utf8Length(str) {
+    var length = 0;
+    for (var i = 0; i < str.length; i++) {
+        var code = str.charCodeAt(i);
+        if (code < 0x80) {
+            length += 1;
+        } else if (code < 0x800) {
+            length += 2;
+        } else if (code >= 0xD800 && code <= 0xDBFF) {
+            length += 4;
+            i++;
+        } else {
+            length += 3;
+        }
+    }
+    return length;
+}
+
+/*
+ * Encode a string as UTF-8, one character per byte
+ */
+function toUtf8Bytes(str) {
+    return unescape(encodeURIComponent(str));
+}
+
+/*
+ * Decode UTF-8 bytes produced by toUtf8Bytes() back into a string
+ */
+function fromUtf8Bytes(bytes) {
+    return decodeURIComponent(escape(bytes));
+}
+
+/*
+ * Move a byte offset back to the start of the UTF-8 character it falls in
+ */
+function utf8Boundary(bytes, offset) {
+    while (offset > 0 && offset < bytes.length && (bytes.charCodeAt(offset) & 0xC0) === 0x80) {
+        offset--;
+    }
+    return offset;
+}
+
+/*
+ * Split UTF-8 bytes into strings of at most budget bytes each without
+ * breaking a character in two
+ */
+function splitUtf8Bytes(bytes, budget) {
+    var pieces = [];
+    var start = 0;
+    while (start < bytes.length) {
+        var end = Math.min(start + budget, bytes.length);
+        if (end < bytes.length) {
+            end = utf8Boundary(bytes, end);
+        }
+        pieces.push(fromUtf8Bytes(bytes.substring(start, end)));
+        start = end;
+    }
+    return pieces;
+}
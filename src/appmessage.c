@@ -1,90 +1,216 @@
 #include <pebble.h>
 #include "appmessage.h"
 #include "common.h"
+#include "request.h"
 #include "libs/pebble-assist.h"
 #include "windows/testamentlist.h"
-#include "windows/booklist.h"
 #include "windows/verseslist.h"
-#include "windows/favoriteslist.h"
+#include "favorites.h"
 #include "windows/viewer.h"
+#include "windows/searchlist.h"
+#include "perf.h"
+#include "bible.h"
+#include "cache.h"
+#include "session.h"
+#include "startup.h"
 
 #define MAX_SEND_ATTEMPTS 3
-
+#define OUT_QUEUE_SIZE 8
+
+// Room for the handshake, the largest message the watch sends
+#define OUTBOX_SIZE 256
+#define MANIFEST_SIZE 88
+
+#if defined(PBL_PLATFORM_APLITE)
+#define PLATFORM_NAME "aplite"
+#elif defined(PBL_PLATFORM_BASALT)
+#define PLATFORM_NAME "basalt"
+#elif defined(PBL_PLATFORM_CHALK)
+#define PLATFORM_NAME "chalk"
+#else
+#define PLATFORM_NAME "unknown"
+#endif
+
+// Cap on the negotiated inbox, the rest of the heap is needed for passage text
+#if defined(PBL_PLATFORM_APLITE)
+#define INBOX_SIZE_LIMIT 1024
+#else
+#define INBOX_SIZE_LIMIT 4096
+#endif
+
+// Passage text in one range of the verses list, a couple of viewer windows
+#if defined(PBL_PLATFORM_APLITE)
+#define VERSE_RANGE_BYTES 2048
+#else
+#define VERSE_RANGE_BYTES 4096
+#endif
+
+// Strings are held inline, empty ones are left out of the dictionary
 typedef struct OutMessage {
     uint8_t request_type;
-    unsigned int token;
+    uint8_t send_attempts;
     uint8_t testament;
-    char* book_name;
     uint8_t chapter;
-    char* range;
+    unsigned int token;
+    char book_name[24];
+    char range[8];
+    char query[SEARCH_QUERY_SIZE];
+    uint32_t offset;
+    uint16_t length;
+    uint32_t revision;
 } OutMessage;
 
-typedef struct OutMessageQueue OutMessageQueue;
-struct OutMessageQueue {
-  OutMessage* message;
-  OutMessageQueue* next;
-  uint8_t send_attempts;
-};
-
 static void in_received_handler(DictionaryIterator *iter, void *context);
 static void in_dropped_handler(AppMessageResult reason, void *context);
 static void out_sent_handler(DictionaryIterator *sent, void *context);
 static void out_failed_handler(DictionaryIterator *failed, AppMessageResult reason, void *context);
+static void js_initialized(DictionaryIterator *iter);
+static void enqueue_configure(void);
 static unsigned int enqueue_message(OutMessage *message);
 static void process_next_message();
-static void destroy_out_message(OutMessage *message);
-
-static OutMessageQueue* out_message_queue = NULL;
+static OutMessage *queued_message(int position);
+static void remove_queued_message(int position);
+static bool remove_queued_messages(unsigned int token);
+static bool coalesce_message(OutMessage *message);
+static void init_out_message(OutMessage *message, uint8_t request_type, char* book_name, uint8_t chapter, char* range, unsigned int token);
+
+// Ring of messages waiting for the outbox, the head is the one being sent
+static OutMessage out_queue[OUT_QUEUE_SIZE];
+static uint8_t out_queue_head = 0;
+static uint8_t out_queue_count = 0;
 static bool send_in_progress = false;
 static bool pebble_js_initialized = false;
+static uint32_t inbox_size = 0;
 
 void appmessage_init(void) {
-  app_message_open(128 /* inbound_size */, 128 /* outbound_size */);
+  request_init();
+  inbox_size = app_message_inbox_size_maximum();
+  if (inbox_size > INBOX_SIZE_LIMIT) {
+    inbox_size = INBOX_SIZE_LIMIT;
+  }
+  app_message_open(inbox_size, OUTBOX_SIZE);
   app_message_register_inbox_received(in_received_handler);
   app_message_register_inbox_dropped(in_dropped_handler);
   app_message_register_outbox_sent(out_sent_handler);
   app_message_register_outbox_failed(out_failed_handler);
-  APP_LOG(APP_LOG_LEVEL_DEBUG, "AppMessage initialised");
+  APP_LOG(APP_LOG_LEVEL_DEBUG, "AppMessage initialised, inbox %d bytes", (int)inbox_size);
+  enqueue_configure();
+}
+
+int appmessage_read_row(char **cursor, char *fields[], int max_fields) {
+  char *row = *cursor;
+  if (row == NULL || *row == '\0') {
+    return 0;
+  }
+
+  char *end = strchr(row, ROW_SEPARATOR);
+  if (end != NULL) {
+    *end = '\0';
+    *cursor = end + 1;
+  } else {
+    *cursor = row + strlen(row);
+  }
+
+  int num_fields = 0;
+  char *field = row;
+  while (field != NULL && num_fields < max_fields) {
+    fields[num_fields++] = field;
+    char *separator = strchr(field, FIELD_SEPARATOR);
+    if (separator != NULL) {
+      *separator = '\0';
+      field = separator + 1;
+    } else {
+      field = NULL;
+    }
+  }
+  return num_fields;
 }
 
 static void in_received_handler(DictionaryIterator *iter, void *context) {
     APP_LOG(APP_LOG_LEVEL_DEBUG, "Incoming AppMessage from Pebble received");
 	Tuple *type_tuple = dict_find(iter, KEY_MESSAGE_TYPE);
+    Tuple *token_tuple = dict_find(iter, KEY_TOKEN);
+
+    // replies to finished or cancelled requests stop here
+    if (token_tuple && !request_is_live(token_tuple->value->uint32)) {
+        APP_LOG(APP_LOG_LEVEL_DEBUG, "Dropping AppMessage for dead request %d", (int)token_tuple->value->int32);
+        PERF_REQUEST_LATE(token_tuple->value->uint32);
+        return;
+    }
+    if (token_tuple) {
+        request_heard(token_tuple->value->uint32);
+        PERF_REQUEST_RECEIVED(token_tuple->value->uint32);
+    }
 
 	if (type_tuple) {
         switch (type_tuple->value->int16) {
-            case MessageTypeBook:
-                booklist_in_received_handler(iter);
-                break;
             case MessageTypeVerses:
                 verseslist_in_received_handler(iter);
                 break;
             case MessageTypeViewer:
                 viewer_in_received_handler(iter);
                 break;
-            case MessageTypeFavorites:
-                favoriteslist_in_received_handler(iter);
+            case MessageTypeNextPassage:
+                viewer_next_passage_received_handler(iter);
                 break;
+            case MessageTypeFavorites:
             case MessageTypeFavoritesDidChange:
-                favoriteslist_mark_dirty();
+                favorites_in_received_handler(iter);
+                break;
+            case MessageTypeSearch:
+                searchlist_in_received_handler(iter);
                 break;
             case MessageTypePebbleJSInitialized:
-            	pebble_js_initialized = true;
-            	process_next_message();
+                js_initialized(iter);
                 break;
         }
     }
+    PERF_HEAP_SAMPLE();
+}
+
+/*
+ * PebbleKit JS is up and has said which protocol it speaks. The watch's
+ * half of the handshake, Request.Configure, is already first in the queue.
+ * A JS restart loses what Configure told it, so it is sent again.
+ */
+static void js_initialized(DictionaryIterator *iter) {
+    Tuple *version_tuple = dict_find(iter, KEY_VERSION);
+    Tuple *length_tuple = dict_find(iter, KEY_LENGTH);
+    int version = version_tuple ? version_tuple->value->int32 : 0;
+    if (version != PROTOCOL_VERSION) {
+        APP_LOG(APP_LOG_LEVEL_WARNING, "Phone speaks protocol %d, expected %d", version, PROTOCOL_VERSION);
+    }
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "Phone holds %d chapters", length_tuple ? (int)length_tuple->value->int32 : 0);
+
+    if (pebble_js_initialized) {
+        enqueue_configure();
+    }
+    pebble_js_initialized = true;
+    startup_phone_ready();
+    PERF_JS_READY();
+    process_next_message();
 }
 
 static void in_dropped_handler(AppMessageResult reason, void *context) {
 	APP_LOG(APP_LOG_LEVEL_DEBUG, "Incoming AppMessage from Pebble dropped, %d", reason);
+    PERF_INBOX_DROPPED();
 }
 
 static void enqueue_next_message(bool sent_successfully) {
   // dequeue the message
-  if (sent_successfully || (out_message_queue != NULL && out_message_queue->send_attempts >= MAX_SEND_ATTEMPTS)) {
-      destroy_out_message(out_message_queue->message);
-      out_message_queue = out_message_queue->next;
+  if (out_queue_count > 0 && (sent_successfully || queued_message(0)->send_attempts >= MAX_SEND_ATTEMPTS)) {
+      OutMessage *message = queued_message(0);
+      if (!sent_successfully) {
+        // no reply can come, which frees the request's slot and tells its owner
+        APP_LOG(APP_LOG_LEVEL_WARNING, "Giving up on request %d", message->request_type);
+        request_cancel(message->token);
+      } else if (message->request_type == RequestTypeConfigure) {
+        // nothing answers Configure, it is done once delivered
+        request_finish(message->token);
+      } else {
+        request_heard(message->token);
+      }
+      remove_queued_message(0);
   }
 }
 
@@ -106,16 +232,21 @@ static void message_to_iter(OutMessage *message, DictionaryIterator *iter) {
     Tuplet request_tuple = TupletInteger(KEY_REQUEST, message->request_type);
 	dict_write_tuplet(iter, &request_tuple);
 
-    if (message->book_name != NULL) {
+    if (message->book_name[0] != '\0') {
       Tuplet book_tuple = TupletCString(KEY_BOOK, message->book_name);
       dict_write_tuplet(iter, &book_tuple);
     }
 
-    if (message->range != NULL) {
+    if (message->range[0] != '\0') {
       Tuplet range_tuple = TupletCString(KEY_RANGE, message->range);
       dict_write_tuplet(iter, &range_tuple);
     }
 
+    if (message->query[0] != '\0') {
+      Tuplet query_tuple = TupletCString(KEY_CONTENT, message->query);
+      dict_write_tuplet(iter, &query_tuple);
+    }
+
     Tuplet testament_tuple = TupletInteger(KEY_TESTAMENT, message->testament);
     dict_write_tuplet(iter, &testament_tuple);
 
@@ -125,6 +256,46 @@ static void message_to_iter(OutMessage *message, DictionaryIterator *iter) {
     Tuplet token_tuple = TupletInteger(KEY_TOKEN, message->token);
     dict_write_tuplet(iter, &token_tuple);
 
+    if (message->request_type == RequestTypeViewer) {
+      Tuplet offset_tuple = TupletInteger(KEY_OFFSET, message->offset);
+      dict_write_tuplet(iter, &offset_tuple);
+
+      Tuplet length_tuple = TupletInteger(KEY_LENGTH, message->length);
+      dict_write_tuplet(iter, &length_tuple);
+    }
+
+    if (message->request_type == RequestTypeFavorites) {
+      Tuplet revision_tuple = TupletInteger(KEY_REVISION, message->revision);
+      dict_write_tuplet(iter, &revision_tuple);
+    }
+
+    if (message->request_type == RequestTypeConfigure) {
+      Tuplet inbox_size_tuple = TupletInteger(KEY_INBOX_SIZE, inbox_size);
+      dict_write_tuplet(iter, &inbox_size_tuple);
+
+      // passage windows may come LZSS compressed, see lz.h
+      Tuplet compression_tuple = TupletInteger(KEY_COMPRESSION, 1);
+      dict_write_tuplet(iter, &compression_tuple);
+
+      Tuplet range_bytes_tuple = TupletInteger(KEY_RANGE_BYTES, VERSE_RANGE_BYTES);
+      dict_write_tuplet(iter, &range_bytes_tuple);
+
+      Tuplet version_tuple = TupletInteger(KEY_VERSION, PROTOCOL_VERSION);
+      dict_write_tuplet(iter, &version_tuple);
+
+      Tuplet platform_tuple = TupletCString(KEY_PLATFORM, PLATFORM_NAME);
+      dict_write_tuplet(iter, &platform_tuple);
+
+      Tuplet outbox_size_tuple = TupletInteger(KEY_OUTBOX_SIZE, OUTBOX_SIZE);
+      dict_write_tuplet(iter, &outbox_size_tuple);
+
+      // the passages the watch holds, for the phone to skip when warming
+      char manifest[MANIFEST_SIZE];
+      if (cache_manifest(manifest, sizeof(manifest)) > 0) {
+        dict_write_cstring(iter, KEY_CONTENT, manifest);
+      }
+    }
+
 	dict_write_end(iter);
 }
 
@@ -133,8 +304,7 @@ static void process_next_message() {
     return;
   }
 
-  OutMessageQueue* omq = out_message_queue;
-  if (omq == NULL) {
+  if (out_queue_count == 0) {
     send_in_progress = false;
     return;
   }
@@ -146,11 +316,13 @@ static void process_next_message() {
   DictionaryIterator* dict;
   app_message_outbox_begin(&dict);
   if (dict != NULL) {
-    message_to_iter(omq->message, dict);
-    omq->send_attempts = omq->send_attempts + 1;
-    if (omq->send_attempts > 1) {
-        APP_LOG(APP_LOG_LEVEL_DEBUG, "message being sent again: %d", omq->send_attempts);
+    OutMessage *message = queued_message(0);
+    message_to_iter(message, dict);
+    message->send_attempts = message->send_attempts + 1;
+    if (message->send_attempts > 1) {
+        APP_LOG(APP_LOG_LEVEL_DEBUG, "message being sent again: %d", message->send_attempts);
     }
+    PERF_REQUEST_SENT(message->token, message->request_type, message->send_attempts);
     AppMessageResult result = app_message_outbox_send();
     if (result != APP_MSG_OK) {
       enqueue_next_message(false);
@@ -161,98 +333,186 @@ static void process_next_message() {
   }
 }
 
+/*
+ * Copy a message into the queue, no allocation involved. Returns the
+ * message's token, or 0 if the queue or the request table is full.
+ */
 static unsigned int enqueue_message(OutMessage *message) {
-  if (message == NULL) {
+  if (message->token == 0) {
     return 0;
   }
-
-  OutMessageQueue* omq = malloc(sizeof(OutMessageQueue));
-  omq->next = NULL;
-  omq->message = message;
-  omq->send_attempts = 0;
-
-  if (out_message_queue == NULL) {
-    out_message_queue = omq;
+  PERF_REQUEST_ENQUEUED(message->token, message->request_type);
+  if (coalesce_message(message)) {
+    return message->token;
   }
-  else {
-    OutMessageQueue* eoq = out_message_queue;
-    while (eoq->next != NULL) {
-      eoq = eoq->next;
-    }
-    eoq->next = omq;
+
+  if (out_queue_count == OUT_QUEUE_SIZE) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Outgoing queue full, dropping request %d", message->request_type);
+    request_cancel(message->token);
+    return 0;
   }
 
+  *queued_message(out_queue_count) = *message;
+  out_queue_count++;
+
   process_next_message();
   return message->token;
 }
 
-static void destroy_out_message(OutMessage *message) {
-  if (message != NULL) {
-    if (message->range != NULL) {
-      free(message->range);
+static OutMessage *queued_message(int position) {
+  return &out_queue[(out_queue_head + position) % OUT_QUEUE_SIZE];
+}
+
+static void remove_queued_message(int position) {
+  if (position == 0) {
+    out_queue_head = (out_queue_head + 1) % OUT_QUEUE_SIZE;
+  } else {
+    for (int i = position; i < out_queue_count - 1; i++) {
+      *queued_message(i) = *queued_message(i + 1);
     }
-    if (message->book_name != NULL) {
-      free(message->book_name);
+  }
+  out_queue_count--;
+}
+
+/*
+ * Drop messages for a request that have not been handed to the outbox yet.
+ * Returns true if the request itself never left the watch.
+ */
+static bool remove_queued_messages(unsigned int token) {
+  bool removed = false;
+  int position = send_in_progress ? 1 : 0;
+  while (position < out_queue_count) {
+    OutMessage *message = queued_message(position);
+    if (message->token == token && message->request_type != RequestTypeCancel) {
+      removed = removed || message->send_attempts == 0;
+      remove_queued_message(position);
+    } else {
+      position++;
     }
-    free(message);
   }
+  return removed;
 }
 
-static OutMessage* create_out_message(uint8_t request_type, uint8_t *testament, char* book_name, uint8_t *chapter, char* range, unsigned int *token) {
-  OutMessage *message = malloc(sizeof(OutMessage));
+/*
+ * A list refresh that is already waiting to go out takes over the new
+ * request's token instead of being sent twice. Returns true if the
+ * message was merged into a queued one.
+ */
+static bool coalesce_message(OutMessage *message) {
+  if (message->request_type != RequestTypeVerses && message->request_type != RequestTypeFavorites) {
+    return false;
+  }
+  for (int position = send_in_progress ? 1 : 0; position < out_queue_count; position++) {
+    OutMessage *queued = queued_message(position);
+    if (queued->request_type == message->request_type && queued->send_attempts == 0 &&
+        queued->chapter == message->chapter && strcmp(queued->book_name, message->book_name) == 0) {
+      request_cancel(queued->token);
+      queued->token = message->token;
+      queued->revision = message->revision;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void init_out_message(OutMessage *message, uint8_t request_type, char* book_name, uint8_t chapter, char* range, unsigned int token) {
   memset(message, 0, sizeof(OutMessage));
   message->request_type = request_type;
-
-  if (testament != NULL) {
-    message->testament = *testament;
-  }
+  message->chapter = chapter;
 
   if (book_name != NULL) {
-    message->book_name = malloc(strlen(book_name)+1);
-    strcpy(message->book_name, book_name);
+    strncpy(message->book_name, book_name, sizeof(message->book_name) - 1);
   }
 
-  if (chapter != NULL) {
-    message->chapter = *chapter;
+  if (range != NULL) {
+    strncpy(message->range, range, sizeof(message->range) - 1);
   }
 
-  if (range != NULL) {
-    message->range = malloc(strlen(range)+1);
-    strcpy(message->range, range);
+  message->token = token != 0 ? token : request_allocate(request_type);
+}
+
+/*
+ * The watch's half of the handshake: buffer sizes and capabilities, so
+ * PebbleKit JS sizes every reply to fit the inbox, along with the passage
+ * about to be resumed and the manifest of cached passages, so it can warm
+ * its own cache while the first screen is drawn
+ */
+static void enqueue_configure(void) {
+  Session session;
+  bool resumable = session_restore(&session);
+  Book book;
+  if (resumable) {
+    bible_book_at_index(session.book, &book);
   }
-  
-  message->token = token != NULL ? (unsigned int)*token : (unsigned int)time(NULL);
-  return message;
+
+  OutMessage message;
+  init_out_message(&message, RequestTypeConfigure, resumable ? book.name : NULL, resumable ? session.chapter : 0,
+      resumable ? session.range : NULL, 0);
+  enqueue_message(&message);
 }
 
 // ---------------------------------------------------
 unsigned int appmessage_cancel_request(unsigned int token) {
   APP_LOG(APP_LOG_LEVEL_DEBUG, "appmessage_cancel_request");
-  return enqueue_message(create_out_message(RequestTypeCancel, NULL, NULL, NULL, NULL, &token));
+  if (token == 0) {
+    return 0;
+  }
+  request_cancel(token);
+  if (remove_queued_messages(token)) {
+    // the phone never heard of it
+    return token;
+  }
+  OutMessage message;
+  init_out_message(&message, RequestTypeCancel, NULL, 0, NULL, token);
+  return enqueue_message(&message);
+}
+
+void appmessage_finish_request(unsigned int token) {
+  request_finish(token);
 }
 
 unsigned int appmessage_viewer_toggle_favorite(char* book_name, uint8_t chapter, char* range) {
   APP_LOG(APP_LOG_LEVEL_DEBUG, "appmessage_viewer_toggle_favorite");
-  return enqueue_message(create_out_message(RequestTypeToggleFavorite, NULL, book_name, &chapter, range, NULL));
+  OutMessage message;
+  init_out_message(&message, RequestTypeToggleFavorite, book_name, chapter, range, 0);
+  return enqueue_message(&message);
+}
+
+unsigned int appmessage_viewer_request_data(char* book_name, uint8_t chapter, char* range, uint32_t offset, uint16_t length) {
+  APP_LOG(APP_LOG_LEVEL_DEBUG, "appmessage_viewer_request_data %d+%d", (int)offset, length);
+  OutMessage message;
+  init_out_message(&message, RequestTypeViewer, book_name, chapter, range, 0);
+  message.offset = offset;
+  message.length = length;
+  return enqueue_message(&message);
 }
 
-unsigned int appmessage_viewer_request_data(char* book_name, uint8_t chapter, char* range) {
-  APP_LOG(APP_LOG_LEVEL_DEBUG, "appmessage_viewer_request_data");
-  return enqueue_message(create_out_message(RequestTypeViewer, NULL, book_name, &chapter, range, NULL));
+unsigned int appmessage_viewer_request_next(char* book_name, uint8_t chapter, char* range) {
+  APP_LOG(APP_LOG_LEVEL_DEBUG, "appmessage_viewer_request_next");
+  OutMessage message;
+  init_out_message(&message, RequestTypeNextPassage, book_name, chapter, range, 0);
+  return enqueue_message(&message);
 }
 
 unsigned int appmessage_verseslist_request_data(char *book_name, uint8_t chapter) {
   APP_LOG(APP_LOG_LEVEL_DEBUG, "appmessage_verseslist_request_data");
-  return enqueue_message(create_out_message(RequestTypeVerses, NULL, book_name, &chapter, NULL, NULL));
+  OutMessage message;
+  init_out_message(&message, RequestTypeVerses, book_name, chapter, NULL, 0);
+  return enqueue_message(&message);
 }
 
-unsigned int appmessage_favoriteslist_request_data(void) {
+unsigned int appmessage_favoriteslist_request_data(uint32_t revision) {
   APP_LOG(APP_LOG_LEVEL_DEBUG, "appmessage_favoriteslist_request_data");
-  return enqueue_message(create_out_message(RequestTypeFavorites, NULL, NULL, NULL, NULL, NULL));
+  OutMessage message;
+  init_out_message(&message, RequestTypeFavorites, NULL, 0, NULL, 0);
+  message.revision = revision;
+  return enqueue_message(&message);
 }
 
-unsigned int appmessage_booklist_request_data(uint8_t testament) {
-  APP_LOG(APP_LOG_LEVEL_DEBUG, "appmessage_booklist_request_data");
-  return enqueue_message(create_out_message(RequestTypeBooks, &testament, NULL, NULL, NULL, NULL));
+unsigned int appmessage_search_request(char *query) {
+  APP_LOG(APP_LOG_LEVEL_DEBUG, "appmessage_search_request");
+  OutMessage message;
+  init_out_message(&message, RequestTypeSearch, NULL, 0, NULL, 0);
+  strncpy(message.query, query, sizeof(message.query) - 1);
+  return enqueue_message(&message);
 }
-
@@ -1,10 +1,13 @@
 #pragma once
 
 void appmessage_init(void);
+int appmessage_read_row(char **cursor, char *fields[], int max_fields);
 
 unsigned int appmessage_cancel_request(unsigned int token);
+void appmessage_finish_request(unsigned int token);
 unsigned int appmessage_verseslist_request_data(char *book_name, uint8_t current_chapter);
-unsigned int appmessage_favoriteslist_request_data(void);
-unsigned int appmessage_booklist_request_data(uint8_t testament);
-unsigned int appmessage_viewer_request_data(char* book_name, uint8_t current_chapter, char* range);
-unsigned int appmessage_viewer_toggle_favorite(char* book_name, uint8_t current_chapter, char* range);
\ No newline at end of file
+unsigned int appmessage_favoriteslist_request_data(uint32_t revision);
+unsigned int appmessage_viewer_request_data(char* book_name, uint8_t current_chapter, char* range, uint32_t offset, uint16_t length);
+unsigned int appmessage_viewer_request_next(char* book_name, uint8_t current_chapter, char* range);
+unsigned int appmessage_viewer_toggle_favorite(char* book_name, uint8_t current_chapter, char* range);
+unsigned int appmessage_search_request(char *query);
\ No newline at end of file
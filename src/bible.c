@@ -0,0 +1,33 @@
+#include <pebble.h>
+#include "bible.h"
+
+int bible_first_book(TestamentType testament) {
+    return testament == TestamentTypeOld ? 0 : BIBLE_NUM_OLD_TESTAMENT_BOOKS;
+}
+
+int bible_num_books(TestamentType testament) {
+    return testament == TestamentTypeOld ? BIBLE_NUM_OLD_TESTAMENT_BOOKS : BIBLE_NUM_BOOKS - BIBLE_NUM_OLD_TESTAMENT_BOOKS;
+}
+
+void bible_book_at_index(int index, Book *book) {
+    const BookInfo *info = &bible_books[index];
+    book->index = index;
+    strncpy(book->name, info->name, sizeof(book->name));
+    book->chapters = info->chapters;
+}
+
+int bible_find_book(const char *name) {
+    for (int i = 0; i < BIBLE_NUM_BOOKS; i++) {
+        if (strcmp(bible_books[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int bible_verse_count(int book_index, int chapter) {
+    if (book_index < 0 || book_index >= BIBLE_NUM_BOOKS || chapter < 1 || chapter > bible_books[book_index].chapters) {
+        return 0;
+    }
+    return bible_verse_counts[bible_books[book_index].first_chapter + chapter - 1];
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "common.h"
+
+#define BIBLE_NUM_BOOKS 66
+#define BIBLE_NUM_OLD_TESTAMENT_BOOKS 39
+
+typedef struct {
+    const char *name;
+    uint8_t chapters;
+    uint16_t first_chapter;
+} BookInfo;
+
+// Generated from data/bible.json into src/generated/bible_data.c
+extern const BookInfo bible_books[BIBLE_NUM_BOOKS];
+extern const uint8_t bible_verse_counts[];
+
+int bible_first_book(TestamentType testament);
+int bible_num_books(TestamentType testament);
+void bible_book_at_index(int index, Book *book);
+int bible_find_book(const char *name);
+int bible_verse_count(int book_index, int chapter);
@@ -0,0 +1,422 @@
+#include <pebble.h>
+#include "cache.h"
+#include "bible.h"
+#include "lz.h"
+
+#define SLOT_NONE 0xFF
+
+typedef struct {
+    uint8_t used;
+    uint8_t book;
+    uint8_t chapter;
+    uint8_t complete;
+    char range[8];
+    uint8_t first_slot;
+    uint16_t length;
+    uint16_t compressed_length;
+    uint32_t stamp;
+} CacheEntry;
+
+typedef struct {
+    uint8_t version;
+    uint32_t clock;
+    // slots of an entry are chained from its first_slot, SLOT_NONE ends it
+    uint8_t next_slot[CACHE_NUM_SLOTS];
+    CacheEntry entries[CACHE_MAX_ENTRIES];
+} CacheIndex;
+
+typedef struct {
+    LzEncoder encoder;
+    CacheEntry entry;
+    uint16_t slots;
+    int last_slot;
+    uint8_t slot[PERSIST_DATA_MAX_LENGTH];
+    uint16_t slot_length;
+    // start of a character the last piece stopped inside of
+    uint8_t pending[3];
+    uint8_t pending_length;
+    bool full;
+    bool failed;
+} CacheWriter;
+
+static void read_index(void);
+static void write_index(void);
+static CacheEntry *find_entry(int book, int chapter, const char *range);
+static bool make_key(const char *book_name, int chapter, const char *range, CacheEntry *entry);
+static uint16_t entry_slots(CacheEntry *entry);
+static void evict_oldest(void);
+static int allocate_slot(void);
+static void flush_slot(void);
+static bool store(const uint8_t *bytes, size_t length);
+static size_t sequence_length(uint8_t lead);
+static size_t partial_tail(const uint8_t *bytes, size_t length);
+static void group_callback(const uint8_t *data, size_t length, size_t consumed, void *context);
+static void decode_callback(const uint8_t *data, size_t length, void *context);
+
+static CacheIndex cache_index;
+static bool index_loaded;
+static CacheWriter *writer;
+
+typedef struct {
+    CacheLoadCallback callback;
+    void *context;
+} LoadContext;
+
+/*
+ * Restore a passage read before, most recently used passages are kept.
+ * The callback receives the text in pieces as it is decompressed.
+ * complete is set if the entry holds the whole passage and not just the
+ * start of it. Returns false on a miss.
+ */
+bool cache_load(const char *book_name, int chapter, const char *range, CacheLoadCallback callback, void *context, bool *complete) {
+    CacheEntry key;
+    if (!make_key(book_name, chapter, range, &key)) {
+        return false;
+    }
+    read_index();
+    CacheEntry *entry = find_entry(key.book, key.chapter, key.range);
+    if (entry == NULL) {
+        return false;
+    }
+
+    LzDecoder *decoder = malloc(sizeof(LzDecoder));
+    if (decoder == NULL) {
+        return false;
+    }
+    LoadContext load_context = { .callback = callback, .context = context };
+    lz_decoder_init(decoder, decode_callback, &load_context);
+
+    uint8_t data[PERSIST_DATA_MAX_LENGTH];
+    size_t remaining = entry->compressed_length;
+    int slot = entry->first_slot;
+    for (int n = 0; n < CACHE_NUM_SLOTS && slot < CACHE_NUM_SLOTS && remaining > 0; n++) {
+        size_t length = remaining < sizeof(data) ? remaining : sizeof(data);
+        if (persist_read_data(CACHE_SLOT_KEY_BASE + slot, data, length) != (int)length) {
+            APP_LOG(APP_LOG_LEVEL_WARNING, "cache: slot %d unreadable", slot);
+            break;
+        }
+        lz_decode(decoder, data, length);
+        remaining -= length;
+        slot = cache_index.next_slot[slot];
+    }
+    free(decoder);
+
+    *complete = entry->complete && remaining == 0;
+    entry->stamp = ++cache_index.clock;
+    write_index();
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "cache: hit %s %d %s, %d bytes from %d", book_name, chapter, range,
+        entry->length, entry->compressed_length);
+    return true;
+}
+
+/*
+ * Start storing the passage being streamed in. Text handed to
+ * cache_store_append() is compressed into persist slots as it arrives,
+ * evicting the least recently used passages to make room.
+ */
+void cache_store_begin(const char *book_name, int chapter, const char *range) {
+    cache_store_end(false);
+
+    CacheEntry key;
+    if (!make_key(book_name, chapter, range, &key)) {
+        return;
+    }
+    read_index();
+    CacheEntry *stale = find_entry(key.book, key.chapter, key.range);
+    if (stale != NULL) {
+        stale->used = false;
+        write_index();
+    }
+
+    writer = malloc(sizeof(CacheWriter));
+    if (writer == NULL) {
+        return;
+    }
+    memset(writer, 0, sizeof(CacheWriter));
+    writer->entry = key;
+    writer->entry.first_slot = SLOT_NONE;
+    writer->last_slot = -1;
+    lz_encoder_init(&writer->encoder, group_callback, NULL);
+}
+
+/*
+ * Add the next piece of the passage. Pieces may stop inside a character,
+ * decompressed windows do, so a character is only stored once all of it
+ * is in. Once the budget cannot be guaranteed to hold a piece the entry
+ * stops growing, and a partial entry still ends between characters.
+ */
+void cache_store_append(const char *text, size_t length) {
+    if (writer == NULL || writer->full || writer->failed) {
+        return;
+    }
+    const uint8_t *bytes = (const uint8_t *)text;
+    if (writer->pending_length > 0) {
+        size_t needed = sequence_length(writer->pending[0]);
+        while (writer->pending_length < needed && length > 0) {
+            writer->pending[writer->pending_length++] = *bytes++;
+            length--;
+        }
+        if (writer->pending_length < needed || !store(writer->pending, needed)) {
+            return;
+        }
+        writer->pending_length = 0;
+    }
+    size_t tail = partial_tail(bytes, length);
+    if (length > tail && !store(bytes, length - tail)) {
+        return;
+    }
+    memcpy(writer->pending, bytes + length - tail, tail);
+    writer->pending_length = tail;
+}
+
+/*
+ * Write out what has been stored so far. complete says whether the
+ * passage ended, rather than the viewer being closed part way through.
+ */
+void cache_store_end(bool complete) {
+    if (writer == NULL) {
+        return;
+    }
+    lz_encoder_finish(&writer->encoder);
+    if (writer->slot_length > 0) {
+        flush_slot();
+    }
+
+    if (!writer->failed && writer->entry.length > 0) {
+        CacheEntry *entry = NULL;
+        while (entry == NULL) {
+            for (int i = 0; i < CACHE_MAX_ENTRIES && entry == NULL; i++) {
+                if (!cache_index.entries[i].used) {
+                    entry = &cache_index.entries[i];
+                }
+            }
+            if (entry == NULL) {
+                evict_oldest();
+            }
+        }
+        *entry = writer->entry;
+        entry->used = true;
+        entry->complete = complete && !writer->full;
+        entry->stamp = ++cache_index.clock;
+        write_index();
+        APP_LOG(APP_LOG_LEVEL_DEBUG, "cache: stored %d bytes in %d, complete %d", entry->length,
+            entry->compressed_length, entry->complete);
+    }
+
+    free(writer);
+    writer = NULL;
+}
+
+/*
+ * Describe the cached passages for the phone, most recently used first, as
+ * rows of book number, chapter, range and whether the entry is complete.
+ * Rows that do not fit the buffer are left out. Returns the number of rows.
+ */
+int cache_manifest(char *buffer, size_t size) {
+    read_index();
+    buffer[0] = '\0';
+    int rows = 0;
+    size_t length = 0;
+    uint32_t below = UINT32_MAX;
+    for (int n = 0; n < CACHE_MAX_ENTRIES; n++) {
+        CacheEntry *newest = NULL;
+        for (int i = 0; i < CACHE_MAX_ENTRIES; i++) {
+            CacheEntry *entry = &cache_index.entries[i];
+            if (entry->used && entry->stamp < below && (newest == NULL || entry->stamp > newest->stamp)) {
+                newest = entry;
+            }
+        }
+        if (newest == NULL) {
+            break;
+        }
+        below = newest->stamp;
+
+        char row[24];
+        int row_length = snprintf(row, sizeof(row), "%d%c%d%c%s%c%d",
+            newest->book, FIELD_SEPARATOR, newest->chapter, FIELD_SEPARATOR, newest->range, FIELD_SEPARATOR, newest->complete);
+        if (length + (rows > 0) + row_length >= size) {
+            break;
+        }
+        if (rows > 0) {
+            buffer[length++] = ROW_SEPARATOR;
+        }
+        strcpy(buffer + length, row);
+        length += row_length;
+        rows++;
+    }
+    return rows;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+
+static void read_index(void) {
+    if (index_loaded) {
+        return;
+    }
+    memset(&cache_index, 0, sizeof(CacheIndex));
+    if (persist_get_size(CACHE_INDEX_KEY) != (int)sizeof(CacheIndex) ||
+            persist_read_data(CACHE_INDEX_KEY, &cache_index, sizeof(CacheIndex)) != (int)sizeof(CacheIndex) ||
+            cache_index.version != CACHE_VERSION) {
+        // missing or written by another version, start over
+        memset(&cache_index, 0, sizeof(CacheIndex));
+        cache_index.version = CACHE_VERSION;
+        // and free the slots a larger budget left behind
+        for (uint32_t key = CACHE_SLOT_KEY_BASE + CACHE_NUM_SLOTS; persist_exists(key); key++) {
+            persist_delete(key);
+        }
+    }
+    index_loaded = true;
+}
+
+static void write_index(void) {
+    if (persist_write_data(CACHE_INDEX_KEY, &cache_index, sizeof(CacheIndex)) < 0) {
+        APP_LOG(APP_LOG_LEVEL_ERROR, "cache: failed writing index");
+    }
+}
+
+static CacheEntry *find_entry(int book, int chapter, const char *range) {
+    for (int i = 0; i < CACHE_MAX_ENTRIES; i++) {
+        CacheEntry *entry = &cache_index.entries[i];
+        if (entry->used && entry->book == book && entry->chapter == chapter &&
+                strncmp(entry->range, range, sizeof(entry->range)) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static bool make_key(const char *book_name, int chapter, const char *range, CacheEntry *entry) {
+    int book = bible_find_book(book_name);
+    if (book < 0 || chapter < 0 || chapter > UINT8_MAX || strlen(range) >= sizeof(entry->range)) {
+        return false;
+    }
+    memset(entry, 0, sizeof(CacheEntry));
+    entry->book = book;
+    entry->chapter = chapter;
+    strncpy(entry->range, range, sizeof(entry->range));
+    return true;
+}
+
+static uint16_t entry_slots(CacheEntry *entry) {
+    uint16_t slots = 0;
+    int slot = entry->first_slot;
+    for (int n = 0; n < CACHE_NUM_SLOTS && slot < CACHE_NUM_SLOTS; n++) {
+        slots |= 1 << slot;
+        slot = cache_index.next_slot[slot];
+    }
+    return slots;
+}
+
+static void evict_oldest(void) {
+    CacheEntry *oldest = NULL;
+    for (int i = 0; i < CACHE_MAX_ENTRIES; i++) {
+        CacheEntry *entry = &cache_index.entries[i];
+        if (entry->used && (oldest == NULL || entry->stamp < oldest->stamp)) {
+            oldest = entry;
+        }
+    }
+    if (oldest != NULL) {
+        oldest->used = false;
+        // forget the entry before its slots get reused
+        write_index();
+    }
+}
+
+/*
+ * A slot is free unless an entry in the index or the writer holds it
+ */
+static int allocate_slot(void) {
+    while (true) {
+        uint16_t taken = writer->slots;
+        bool any_entries = false;
+        for (int i = 0; i < CACHE_MAX_ENTRIES; i++) {
+            if (cache_index.entries[i].used) {
+                taken |= entry_slots(&cache_index.entries[i]);
+                any_entries = true;
+            }
+        }
+        for (int slot = 0; slot < CACHE_NUM_SLOTS; slot++) {
+            if (!(taken & (1 << slot))) {
+                return slot;
+            }
+        }
+        if (!any_entries) {
+            return -1;
+        }
+        evict_oldest();
+    }
+}
+
+static void flush_slot(void) {
+    int slot = allocate_slot();
+    if (slot < 0 || persist_write_data(CACHE_SLOT_KEY_BASE + slot, writer->slot, writer->slot_length) < 0) {
+        APP_LOG(APP_LOG_LEVEL_ERROR, "cache: failed writing slot %d", slot);
+        writer->failed = true;
+        return;
+    }
+    if (writer->last_slot < 0) {
+        writer->entry.first_slot = slot;
+    } else {
+        cache_index.next_slot[writer->last_slot] = slot;
+    }
+    cache_index.next_slot[slot] = SLOT_NONE;
+    writer->last_slot = slot;
+    writer->slots |= 1 << slot;
+    writer->slot_length = 0;
+}
+
+/*
+ * Compress whole characters into the entry while it is within budget
+ */
+static bool store(const uint8_t *bytes, size_t length) {
+    // worst case every byte is a literal, costing a flag bit on top
+    size_t worst = writer->entry.compressed_length + LZ_MAX_GROUP_SIZE + length + (length + 7) / 8;
+    if (worst > CACHE_BUDGET_BYTES) {
+        writer->full = true;
+        return false;
+    }
+    lz_encode(&writer->encoder, bytes, length);
+    return true;
+}
+
+/*
+ * Bytes of the UTF-8 character a lead byte starts
+ */
+static size_t sequence_length(uint8_t lead) {
+    return lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+}
+
+/*
+ * Bytes at the end that start a character without finishing it, found by
+ * stepping back over continuation bytes to the lead byte
+ */
+static size_t partial_tail(const uint8_t *bytes, size_t length) {
+    for (size_t back = 1; back <= 3 && back <= length; back++) {
+        uint8_t byte = bytes[length - back];
+        if ((byte & 0xC0) != 0x80) {
+            return sequence_length(byte) > back ? back : 0;
+        }
+    }
+    return 0;
+}
+
+static void group_callback(const uint8_t *data, size_t length, size_t consumed, void *context) {
+    writer->entry.compressed_length += length;
+    writer->entry.length += consumed;
+    while (length > 0 && !writer->failed) {
+        size_t space = sizeof(writer->slot) - writer->slot_length;
+        size_t count = length < space ? length : space;
+        memcpy(writer->slot + writer->slot_length, data, count);
+        writer->slot_length += count;
+        data += count;
+        length -= count;
+        if (writer->slot_length == sizeof(writer->slot)) {
+            flush_slot();
+        }
+    }
+}
+
+static void decode_callback(const uint8_t *data, size_t length, void *context) {
+    LoadContext *load_context = context;
+    load_context->callback((const char *)data, length, load_context->context);
+}
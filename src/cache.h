@@ -0,0 +1,28 @@
+#pragma once
+
+// Persist keys, clear of COACHMARK_VERSION_KEY
+#define CACHE_INDEX_KEY         100
+#define CACHE_SLOT_KEY_BASE     101
+
+// Bump whenever the passage text or compression format changes to drop
+// stale entries
+#define CACHE_VERSION           2
+
+// Compressed passages are stored in slots of PERSIST_DATA_MAX_LENGTH bytes.
+// An app gets 4 KB of persist storage in all: the slots and the index take
+// about 2.3 KB, favorites up to 0.8 KB (FAVORITES_MAX_BLOCKS), the session
+// and the coachmark version a few bytes, which leaves room for the
+// per-key overhead.
+#define CACHE_BUDGET_BYTES      (8 * PERSIST_DATA_MAX_LENGTH)
+#define CACHE_NUM_SLOTS         (CACHE_BUDGET_BYTES / PERSIST_DATA_MAX_LENGTH)
+#define CACHE_MAX_ENTRIES       8
+
+typedef void (*CacheLoadCallback)(const char *text, size_t length, void *context);
+
+bool cache_load(const char *book_name, int chapter, const char *range, CacheLoadCallback callback, void *context, bool *complete);
+
+void cache_store_begin(const char *book_name, int chapter, const char *range);
+void cache_store_append(const char *text, size_t length);
+void cache_store_end(bool complete);
+
+int cache_manifest(char *buffer, size_t size);
@@ -6,7 +6,9 @@ typedef enum {
     MessageTypeFavorites = 0x2,
     MessageTypeViewer = 0x3,
     MessageTypeFavoritesDidChange = 0x4,
-    MessageTypePebbleJSInitialized = 0x05
+    MessageTypePebbleJSInitialized = 0x05,
+    MessageTypeNextPassage = 0x06,
+    MessageTypeSearch = 0x07
 } MessageType;
 
 typedef enum {
@@ -21,6 +23,9 @@ typedef enum {
     RequestTypeCancel,
     RequestTypeFavorites,
     RequestTypeToggleFavorite,
+    RequestTypeConfigure,
+    RequestTypeNextPassage,
+    RequestTypeSearch,
 } RequestType;
 
 const char* testament_to_string(TestamentType testament);
@@ -31,9 +36,10 @@ typedef struct {
     int chapters;
 } Book;
 
+// A favorite passage as mirrored on the watch, see favorites.h
 typedef struct {
-    Book book;
-    int chapter;
+    uint8_t book;
+    uint8_t chapter;
     char range[8];
 } Favorite;
 
@@ -46,5 +52,24 @@ enum {
     KEY_CHAPTER,
     KEY_RANGE,
     KEY_CONTENT,
-    KEY_TOKEN
+    KEY_TOKEN,
+    KEY_INBOX_SIZE,
+    KEY_OFFSET,
+    KEY_LENGTH,
+    KEY_END,
+    KEY_COMPRESSION,
+    KEY_RANGE_BYTES,
+    KEY_REVISION,
+    KEY_RESET,
+    KEY_VERSION,
+    KEY_PLATFORM,
+    KEY_OUTBOX_SIZE
 };
+
+// Exchanged in the startup handshake, bump together with PROTOCOL_VERSION
+// in js/pebble-js-app.js
+#define PROTOCOL_VERSION 1
+
+// Separators for several rows packed into one KEY_CONTENT string
+#define ROW_SEPARATOR   '\x1e'
+#define FIELD_SEPARATOR '\x1f'
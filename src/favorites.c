@@ -0,0 +1,293 @@
+#include <pebble.h>
+#include "favorites.h"
+#include "bible.h"
+#include "appmessage.h"
+#include "request.h"
+
+#define FAVORITES_PER_BLOCK (PERSIST_DATA_MAX_LENGTH / sizeof(Favorite))
+#define MIN_CAPACITY 8
+#define MAX_SYNC_MESSAGES 16
+
+typedef struct {
+    uint8_t format;
+    uint8_t blocks;
+    uint16_t count;
+    uint32_t revision;
+} FavoritesHeader;
+
+static bool reserve(int count);
+static int find_favorite(uint8_t book, uint8_t chapter, const char *range);
+static int apply_rows(char *cursor);
+static bool sync_message_seen(int16_t index);
+static void write_favorites(void);
+static void notify(void);
+
+// Mirror of the phone's favorites as of revision, in the order their rows
+// arrived, which after a sync in several messages need not be the phone's
+static Favorite *favorites;
+static int num_favorites;
+static int capacity;
+static uint32_t revision;
+static uint32_t sync_token;
+static bool synced;
+static bool unsaved;
+
+// Progress of the sync in flight, messages are told apart by first row
+static bool sync_cleared;
+static int sync_rows;
+static int16_t sync_seen[MAX_SYNC_MESSAGES];
+static int sync_num_seen;
+static FavoritesChangedCallback changed_callback;
+
+/*
+ * Restore the favorites stored at the last sync, so the list shows before
+ * the phone is reachable
+ */
+void favorites_init(void) {
+    FavoritesHeader header;
+    if (persist_read_data(FAVORITES_HEADER_KEY, &header, sizeof(header)) != (int)sizeof(header) ||
+            header.format != FAVORITES_FORMAT || !reserve(header.count)) {
+        return;
+    }
+    for (int block = 0; block < header.blocks; block++) {
+        int first = block * FAVORITES_PER_BLOCK;
+        int count = header.count - first < (int)FAVORITES_PER_BLOCK ? header.count - first : (int)FAVORITES_PER_BLOCK;
+        if (persist_read_data(FAVORITES_BLOCK_KEY_BASE + block, &favorites[first], count * sizeof(Favorite)) != (int)(count * sizeof(Favorite))) {
+            num_favorites = 0;
+            return;
+        }
+        num_favorites = first + count;
+    }
+    revision = header.revision;
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "Restored %d favorites at revision %d", num_favorites, (int)revision);
+}
+
+void favorites_deinit(void) {
+    free(favorites);
+    favorites = NULL;
+    num_favorites = 0;
+    capacity = 0;
+}
+
+/*
+ * Called whenever the mirror changes, NULL to stop
+ */
+void favorites_subscribe(FavoritesChangedCallback callback) {
+    changed_callback = callback;
+}
+
+/*
+ * Ask the phone for the changes since the mirror's revision. The phone
+ * sends the whole list instead if it no longer has them.
+ */
+void favorites_sync(void) {
+    if (sync_token != 0 && request_is_live(sync_token)) {
+        return;
+    }
+    sync_token = appmessage_favoriteslist_request_data(revision);
+    sync_cleared = false;
+    sync_rows = 0;
+    sync_num_seen = 0;
+}
+
+/*
+ * Whether the mirror has been brought up to date since launch
+ */
+bool favorites_synced(void) {
+    return synced;
+}
+
+int favorites_count(void) {
+    return num_favorites;
+}
+
+const Favorite *favorites_get(int index) {
+    return index < num_favorites ? &favorites[index] : NULL;
+}
+
+/*
+ * Replies to favorites_sync() and changes pushed after a toggle. Both carry
+ * rows of operation ('+' or '-'), book name, chapter and range, at most one
+ * per passage. A sync reply may take several messages in any order, each
+ * with the total number of rows in KEY_LENGTH, and the new revision is only
+ * taken on once all of them are in. Operations are idempotent, so a sync
+ * cut short is simply asked for again.
+ */
+void favorites_in_received_handler(DictionaryIterator *iter) {
+    Tuple *type_tuple = dict_find(iter, KEY_MESSAGE_TYPE);
+    Tuple *token_tuple = dict_find(iter, KEY_TOKEN);
+    Tuple *revision_tuple = dict_find(iter, KEY_REVISION);
+    Tuple *content_tuple = dict_find(iter, KEY_CONTENT);
+
+    if (!type_tuple || !token_tuple || !revision_tuple) {
+        return;
+    }
+
+    if (type_tuple->value->int16 == MessageTypeFavoritesDidChange) {
+        appmessage_finish_request(token_tuple->value->uint32);
+        if (revision_tuple->value->uint32 != revision + 1) {
+            // missed a change, catch up instead
+            favorites_sync();
+            return;
+        }
+        if (content_tuple) {
+            apply_rows(content_tuple->value->cstring);
+        }
+        revision = revision_tuple->value->uint32;
+        write_favorites();
+        notify();
+        return;
+    }
+
+    if (token_tuple->value->uint32 != sync_token) {
+        return;
+    }
+    Tuple *index_tuple = dict_find(iter, KEY_INDEX);
+    Tuple *reset_tuple = dict_find(iter, KEY_RESET);
+    Tuple *length_tuple = dict_find(iter, KEY_LENGTH);
+    if (sync_message_seen(index_tuple ? index_tuple->value->int16 : 0)) {
+        return;
+    }
+    if (reset_tuple && reset_tuple->value->int32 && !sync_cleared) {
+        // a whole list follows
+        num_favorites = 0;
+        unsaved = true;
+        sync_cleared = true;
+    }
+    if (content_tuple) {
+        sync_rows += apply_rows(content_tuple->value->cstring);
+    }
+    if (!length_tuple || sync_rows >= length_tuple->value->int32) {
+        appmessage_finish_request(sync_token);
+        sync_token = 0;
+        synced = true;
+        if (unsaved || revision != revision_tuple->value->uint32) {
+            revision = revision_tuple->value->uint32;
+            write_favorites();
+        }
+    }
+    notify();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+
+/*
+ * Make room for count favorites, doubling the array. Returns false if there
+ * is no memory for them.
+ */
+static bool reserve(int count) {
+    if (count <= capacity) {
+        return true;
+    }
+    int grown_capacity = capacity > 0 ? capacity : MIN_CAPACITY;
+    while (grown_capacity < count) {
+        grown_capacity *= 2;
+    }
+    Favorite *grown = realloc(favorites, grown_capacity * sizeof(Favorite));
+    if (grown == NULL) {
+        APP_LOG(APP_LOG_LEVEL_ERROR, "No memory for %d favorites", count);
+        return false;
+    }
+    favorites = grown;
+    capacity = grown_capacity;
+    return true;
+}
+
+static int find_favorite(uint8_t book, uint8_t chapter, const char *range) {
+    for (int i = 0; i < num_favorites; i++) {
+        if (favorites[i].book == book && favorites[i].chapter == chapter && strcmp(favorites[i].range, range) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Returns the number of rows read, applied or not
+ */
+static int apply_rows(char *cursor) {
+    char *fields[4];
+    int rows = 0;
+    while (appmessage_read_row(&cursor, fields, 4) == 4) {
+        rows++;
+        int book = bible_find_book(fields[1]);
+        if (book < 0) {
+            continue;
+        }
+        Favorite favorite;
+        memset(&favorite, 0x0, sizeof(favorite));
+        favorite.book = book;
+        favorite.chapter = atoi(fields[2]);
+        strncpy(favorite.range, fields[3], sizeof(favorite.range) - 1);
+
+        int index = find_favorite(favorite.book, favorite.chapter, favorite.range);
+        if (fields[0][0] == '+' && index < 0 && reserve(num_favorites + 1)) {
+            favorites[num_favorites++] = favorite;
+            unsaved = true;
+        } else if (fields[0][0] == '-' && index >= 0) {
+            memmove(&favorites[index], &favorites[index + 1], (num_favorites - index - 1) * sizeof(Favorite));
+            num_favorites--;
+            unsaved = true;
+        }
+    }
+    return rows;
+}
+
+/*
+ * Whether a message of the sync in flight arrived before, a retransmission
+ * whose acknowledgement was lost. Only the first MAX_SYNC_MESSAGES are
+ * remembered.
+ */
+static bool sync_message_seen(int16_t index) {
+    for (int i = 0; i < sync_num_seen; i++) {
+        if (sync_seen[i] == index) {
+            return true;
+        }
+    }
+    if (sync_num_seen < MAX_SYNC_MESSAGES) {
+        sync_seen[sync_num_seen++] = index;
+    }
+    return false;
+}
+
+/*
+ * Store the mirror. The old header's revision is cleared before the blocks
+ * are rewritten, so an interrupted write is fixed by a full sync. Favorites
+ * that do not fit are left out and stored with revision 0 for the same
+ * reason.
+ */
+static void write_favorites(void) {
+    FavoritesHeader header = {
+        .format = FAVORITES_FORMAT,
+        .count = num_favorites,
+        .revision = revision,
+    };
+    if (num_favorites > (int)(FAVORITES_MAX_BLOCKS * FAVORITES_PER_BLOCK)) {
+        header.count = FAVORITES_MAX_BLOCKS * FAVORITES_PER_BLOCK;
+        header.revision = 0;
+    }
+    header.blocks = (header.count + FAVORITES_PER_BLOCK - 1) / FAVORITES_PER_BLOCK;
+    unsaved = false;
+
+    FavoritesHeader stale = header;
+    stale.revision = 0;
+    persist_write_data(FAVORITES_HEADER_KEY, &stale, sizeof(stale));
+    for (int block = 0; block < header.blocks; block++) {
+        int first = block * FAVORITES_PER_BLOCK;
+        int count = header.count - first < (int)FAVORITES_PER_BLOCK ? header.count - first : (int)FAVORITES_PER_BLOCK;
+        if (persist_write_data(FAVORITES_BLOCK_KEY_BASE + block, &favorites[first], count * sizeof(Favorite)) < 0) {
+            APP_LOG(APP_LOG_LEVEL_ERROR, "Failed to store favorites");
+            return;
+        }
+    }
+    for (int block = header.blocks; block < FAVORITES_MAX_BLOCKS; block++) {
+        persist_delete(FAVORITES_BLOCK_KEY_BASE + block);
+    }
+    persist_write_data(FAVORITES_HEADER_KEY, &header, sizeof(header));
+}
+
+static void notify(void) {
+    if (changed_callback != NULL) {
+        changed_callback();
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "common.h"
+
+// Persist keys, clear of COACHMARK_VERSION_KEY and the passage cache
+#define FAVORITES_HEADER_KEY        200
+#define FAVORITES_BLOCK_KEY_BASE    201
+
+// Bump whenever the stored layout changes to drop stale favorites
+#define FAVORITES_FORMAT            1
+
+// Favorites are stored in blocks of PERSIST_DATA_MAX_LENGTH bytes. Any
+// beyond the last block are only held in memory and are fetched again from
+// the phone at the next launch.
+#define FAVORITES_MAX_BLOCKS        3
+
+typedef void (*FavoritesChangedCallback)(void);
+
+void favorites_init(void);
+void favorites_deinit(void);
+void favorites_subscribe(FavoritesChangedCallback callback);
+void favorites_sync(void);
+bool favorites_synced(void);
+int favorites_count(void);
+const Favorite *favorites_get(int index);
+void favorites_in_received_handler(DictionaryIterator *iter);
@@ -0,0 +1,201 @@
+#include <pebble.h>
+#include "lz.h"
+
+#define OUTPUT_BUFFER_SIZE 64
+
+static void window_push(LzWindow *window, uint8_t byte) {
+    window->bytes[window->position] = byte;
+    window->position = (window->position + 1) % LZ_WINDOW_SIZE;
+    if (window->filled < LZ_WINDOW_SIZE) {
+        window->filled++;
+    }
+}
+
+static uint8_t window_byte(LzWindow *window, size_t distance) {
+    return window->bytes[(window->position + LZ_WINDOW_SIZE - distance) % LZ_WINDOW_SIZE];
+}
+
+static void window_init(LzWindow *window) {
+    memcpy(window->bytes, lz_dictionary, lz_dictionary_length);
+    window->position = lz_dictionary_length % LZ_WINDOW_SIZE;
+    window->filled = lz_dictionary_length;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+
+static uint8_t hash(uint8_t a, uint8_t b, uint8_t c) {
+    return ((a * 33 + b) * 33 + c) & (LZ_HASH_SIZE - 1);
+}
+
+/*
+ * Push a byte and chain the position LZ_MIN_MATCH bytes back, whose first
+ * bytes are now all known
+ */
+static void encoder_push(LzEncoder *encoder, uint8_t byte) {
+    LzWindow *window = &encoder->window;
+    window_push(window, byte);
+    encoder->pushed++;
+    if (window->filled < LZ_MIN_MATCH) {
+        return;
+    }
+    uint16_t position = encoder->pushed - LZ_MIN_MATCH;
+    uint8_t h = hash(window_byte(window, 3), window_byte(window, 2), window_byte(window, 1));
+    encoder->previous[position % LZ_WINDOW_SIZE] = encoder->head[h];
+    encoder->head[h] = position;
+}
+
+void lz_encoder_init(LzEncoder *encoder, LzGroupCallback callback, void *context) {
+    memset(encoder, 0, sizeof(LzEncoder));
+    // the dictionary is pushed rather than copied so its positions get chained
+    for (size_t i = 0; i < lz_dictionary_length; i++) {
+        encoder_push(encoder, lz_dictionary[i]);
+    }
+    encoder->group_length = 1;
+    encoder->callback = callback;
+    encoder->context = context;
+}
+
+static void flush_group(LzEncoder *encoder) {
+    encoder->callback(encoder->group, encoder->group_length, encoder->group_consumed, encoder->context);
+    encoder->group[0] = 0;
+    encoder->group_length = 1;
+    encoder->group_items = 0;
+    encoder->group_consumed = 0;
+}
+
+static void add_item(LzEncoder *encoder, bool literal, const uint8_t *data, size_t length, size_t consumed) {
+    if (literal) {
+        encoder->group[0] |= 0x80 >> encoder->group_items;
+    }
+    memcpy(encoder->group + encoder->group_length, data, length);
+    encoder->group_length += length;
+    encoder->group_consumed += consumed;
+    if (++encoder->group_items == 8) {
+        flush_group(encoder);
+    }
+}
+
+/*
+ * Compress data, continuing the stream. Matches may reach back into earlier
+ * calls but never past the end of this one, so callers can feed the encoder
+ * in whatever pieces the data arrives in.
+ */
+void lz_encode(LzEncoder *encoder, const uint8_t *data, size_t length) {
+    LzWindow *window = &encoder->window;
+    size_t i = 0;
+    while (i < length) {
+        size_t best_length = 0;
+        size_t best_distance = 0;
+        size_t max_length = length - i < LZ_MAX_MATCH ? length - i : LZ_MAX_MATCH;
+
+        if (max_length >= LZ_MIN_MATCH) {
+            // a chain runs back in time, anything else is a stale link
+            uint16_t position = encoder->head[hash(data[i], data[i + 1], data[i + 2])];
+            size_t last_distance = 0;
+            for (int tries = 0; tries < LZ_MAX_CHAIN; tries++) {
+                size_t distance = (uint16_t)(encoder->pushed - position);
+                if (distance <= last_distance || distance > window->filled) {
+                    break;
+                }
+                last_distance = distance;
+                position = encoder->previous[position % LZ_WINDOW_SIZE];
+                if (window_byte(window, distance) != data[i]) {
+                    continue;
+                }
+                // bytes past the window are the ones this match is producing
+                size_t n = 1;
+                while (n < max_length &&
+                        (n < distance ? window_byte(window, distance - n) : data[i + n - distance]) == data[i + n]) {
+                    n++;
+                }
+                if (n > best_length) {
+                    best_length = n;
+                    best_distance = distance;
+                    if (n == max_length) {
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (best_length >= LZ_MIN_MATCH) {
+            uint8_t match[2] = {
+                (best_distance - 1) >> 1,
+                (((best_distance - 1) & 1) << 7) | (best_length - LZ_MIN_MATCH)
+            };
+            for (size_t n = 0; n < best_length; n++) {
+                encoder_push(encoder, data[i + n]);
+            }
+            add_item(encoder, false, match, 2, best_length);
+            i += best_length;
+        } else {
+            encoder_push(encoder, data[i]);
+            add_item(encoder, true, &data[i], 1, 1);
+            i++;
+        }
+    }
+}
+
+void lz_encoder_finish(LzEncoder *encoder) {
+    if (encoder->group_items > 0) {
+        flush_group(encoder);
+    }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+
+void lz_decoder_init(LzDecoder *decoder, LzOutputCallback callback, void *context) {
+    memset(decoder, 0, sizeof(LzDecoder));
+    window_init(&decoder->window);
+    decoder->match_high = -1;
+    decoder->callback = callback;
+    decoder->context = context;
+}
+
+/*
+ * Decompress the next piece of a stream. Items split across calls are
+ * carried over, so input can be fed in any sized pieces.
+ */
+void lz_decode(LzDecoder *decoder, const uint8_t *data, size_t length) {
+    uint8_t output[OUTPUT_BUFFER_SIZE];
+    size_t output_length = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        uint8_t byte = data[i];
+        if (decoder->flag_bits == 0) {
+            decoder->flags = byte;
+            decoder->flag_bits = 8;
+            continue;
+        }
+
+        size_t distance = 0;
+        size_t match_length = 1;
+        if (decoder->flags & 0x80) {
+            window_push(&decoder->window, byte);
+        } else if (decoder->match_high < 0) {
+            decoder->match_high = byte;
+            continue;
+        } else {
+            distance = ((decoder->match_high << 1) | (byte >> 7)) + 1;
+            match_length = (byte & 0x7F) + LZ_MIN_MATCH;
+            decoder->match_high = -1;
+        }
+        decoder->flags <<= 1;
+        decoder->flag_bits--;
+
+        for (size_t n = 0; n < match_length; n++) {
+            if (distance > 0) {
+                window_push(&decoder->window, window_byte(&decoder->window, distance));
+            }
+            output[output_length++] = window_byte(&decoder->window, 1);
+            if (output_length == OUTPUT_BUFFER_SIZE) {
+                decoder->callback(output, output_length, decoder->context);
+                output_length = 0;
+            }
+        }
+    }
+
+    if (output_length > 0) {
+        decoder->callback(output, output_length, decoder->context);
+    }
+}
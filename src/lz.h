@@ -0,0 +1,59 @@
+#pragma once
+
+// LZSS: groups of a flag byte followed by 8 items, most significant flag bit
+// first. A set bit is a literal byte, a clear bit a 2 byte match holding a
+// 9 bit distance and a 7 bit length into the last LZ_WINDOW_SIZE bytes.
+// Both ends start with the preset dictionary in the window, so even short
+// streams find matches. js/lz.js implements the same format.
+#define LZ_WINDOW_SIZE      512
+#define LZ_MIN_MATCH        3
+#define LZ_MAX_MATCH        (LZ_MIN_MATCH + 127)
+#define LZ_MAX_GROUP_SIZE   (1 + 8 * 2)
+
+// The encoder finds matches through chains of earlier positions with the
+// same hash of their first LZ_MIN_MATCH bytes, trying at most LZ_MAX_CHAIN
+#define LZ_HASH_SIZE        256
+#define LZ_MAX_CHAIN        32
+
+// Generated from data/lz-dictionary.txt into src/generated/lz_dictionary.c
+extern const uint8_t lz_dictionary[];
+extern const size_t lz_dictionary_length;
+
+typedef void (*LzGroupCallback)(const uint8_t *data, size_t length, size_t consumed, void *context);
+typedef void (*LzOutputCallback)(const uint8_t *data, size_t length, void *context);
+
+typedef struct {
+    uint8_t bytes[LZ_WINDOW_SIZE];
+    uint16_t position;
+    uint16_t filled;
+} LzWindow;
+
+typedef struct {
+    LzWindow window;
+    // positions count every byte pushed, dictionary included, and wrap
+    uint16_t pushed;
+    uint16_t head[LZ_HASH_SIZE];
+    uint16_t previous[LZ_WINDOW_SIZE];
+    uint8_t group[LZ_MAX_GROUP_SIZE];
+    uint8_t group_length;
+    uint8_t group_items;
+    size_t group_consumed;
+    LzGroupCallback callback;
+    void *context;
+} LzEncoder;
+
+typedef struct {
+    LzWindow window;
+    uint8_t flags;
+    uint8_t flag_bits;
+    int16_t match_high;
+    LzOutputCallback callback;
+    void *context;
+} LzDecoder;
+
+void lz_encoder_init(LzEncoder *encoder, LzGroupCallback callback, void *context);
+void lz_encode(LzEncoder *encoder, const uint8_t *data, size_t length);
+void lz_encoder_finish(LzEncoder *encoder);
+
+void lz_decoder_init(LzDecoder *decoder, LzOutputCallback callback, void *context);
+void lz_decode(LzDecoder *decoder, const uint8_t *data, size_t length);
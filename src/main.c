@@ -1,14 +1,26 @@
 #include <pebble.h>
 #include "appmessage.h"
+#include "favorites.h"
+#include "perf.h"
+#include "startup.h"
 #include "windows/testamentlist.h"
+#include "windows/viewer.h"
 
 static void init(void) {
+	perf_clock_init();
 	appmessage_init();
-	testamentlist_init();
+	favorites_init();
+	favorites_sync();
+	// straight back into the passage read last, if any
+	if (!viewer_resume()) {
+		testamentlist_init();
+	}
 }
 
 static void deinit(void) {
 	testamentlist_destroy();
+	favorites_deinit();
+	PERF_DEINIT();
 }
 
 int main(void) {
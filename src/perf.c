@@ -0,0 +1,236 @@
+#include <pebble.h>
+#include "perf.h"
+
+static time_t launch_seconds;
+static uint16_t launch_milliseconds;
+
+void perf_clock_init(void) {
+    launch_milliseconds = time_ms(&launch_seconds, NULL);
+}
+
+/*
+ * Milliseconds since launch
+ */
+uint32_t perf_clock_ms(void) {
+    time_t seconds;
+    uint16_t milliseconds = time_ms(&seconds, NULL);
+    return (seconds - launch_seconds) * 1000 + milliseconds - launch_milliseconds;
+}
+
+#if PERF_ENABLED
+
+#include "common.h"
+
+typedef struct {
+    Window *window;
+    PerfHeapMark mark;
+} PerfWindow;
+
+static PerfRecord *find_record(uint32_t token);
+static uint16_t elapsed(PerfRecord *record);
+static void mark_event(PerfRecord *record, PerfEvent event);
+
+// Ring of the latest requests, the oldest is overwritten
+static PerfRecord records[PERF_RING_SIZE];
+static int records_head;
+static int num_records;
+
+static PerfWindow windows[PERF_MAX_WINDOWS];
+static int num_windows;
+
+static uint32_t js_ready_time;
+static int inbox_drops;
+
+void perf_deinit(void) {
+    perf_export();
+}
+
+void perf_request_enqueued(uint32_t token, uint8_t request_type) {
+    if (request_type == RequestTypeCancel) {
+        return;
+    }
+    PerfRecord *record = &records[records_head];
+    records_head = (records_head + 1) % PERF_RING_SIZE;
+    if (num_records < PERF_RING_SIZE) {
+        num_records++;
+    }
+    memset(record, 0, sizeof(PerfRecord));
+    memset(record->events, 0xff, sizeof(record->events));
+    record->token = token;
+    record->request_type = request_type;
+    record->enqueued = perf_clock_ms();
+    perf_heap_sample();
+}
+
+/*
+ * Sending again only counts a retry, the timeline keeps the first attempt.
+ * A cancel carries the token of the request it cancels and is left out.
+ */
+void perf_request_sent(uint32_t token, uint8_t request_type, uint8_t send_attempts) {
+    PerfRecord *record = find_record(token);
+    if (record == NULL || request_type == RequestTypeCancel) {
+        return;
+    }
+    mark_event(record, PerfEventSend);
+    record->retries = send_attempts > 1 ? send_attempts - 1 : 0;
+}
+
+void perf_request_received(uint32_t token) {
+    PerfRecord *record = find_record(token);
+    if (record == NULL) {
+        return;
+    }
+    mark_event(record, PerfEventFirstChunk);
+    record->events[PerfEventLastChunk] = elapsed(record);
+    if (record->chunks < UINT8_MAX) {
+        record->chunks++;
+    }
+}
+
+/*
+ * A packet for a request that was already finished or cancelled
+ */
+void perf_request_late(uint32_t token) {
+    PerfRecord *record = find_record(token);
+    if (record != NULL && record->late < UINT8_MAX) {
+        record->late++;
+    }
+}
+
+/*
+ * The first draw showing what a request brought, earlier draws are ignored
+ */
+void perf_request_painted(uint32_t token) {
+    PerfRecord *record = find_record(token);
+    if (record != NULL && record->events[PerfEventFirstChunk] != PERF_NOT_YET) {
+        mark_event(record, PerfEventFirstPaint);
+    }
+}
+
+void perf_inbox_dropped(void) {
+    inbox_drops++;
+}
+
+void perf_js_ready(void) {
+    if (js_ready_time == 0) {
+        js_ready_time = perf_clock_ms();
+    }
+}
+
+/*
+ * Heap use is tracked per window from here on, by the window's name so it
+ * carries over when the window is created again
+ */
+void perf_window_register(Window *window, const char *name) {
+    for (int i = 0; i < num_windows; i++) {
+        if (strcmp(windows[i].mark.name, name) == 0) {
+            windows[i].window = window;
+            perf_heap_sample();
+            return;
+        }
+    }
+    if (num_windows == PERF_MAX_WINDOWS) {
+        return;
+    }
+    windows[num_windows].window = window;
+    strncpy(windows[num_windows].mark.name, name, sizeof(windows[num_windows].mark.name) - 1);
+    num_windows++;
+    perf_heap_sample();
+}
+
+/*
+ * Charge the heap in use to the window on top
+ */
+void perf_heap_sample(void) {
+    Window *top = window_stack_get_top_window();
+    uint32_t used = heap_bytes_used();
+    for (int i = 0; i < num_windows; i++) {
+        if (windows[i].window == top && used > windows[i].mark.high_water) {
+            windows[i].mark.high_water = used;
+        }
+    }
+}
+
+int perf_num_records(void) {
+    return num_records;
+}
+
+/*
+ * Newest first
+ */
+const PerfRecord *perf_get_record(int index) {
+    if (index >= num_records) {
+        return NULL;
+    }
+    return &records[(records_head - 1 - index + PERF_RING_SIZE) % PERF_RING_SIZE];
+}
+
+int perf_num_heap_marks(void) {
+    return num_windows;
+}
+
+const PerfHeapMark *perf_get_heap_mark(int index) {
+    return index < num_windows ? &windows[index].mark : NULL;
+}
+
+uint32_t perf_js_ready_time(void) {
+    return js_ready_time;
+}
+
+int perf_inbox_drops(void) {
+    return inbox_drops;
+}
+
+/*
+ * Hand the ring and the heap marks to the phone, oldest record first. The
+ * ring is kept, so exporting twice sends the same records twice.
+ */
+void perf_export(void) {
+    if (num_records > 0) {
+        DataLoggingSessionRef session = data_logging_create(PERF_REQUESTS_TAG, DATA_LOGGING_BYTE_ARRAY, sizeof(PerfRecord), false);
+        if (session != NULL) {
+            for (int i = num_records - 1; i >= 0; i--) {
+                data_logging_log(session, perf_get_record(i), 1);
+            }
+            data_logging_finish(session);
+        }
+    }
+    if (num_windows > 0) {
+        DataLoggingSessionRef session = data_logging_create(PERF_HEAP_TAG, DATA_LOGGING_BYTE_ARRAY, sizeof(PerfHeapMark), false);
+        if (session != NULL) {
+            for (int i = 0; i < num_windows; i++) {
+                data_logging_log(session, &windows[i].mark, 1);
+            }
+            data_logging_finish(session);
+        }
+    }
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "Exported %d requests and %d heap marks", num_records, num_windows);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+
+static PerfRecord *find_record(uint32_t token) {
+    for (int i = 0; i < num_records; i++) {
+        PerfRecord *record = &records[(records_head - 1 - i + PERF_RING_SIZE) % PERF_RING_SIZE];
+        if (record->token == token) {
+            return record;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Milliseconds since the request was enqueued, capped below PERF_NOT_YET
+ */
+static uint16_t elapsed(PerfRecord *record) {
+    uint32_t milliseconds = perf_clock_ms() - record->enqueued;
+    return milliseconds < PERF_NOT_YET ? milliseconds : PERF_NOT_YET - 1;
+}
+
+static void mark_event(PerfRecord *record, PerfEvent event) {
+    if (record->events[event] == PERF_NOT_YET) {
+        record->events[event] = elapsed(record);
+    }
+}
+
+#endif
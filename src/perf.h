@@ -0,0 +1,102 @@
+#pragma once
+
+#include <pebble.h>
+
+// Request timing and heap telemetry. Off unless built with PERF=1 (see
+// wscript), in which case the PERF_* macros below record into a fixed ring
+// and the debug window is reachable by long pressing the testament list.
+// Otherwise they expand to nothing and none of it is compiled in.
+#ifndef PERF_ENABLED
+#define PERF_ENABLED 0
+#endif
+
+// Millisecond clock from launch, always compiled in
+void perf_clock_init(void);
+uint32_t perf_clock_ms(void);
+
+#if PERF_ENABLED
+
+#if defined(PBL_PLATFORM_APLITE)
+#define PERF_RING_SIZE 16
+#else
+#define PERF_RING_SIZE 32
+#endif
+
+#define PERF_MAX_WINDOWS 8
+
+// DataLogging tags for the exported records and heap marks
+#define PERF_REQUESTS_TAG 0x50524551
+#define PERF_HEAP_TAG 0x50484550
+
+// Offset of an event not seen (yet)
+#define PERF_NOT_YET 0xffff
+
+typedef enum {
+    PerfEventSend,
+    PerfEventFirstChunk,
+    PerfEventLastChunk,
+    PerfEventFirstPaint,
+    PerfEventCount,
+} PerfEvent;
+
+// Timeline of one request, events in milliseconds after it was enqueued.
+// Exported as is, so the layout is part of the DataLogging format.
+typedef struct {
+    uint32_t token;
+    uint32_t enqueued;
+    uint16_t events[PerfEventCount];
+    uint8_t request_type;
+    uint8_t retries;
+    uint8_t chunks;
+    uint8_t late;
+} PerfRecord;
+
+typedef struct {
+    char name[12];
+    uint32_t high_water;
+} PerfHeapMark;
+
+void perf_deinit(void);
+void perf_request_enqueued(uint32_t token, uint8_t request_type);
+void perf_request_sent(uint32_t token, uint8_t request_type, uint8_t send_attempts);
+void perf_request_received(uint32_t token);
+void perf_request_late(uint32_t token);
+void perf_request_painted(uint32_t token);
+void perf_inbox_dropped(void);
+void perf_js_ready(void);
+void perf_window_register(Window *window, const char *name);
+void perf_heap_sample(void);
+
+int perf_num_records(void);
+const PerfRecord *perf_get_record(int index);
+int perf_num_heap_marks(void);
+const PerfHeapMark *perf_get_heap_mark(int index);
+uint32_t perf_js_ready_time(void);
+int perf_inbox_drops(void);
+void perf_export(void);
+
+#define PERF_DEINIT() perf_deinit()
+#define PERF_REQUEST_ENQUEUED(token, request_type) perf_request_enqueued(token, request_type)
+#define PERF_REQUEST_SENT(token, request_type, send_attempts) perf_request_sent(token, request_type, send_attempts)
+#define PERF_REQUEST_RECEIVED(token) perf_request_received(token)
+#define PERF_REQUEST_LATE(token) perf_request_late(token)
+#define PERF_REQUEST_PAINTED(token) perf_request_painted(token)
+#define PERF_INBOX_DROPPED() perf_inbox_dropped()
+#define PERF_JS_READY() perf_js_ready()
+#define PERF_WINDOW(window, name) perf_window_register(window, name)
+#define PERF_HEAP_SAMPLE() perf_heap_sample()
+
+#else
+
+#define PERF_DEINIT()
+#define PERF_REQUEST_ENQUEUED(token, request_type)
+#define PERF_REQUEST_SENT(token, request_type, send_attempts)
+#define PERF_REQUEST_RECEIVED(token)
+#define PERF_REQUEST_LATE(token)
+#define PERF_REQUEST_PAINTED(token)
+#define PERF_INBOX_DROPPED()
+#define PERF_JS_READY()
+#define PERF_WINDOW(window, name)
+#define PERF_HEAP_SAMPLE()
+
+#endif
@@ -0,0 +1,102 @@
+#include <pebble.h>
+#include "redraw.h"
+
+typedef struct {
+    MenuLayer *menu_layer;
+    bool dirty;
+    uint16_t requested;
+    uint16_t reloads;
+    uint16_t rows_drawn;
+} RedrawMenu;
+
+static RedrawMenu *find_menu(MenuLayer *menu_layer, bool add);
+static void reload(RedrawMenu *menu);
+static void timer_callback(void *data);
+
+static RedrawMenu menus[REDRAW_MAX_MENUS];
+static AppTimer *timer;
+
+/*
+ * Mark a menu's data as changed. The first change after a quiet interval
+ * reloads the menu straight away, later ones are folded into a single
+ * reload at the end of the interval.
+ */
+void redraw_menu(MenuLayer *menu_layer) {
+    RedrawMenu *menu = find_menu(menu_layer, true);
+    if (menu == NULL) {
+        menu_layer_reload_data(menu_layer);
+        return;
+    }
+    menu->requested++;
+    if (timer == NULL) {
+        reload(menu);
+        timer = app_timer_register(REDRAW_INTERVAL_MS, timer_callback, NULL);
+    } else {
+        menu->dirty = true;
+    }
+}
+
+/*
+ * Called from the menu's draw_row callback, for the stats
+ */
+void redraw_count_row(MenuLayer *menu_layer) {
+    RedrawMenu *menu = find_menu(menu_layer, false);
+    if (menu != NULL && menu->rows_drawn < UINT16_MAX) {
+        menu->rows_drawn++;
+    }
+}
+
+/*
+ * Drop a menu about to be destroyed, along with any reload still due
+ */
+void redraw_forget(MenuLayer *menu_layer) {
+    RedrawMenu *menu = find_menu(menu_layer, false);
+    if (menu == NULL) {
+        return;
+    }
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "Menu reloads: %d of %d requested, %d avoided, %d rows drawn",
+        menu->reloads, menu->requested, menu->requested - menu->reloads, menu->rows_drawn);
+    memset(menu, 0x0, sizeof(RedrawMenu));
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+
+static RedrawMenu *find_menu(MenuLayer *menu_layer, bool add) {
+    RedrawMenu *free_menu = NULL;
+    for (int i = 0; i < REDRAW_MAX_MENUS; i++) {
+        if (menus[i].menu_layer == menu_layer) {
+            return &menus[i];
+        }
+        if (menus[i].menu_layer == NULL && free_menu == NULL) {
+            free_menu = &menus[i];
+        }
+    }
+    if (add && free_menu != NULL) {
+        free_menu->menu_layer = menu_layer;
+    }
+    return add ? free_menu : NULL;
+}
+
+static void reload(RedrawMenu *menu) {
+    menu->dirty = false;
+    menu->reloads++;
+    menu_layer_reload_data(menu->menu_layer);
+}
+
+/*
+ * End of an interval: reload what changed during it and keep holding back
+ * for another interval, or stop if nothing did
+ */
+static void timer_callback(void *data) {
+    timer = NULL;
+    bool reloaded = false;
+    for (int i = 0; i < REDRAW_MAX_MENUS; i++) {
+        if (menus[i].menu_layer != NULL && menus[i].dirty) {
+            reload(&menus[i]);
+            reloaded = true;
+        }
+    }
+    if (reloaded) {
+        timer = app_timer_register(REDRAW_INTERVAL_MS, timer_callback, NULL);
+    }
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <pebble.h>
+
+// Menu reloads are held back to one per layer per frame interval
+#define REDRAW_INTERVAL_MS 50
+
+// Most menus waiting on a reload at once, one per window on the stack is plenty
+#define REDRAW_MAX_MENUS 4
+
+void redraw_menu(MenuLayer *menu_layer);
+void redraw_count_row(MenuLayer *menu_layer);
+void redraw_forget(MenuLayer *menu_layer);
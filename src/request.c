@@ -0,0 +1,125 @@
+#include <pebble.h>
+#include "request.h"
+#include "perf.h"
+
+// Ids stay positive so they survive the int32 round trip through KEY_TOKEN
+#define REQUEST_ID_MASK     0x7FFFFFFF
+#define REQUEST_ID_SEED_BITS 12
+
+typedef struct {
+    uint32_t id;
+    uint32_t heard;
+    uint8_t type;
+    uint8_t state;
+} LiveRequest;
+
+static LiveRequest *find_request(uint32_t id);
+static bool expire(LiveRequest *request);
+
+static LiveRequest requests[REQUEST_TABLE_SIZE];
+static uint32_t next_id;
+
+/*
+ * Ids increase by one per request. The starting point comes from the clock
+ * so that replies still queued on the phone for a previous launch of the
+ * app never match a request of this one. The clock is rotated rather than
+ * shifted into the id, so none of it is lost and a starting point only
+ * comes round again after 2^31 seconds.
+ */
+void request_init(void) {
+    memset(requests, 0, sizeof(requests));
+    uint32_t seconds = (uint32_t)time(NULL) & REQUEST_ID_MASK;
+    next_id = ((seconds << REQUEST_ID_SEED_BITS) | (seconds >> (31 - REQUEST_ID_SEED_BITS))) & REQUEST_ID_MASK;
+}
+
+/*
+ * Takes the oldest slot that is not live. Returns 0 if every request in the
+ * table is still live, a live request is never forgotten to make room.
+ */
+uint32_t request_allocate(RequestType type) {
+    LiveRequest *request = NULL;
+    for (int i = 0; i < REQUEST_TABLE_SIZE; i++) {
+        if (requests[i].state == RequestStateLive && !expire(&requests[i])) {
+            continue;
+        }
+        // free, or else the oldest allowing for ids wrapping
+        if (request == NULL || requests[i].state == RequestStateFree ||
+                (request->state != RequestStateFree && requests[i].id - request->id > REQUEST_ID_MASK / 2)) {
+            request = &requests[i];
+        }
+    }
+    if (request == NULL) {
+        APP_LOG(APP_LOG_LEVEL_WARNING, "No free request slot for type %d", type);
+        return 0;
+    }
+
+    next_id = (next_id + 1) & REQUEST_ID_MASK;
+    if (next_id == 0) {
+        next_id = 1;
+    }
+    request->id = next_id;
+    request->heard = perf_clock_ms();
+    request->type = type;
+    request->state = RequestStateLive;
+    return next_id;
+}
+
+/*
+ * Whether replies for a request are still wanted. The table is small, so
+ * late packets can be dropped before anything looks at their content. A
+ * request past its deadline is cancelled here, which is how its owner
+ * finds out.
+ */
+bool request_is_live(uint32_t id) {
+    LiveRequest *request = find_request(id);
+    return request != NULL && request->state == RequestStateLive && !expire(request);
+}
+
+/*
+ * The phone has the request or answered it, its deadline starts over
+ */
+void request_heard(uint32_t id) {
+    LiveRequest *request = find_request(id);
+    if (request != NULL && request->state == RequestStateLive) {
+        request->heard = perf_clock_ms();
+    }
+}
+
+void request_finish(uint32_t id) {
+    LiveRequest *request = find_request(id);
+    if (request != NULL && request->state == RequestStateLive) {
+        request->state = RequestStateFinished;
+    }
+}
+
+void request_cancel(uint32_t id) {
+    LiveRequest *request = find_request(id);
+    if (request != NULL && request->state == RequestStateLive) {
+        request->state = RequestStateCancelled;
+    }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+
+static LiveRequest *find_request(uint32_t id) {
+    if (id == 0) {
+        return NULL;
+    }
+    for (int i = 0; i < REQUEST_TABLE_SIZE; i++) {
+        if (requests[i].id == id && requests[i].state != RequestStateFree) {
+            return &requests[i];
+        }
+    }
+    return NULL;
+}
+
+static bool expire(LiveRequest *request) {
+    if (perf_clock_ms() - request->heard < REQUEST_TIMEOUT_MS) {
+        return false;
+    }
+    // not a warning, requests nobody marks finished, like the verse list's,
+    // end up here too
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "Request %d of type %d timed out", (int)request->id, request->type);
+    request->state = RequestStateCancelled;
+    return true;
+}
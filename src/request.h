@@ -0,0 +1,31 @@
+#pragma once
+
+#include "common.h"
+
+// Requests are kept until their slot is needed by a new one, and only once
+// they are no longer live. At most one request per window is live at a time,
+// plus Configure until it is sent and favorite toggles until the phone
+// answers, so allocation only fails while the phone is not answering at
+// all, until those requests time out.
+#define REQUEST_TABLE_SIZE 16
+
+// A live request that nothing has been heard of for this long is given up
+// on. The phone stops sending a reply without a word once a message of it
+// keeps failing (see nacked() in js/transport.js), so without a deadline
+// the request would stay live for good. Longer than the phone's HTTP
+// timeout, which is the longest a reply can take to start.
+#define REQUEST_TIMEOUT_MS 30000
+
+typedef enum {
+    RequestStateFree,
+    RequestStateLive,
+    RequestStateFinished,
+    RequestStateCancelled,
+} RequestState;
+
+void request_init(void);
+uint32_t request_allocate(RequestType type);
+bool request_is_live(uint32_t id);
+void request_heard(uint32_t id);
+void request_finish(uint32_t id);
+void request_cancel(uint32_t id);
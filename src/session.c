@@ -0,0 +1,30 @@
+#include <pebble.h>
+#include "session.h"
+#include "bible.h"
+
+/*
+ * Returns false if no position was stored, or it no longer makes sense
+ */
+bool session_restore(Session *session) {
+    if (persist_read_data(SESSION_KEY, session, sizeof(Session)) != (int)sizeof(Session) ||
+            session->format != SESSION_FORMAT || session->book >= BIBLE_NUM_BOOKS ||
+            session->chapter < 1 || session->chapter > bible_books[session->book].chapters) {
+        return false;
+    }
+    session->range[sizeof(session->range) - 1] = '\0';
+    return true;
+}
+
+/*
+ * Remember a passage and how far down it was read, in pixels from its start
+ */
+void session_save(int book, int chapter, const char *range, int32_t scroll_offset) {
+    Session session;
+    memset(&session, 0x0, sizeof(session));
+    session.format = SESSION_FORMAT;
+    session.book = book;
+    session.chapter = chapter;
+    strncpy(session.range, range, sizeof(session.range) - 1);
+    session.scroll_offset = scroll_offset;
+    persist_write_data(SESSION_KEY, &session, sizeof(session));
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "common.h"
+
+// Persist key, clear of COACHMARK_VERSION_KEY, the passage cache and favorites
+#define SESSION_KEY         300
+
+// Bump whenever Session changes to forget stored positions
+#define SESSION_FORMAT      2
+
+// Where reading stopped, restored at the next launch
+typedef struct {
+    uint8_t format;
+    uint8_t book;
+    uint8_t chapter;
+    char range[8];
+    int32_t scroll_offset;
+} Session;
+
+bool session_restore(Session *session);
+void session_save(int book, int chapter, const char *range, int32_t scroll_offset);
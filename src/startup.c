@@ -0,0 +1,25 @@
+#include <pebble.h>
+#include "perf.h"
+#include "startup.h"
+
+static int32_t phone_ready_time = -1;
+static bool interactive;
+
+void startup_phone_ready(void) {
+    if (phone_ready_time < 0) {
+        phone_ready_time = (int32_t)perf_clock_ms();
+        APP_LOG(APP_LOG_LEVEL_INFO, "Cold start: phone ready after %d ms", (int)phone_ready_time);
+    }
+}
+
+/*
+ * Only the first screen drawn with its content counts
+ */
+void startup_interactive(const char *screen) {
+    if (interactive) {
+        return;
+    }
+    interactive = true;
+    APP_LOG(APP_LOG_LEVEL_INFO, "Cold start: %s interactive after %d ms, %s", screen, (int)perf_clock_ms(),
+        phone_ready_time < 0 ? "before the phone was ready" : "after the phone was ready");
+}
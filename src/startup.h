@@ -0,0 +1,9 @@
+#pragma once
+
+#include <pebble.h>
+
+// Cold start timing: from launch to the handshake with the phone and to
+// the first screen showing something the user can act on
+
+void startup_phone_ready(void);
+void startup_interactive(const char *screen);
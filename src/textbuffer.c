@@ -0,0 +1,165 @@
+#include <pebble.h>
+#include "textbuffer.h"
+
+#define INITIAL_CAPACITY 256
+
+static bool add_in_order(TextBuffer *buffer, const char *chunk, size_t length);
+static void decoded(const uint8_t *data, size_t length, void *context);
+static void track_heap(TextBuffer *buffer, int delta);
+
+void text_buffer_init(TextBuffer *buffer) {
+    memset(buffer, 0, sizeof(TextBuffer));
+}
+
+void text_buffer_deinit(TextBuffer *buffer) {
+    if (buffer->text != NULL) {
+        free(buffer->text);
+    }
+    for (int i = 0; i < TEXT_BUFFER_MAX_PENDING; i++) {
+        if (buffer->pending[i] != NULL) {
+            free(buffer->pending[i]);
+        }
+    }
+    APP_LOG(APP_LOG_LEVEL_DEBUG, "text buffer: %d bytes of text, peak heap %d bytes", (int)buffer->length, (int)buffer->peak_heap_bytes);
+    text_buffer_init(buffer);
+}
+
+/*
+ * Add the chunk with the given index. Chunks are appended in index order:
+ * duplicates are ignored and chunks arriving ahead of a gap are held until
+ * the gap is filled. Returns true if the text grew.
+ */
+bool text_buffer_add_chunk(TextBuffer *buffer, int index, const char *chunk, size_t length) {
+    if (index < buffer->next_index) {
+        return false;
+    }
+
+    if (index > buffer->next_index) {
+        int slot = index - buffer->next_index - 1;
+        if (slot >= TEXT_BUFFER_MAX_PENDING) {
+            APP_LOG(APP_LOG_LEVEL_WARNING, "text buffer: chunk %d too far ahead of %d", index, buffer->next_index);
+            return false;
+        }
+        if (buffer->pending[slot] == NULL) {
+            buffer->pending[slot] = malloc(length);
+            if (buffer->pending[slot] == NULL && length > 0) {
+                return false;
+            }
+            memcpy(buffer->pending[slot], chunk, length);
+            buffer->pending_length[slot] = length;
+            track_heap(buffer, length);
+        }
+        return false;
+    }
+
+    size_t before = buffer->appended;
+    if (!add_in_order(buffer, chunk, length)) {
+        return false;
+    }
+    buffer->next_index++;
+
+    while (buffer->pending[0] != NULL) {
+        char *pending = buffer->pending[0];
+        size_t pending_length = buffer->pending_length[0];
+        memmove(&buffer->pending[0], &buffer->pending[1], sizeof(buffer->pending[0]) * (TEXT_BUFFER_MAX_PENDING - 1));
+        memmove(&buffer->pending_length[0], &buffer->pending_length[1], sizeof(buffer->pending_length[0]) * (TEXT_BUFFER_MAX_PENDING - 1));
+        buffer->pending[TEXT_BUFFER_MAX_PENDING - 1] = NULL;
+        bool added = add_in_order(buffer, pending, pending_length);
+        track_heap(buffer, -(int)pending_length);
+        free(pending);
+        if (!added) {
+            break;
+        }
+        buffer->next_index++;
+    }
+    return buffer->appended > before;
+}
+
+/*
+ * Decompress the chunks that follow with decoder instead of appending them
+ * as they are, NULL to go back to plain text. The decoder is reset here, a
+ * compressed stream starts with the next chunk.
+ */
+void text_buffer_set_decoder(TextBuffer *buffer, LzDecoder *decoder) {
+    buffer->decoder = decoder;
+    if (decoder != NULL) {
+        lz_decoder_init(decoder, decoded, buffer);
+    }
+}
+
+/*
+ * Drop length bytes off the front of the text, once they have been moved
+ * somewhere else
+ */
+void text_buffer_consume(TextBuffer *buffer, size_t length) {
+    if (length > buffer->length) {
+        length = buffer->length;
+    }
+    memmove(buffer->text, buffer->text + length, buffer->length - length + 1);
+    buffer->length -= length;
+}
+
+/*
+ * Start numbering chunks from 0 again for a new request, keeping the text.
+ * The new request's chunks are plain text until a decoder is set.
+ */
+void text_buffer_restart(TextBuffer *buffer) {
+    for (int i = 0; i < TEXT_BUFFER_MAX_PENDING; i++) {
+        if (buffer->pending[i] != NULL) {
+            track_heap(buffer, -(int)buffer->pending_length[i]);
+            free(buffer->pending[i]);
+            buffer->pending[i] = NULL;
+        }
+    }
+    buffer->next_index = 0;
+    buffer->decoder = NULL;
+}
+
+/*
+ * Append text that does not come in numbered chunks, such as a passage
+ * restored from the cache. Returns false if the buffer could not grow.
+ */
+bool text_buffer_append(TextBuffer *buffer, const char *text, size_t length) {
+    size_t required = buffer->length + length + 1;
+    if (required > buffer->capacity) {
+        // grow geometrically so appends are amortized O(1)
+        size_t capacity = buffer->capacity ? buffer->capacity : INITIAL_CAPACITY;
+        while (capacity < required) {
+            capacity *= 2;
+        }
+        char *grown = realloc(buffer->text, capacity);
+        if (grown == NULL) {
+            APP_LOG(APP_LOG_LEVEL_ERROR, "text buffer: out of memory growing to %d bytes", (int)capacity);
+            return false;
+        }
+        track_heap(buffer, capacity - buffer->capacity);
+        buffer->text = grown;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->text + buffer->length, text, length);
+    buffer->length += length;
+    buffer->text[buffer->length] = '\0';
+    buffer->appended += length;
+    return true;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+
+static bool add_in_order(TextBuffer *buffer, const char *chunk, size_t length) {
+    if (buffer->decoder == NULL) {
+        return text_buffer_append(buffer, chunk, length);
+    }
+    lz_decode(buffer->decoder, (const uint8_t *)chunk, length);
+    return true;
+}
+
+static void decoded(const uint8_t *data, size_t length, void *context) {
+    text_buffer_append((TextBuffer *)context, (const char *)data, length);
+}
+
+static void track_heap(TextBuffer *buffer, int delta) {
+    buffer->heap_bytes += delta;
+    if (buffer->heap_bytes > buffer->peak_heap_bytes) {
+        buffer->peak_heap_bytes = buffer->heap_bytes;
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "lz.h"
+
+// must match options.appMessage.maxWindow in pebble-js-app.js
+#define TEXT_BUFFER_MAX_PENDING 8
+
+typedef struct {
+    char *text;
+    size_t length;
+    size_t capacity;
+    size_t appended;
+    int next_index;
+    char *pending[TEXT_BUFFER_MAX_PENDING];
+    uint16_t pending_length[TEXT_BUFFER_MAX_PENDING];
+    LzDecoder *decoder;
+    size_t heap_bytes;
+    size_t peak_heap_bytes;
+} TextBuffer;
+
+void text_buffer_init(TextBuffer *buffer);
+void text_buffer_deinit(TextBuffer *buffer);
+bool text_buffer_add_chunk(TextBuffer *buffer, int index, const char *chunk, size_t length);
+void text_buffer_set_decoder(TextBuffer *buffer, LzDecoder *decoder);
+bool text_buffer_append(TextBuffer *buffer, const char *text, size_t length);
+void text_buffer_consume(TextBuffer *buffer, size_t length);
+void text_buffer_restart(TextBuffer *buffer);
@@ -0,0 +1,239 @@
+#include <pebble.h>
+#include "textlayout.h"
+
+// A block closes at the first line break after BLOCK_MIN_LENGTH bytes, or at
+// a space once it reaches BLOCK_MAX_LENGTH without one
+#define BLOCK_MIN_LENGTH    192
+#define BLOCK_MAX_LENGTH    768
+#define MAX_BLOCK_HEIGHT    4000
+
+// Content sizes and offsets are int16, so once the layout grows past
+// MAX_LAYOUT_HEIGHT px the blocks far above the screen are dropped until it
+// is back under TRIMMED_LAYOUT_HEIGHT
+#define MAX_LAYOUT_HEIGHT       16000
+#define TRIMMED_LAYOUT_HEIGHT   8000
+
+static int find_block_end(const char *text, size_t length);
+static int16_t measure(TextLayout *layout, const char *text);
+static bool add_block(TextLayout *layout, const char *text, size_t length, size_t span);
+
+void text_layout_init(TextLayout *layout, GFont font, GTextAlignment alignment, int16_t width) {
+    memset(layout, 0, sizeof(TextLayout));
+    layout->font = font;
+    layout->alignment = alignment;
+    layout->width = width;
+}
+
+void text_layout_deinit(TextLayout *layout) {
+    for (int i = 0; i < layout->num_blocks; i++) {
+        if (layout->blocks[i].text != NULL) {
+            free(layout->blocks[i].text);
+        }
+    }
+    if (layout->blocks != NULL) {
+        free(layout->blocks);
+    }
+    memset(layout, 0, sizeof(TextLayout));
+}
+
+/*
+ * Move every complete block off the front of the buffer and measure it once.
+ * Whatever is left in the buffer is the tail, which is re-measured on each
+ * update but never grows past BLOCK_MAX_LENGTH plus one chunk.
+ */
+void text_layout_update(TextLayout *layout, TextBuffer *buffer) {
+    int end;
+    while (buffer->length > 0 && (end = find_block_end(buffer->text, buffer->length)) > 0) {
+        size_t length = end;
+        // the line break closing a block is implied by the next block starting below it
+        if (buffer->text[length - 1] == '\n') {
+            length--;
+        }
+        if (!add_block(layout, buffer->text, length, end)) {
+            break;
+        }
+        text_buffer_consume(buffer, end);
+    }
+
+    layout->tail = buffer->length > 0 ? buffer->text : NULL;
+    layout->tail_height = layout->tail != NULL ? measure(layout, layout->tail) : 0;
+}
+
+int32_t text_layout_get_height(TextLayout *layout) {
+    return layout->blocks_height + layout->tail_height;
+}
+
+/*
+ * Draw the blocks that intersect [top, bottom] in layout coordinates
+ */
+void text_layout_draw(TextLayout *layout, GContext *ctx, int32_t top, int32_t bottom) {
+    int32_t y = 0;
+    for (int i = 0; i < layout->num_blocks && y <= bottom; i++) {
+        TextBlock *block = &layout->blocks[i];
+        if (y + block->height >= top && block->text != NULL) {
+            graphics_draw_text(ctx, block->text, layout->font, GRect(0, y, layout->width, block->height),
+                GTextOverflowModeWordWrap, layout->alignment, NULL);
+        }
+        y += block->height;
+    }
+    if (layout->tail != NULL && y <= bottom) {
+        graphics_draw_text(ctx, layout->tail, layout->font, GRect(0, y, layout->width, layout->tail_height),
+            GTextOverflowModeWordWrap, layout->alignment, NULL);
+    }
+}
+
+/*
+ * Free the text of every block outside [top, bottom]. The block keeps its
+ * height and byte range, so the layout does not move and the text can be
+ * fetched again with the block's offset.
+ */
+void text_layout_evict(TextLayout *layout, int32_t top, int32_t bottom) {
+    int32_t y = 0;
+    for (int i = 0; i < layout->num_blocks; i++) {
+        TextBlock *block = &layout->blocks[i];
+        if (block->text != NULL && (y + block->height < top || y > bottom)) {
+            free(block->text);
+            block->text = NULL;
+        }
+        y += block->height;
+    }
+}
+
+/*
+ * Find the first run of evicted blocks that intersects [top, bottom], no
+ * longer than max_bytes unless a single block is
+ */
+bool text_layout_find_evicted(TextLayout *layout, int32_t top, int32_t bottom, size_t max_bytes, int *first, int *last) {
+    int32_t y = 0;
+    *first = -1;
+    for (int i = 0; i < layout->num_blocks && y <= bottom; i++) {
+        TextBlock *block = &layout->blocks[i];
+        bool visible = y + block->height >= top;
+        y += block->height;
+        if (!visible) {
+            continue;
+        }
+        if (block->text == NULL) {
+            if (*first < 0) {
+                *first = i;
+            } else if (block->offset + block->span - layout->blocks[*first].offset > max_bytes) {
+                break;
+            }
+            *last = i;
+        } else if (*first >= 0) {
+            break;
+        }
+    }
+    return *first >= 0;
+}
+
+/*
+ * Keep a long stream within int16 coordinates: once the layout is taller
+ * than MAX_LAYOUT_HEIGHT, forget the blocks wholly above top altogether, text
+ * and metadata, which moves everything below up. Returns how far, in px,
+ * the caller has to move its own offsets too. Block indexes change, so
+ * nothing may hold on to one across a trim.
+ */
+int16_t text_layout_trim(TextLayout *layout, int32_t top) {
+    if (text_layout_get_height(layout) <= MAX_LAYOUT_HEIGHT) {
+        return 0;
+    }
+    int32_t dropped = 0;
+    int count = 0;
+    while (count < layout->num_blocks && text_layout_get_height(layout) - dropped > TRIMMED_LAYOUT_HEIGHT &&
+            dropped + layout->blocks[count].height < top) {
+        if (layout->blocks[count].text != NULL) {
+            free(layout->blocks[count].text);
+        }
+        dropped += layout->blocks[count].height;
+        count++;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    memmove(layout->blocks, &layout->blocks[count], (layout->num_blocks - count) * sizeof(TextBlock));
+    layout->num_blocks -= count;
+    layout->blocks_height -= dropped;
+    layout->origin += dropped;
+    return dropped;
+}
+
+/*
+ * Give blocks first..last their text back. text holds the bytes starting at
+ * the offset of the first block.
+ */
+void text_layout_fill(TextLayout *layout, int first, int last, const char *text, size_t length) {
+    uint32_t start = layout->blocks[first].offset;
+    for (int i = first; i <= last; i++) {
+        TextBlock *block = &layout->blocks[i];
+        if (block->text != NULL || block->offset - start + block->length > length) {
+            continue;
+        }
+        block->text = malloc(block->length + 1);
+        if (block->text == NULL) {
+            return;
+        }
+        memcpy(block->text, text + (block->offset - start), block->length);
+        block->text[block->length] = '\0';
+    }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+
+static int find_block_end(const char *text, size_t length) {
+    if (length <= BLOCK_MIN_LENGTH) {
+        return 0;
+    }
+    const char *line_end = strchr(text + BLOCK_MIN_LENGTH, '\n');
+    if (line_end != NULL && line_end - text < BLOCK_MAX_LENGTH) {
+        return line_end - text + 1;
+    }
+    if (length < BLOCK_MAX_LENGTH) {
+        return 0;
+    }
+    for (int i = BLOCK_MAX_LENGTH - 1; i > BLOCK_MIN_LENGTH; i--) {
+        if (text[i] == ' ') {
+            return i + 1;
+        }
+    }
+    // no space to break at, split before a character rather than inside one
+    int end = BLOCK_MAX_LENGTH;
+    while (end > 0 && (text[end] & 0xC0) == 0x80) {
+        end--;
+    }
+    return end;
+}
+
+static int16_t measure(TextLayout *layout, const char *text) {
+    return graphics_text_layout_get_content_size(text, layout->font, GRect(0, 0, layout->width, MAX_BLOCK_HEIGHT),
+        GTextOverflowModeWordWrap, layout->alignment).h;
+}
+
+static bool add_block(TextLayout *layout, const char *text, size_t length, size_t span) {
+    if (layout->num_blocks == layout->capacity) {
+        int capacity = layout->capacity ? layout->capacity * 2 : 8;
+        TextBlock *blocks = realloc(layout->blocks, capacity * sizeof(TextBlock));
+        if (blocks == NULL) {
+            return false;
+        }
+        layout->blocks = blocks;
+        layout->capacity = capacity;
+    }
+
+    TextBlock *block = &layout->blocks[layout->num_blocks];
+    block->text = malloc(length + 1);
+    if (block->text == NULL) {
+        return false;
+    }
+    memcpy(block->text, text, length);
+    block->text[length] = '\0';
+    block->offset = layout->next_offset;
+    block->length = length;
+    block->span = span;
+    block->height = measure(layout, block->text);
+
+    layout->next_offset += span;
+    layout->blocks_height += block->height;
+    layout->num_blocks++;
+    return true;
+}
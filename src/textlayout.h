@@ -0,0 +1,37 @@
+#pragma once
+
+#include "textbuffer.h"
+
+typedef struct {
+    char *text;
+    uint32_t offset;
+    uint16_t length;
+    uint16_t span;
+    int16_t height;
+} TextBlock;
+
+typedef struct {
+    TextBlock *blocks;
+    int num_blocks;
+    int capacity;
+    // Height of the blocks dropped off the top by text_layout_trim(), the
+    // layout's own coordinates start there
+    int32_t origin;
+    int32_t blocks_height;
+    int16_t tail_height;
+    const char *tail;
+    GFont font;
+    GTextAlignment alignment;
+    int16_t width;
+    uint32_t next_offset;
+} TextLayout;
+
+void text_layout_init(TextLayout *layout, GFont font, GTextAlignment alignment, int16_t width);
+void text_layout_deinit(TextLayout *layout);
+void text_layout_update(TextLayout *layout, TextBuffer *buffer);
+int32_t text_layout_get_height(TextLayout *layout);
+void text_layout_draw(TextLayout *layout, GContext *ctx, int32_t top, int32_t bottom);
+void text_layout_evict(TextLayout *layout, int32_t top, int32_t bottom);
+bool text_layout_find_evicted(TextLayout *layout, int32_t top, int32_t bottom, size_t max_bytes, int *first, int *last);
+int16_t text_layout_trim(TextLayout *layout, int32_t top);
+void text_layout_fill(TextLayout *layout, int first, int last, const char *text, size_t length);
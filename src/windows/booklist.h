@@ -3,5 +3,5 @@
 #pragma once
 
 void booklist_init(TestamentType testament);
+void booklist_resume(int book_index, int chapter);
 void booklist_destroy(void);
-void booklist_in_received_handler(DictionaryIterator *iter);
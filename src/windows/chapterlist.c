@@ -3,6 +3,7 @@
 #include "../libs/pebble-assist.h"
 #include "../common.h"
 #include "verseslist.h"
+#include "../perf.h"
 
 #define MAX_CHAPTERS 150
 
@@ -21,6 +22,7 @@ static MenuLayer *menu_layer;
 
 void chapterlist_init(Book *book) {
 	window = window_create();
+	PERF_WINDOW(window, "chapters");
   current_book = book;
 
 	menu_layer = menu_layer_create_fullscreen(window);
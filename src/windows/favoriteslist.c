@@ -3,16 +3,12 @@
 #include "viewer.h"
 #include "../libs/pebble-assist.h"
 #include "../common.h"
-#include "../appmessage.h"
+#include "../favorites.h"
+#include "../bible.h"
+#include "../perf.h"
+#include "../redraw.h"
 
-#define MAX_FAVORITES 20
-
-static Favorite favorites[MAX_FAVORITES];
-
-static int num_favorites;
-static int favorites_request_token;
-
-static void refresh_list();
+static void favorites_changed(void);
 static uint16_t menu_get_num_sections_callback(struct MenuLayer *menu_layer, void *callback_context);
 static uint16_t menu_get_num_rows_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context);
 static int16_t menu_get_header_height_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context);
@@ -26,10 +22,10 @@ static void window_unload(Window *window);
 
 static Window *window;
 static MenuLayer *menu_layer;
-static bool favorites_is_dirty = true;
 
 void favoriteslist_init() {
     window = window_create();
+    PERF_WINDOW(window, "favorites");
     
     window_set_window_handlers(window, (WindowHandlers) {
         .appear = window_appear,
@@ -50,6 +46,7 @@ void favoriteslist_init() {
     menu_layer_set_click_config_onto_window(menu_layer, window);
     menu_layer_add_to_window(menu_layer, window);
     
+    favorites_subscribe(favorites_changed);
     window_stack_push(window, true);
 }
 
@@ -60,51 +57,10 @@ void favoriteslist_destroy(void) {
     window_destroy_safe(window);
 }
 
-void favoriteslist_mark_dirty(void) {
-    favorites_is_dirty = true;
-}
-
-void favoriteslist_in_received_handler(DictionaryIterator *iter) {
-    Tuple *token_tuple = dict_find(iter, KEY_TOKEN);
-    Tuple *index_tuple = dict_find(iter, KEY_INDEX);
-    Tuple *book_tuple = dict_find(iter, KEY_BOOK);
-    Tuple *chapter_tuple = dict_find(iter, KEY_CHAPTER);
-    Tuple *range_tuple = dict_find(iter, KEY_RANGE);
-    
-    if (!token_tuple || token_tuple->value->int32 != favorites_request_token) {
-        return;
-    }
-
-    favorites_is_dirty = false;
-    if (index_tuple && token_tuple && book_tuple && chapter_tuple && range_tuple) {
-        if (index_tuple->value->int16 > MAX_FAVORITES) return;
-        
-        Favorite favorite;
-        favorite.chapter = chapter_tuple->value->int16;
-        strncpy(favorite.range, range_tuple->value->cstring, sizeof(favorite.range));
-        
-        Book book;
-        strncpy(book.name, book_tuple->value->cstring, sizeof(book.name));
-        favorite.book = book;
-        
-        favorites[index_tuple->value->int16] = favorite;
-        num_favorites++;
-    }
-    menu_layer_reload_data(menu_layer);
-}
-
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
 
-static void refresh_list() {
-    if (!favorites_is_dirty) {
-        return;
-    }
-    memset(favorites, 0x0, sizeof(favorites));
-    num_favorites = 0;
-    menu_layer_set_selected_index(menu_layer, (MenuIndex) { .row = 0, .section = 0 }, MenuRowAlignBottom, false);
-    menu_layer_reload_data(menu_layer);
-    favorites_request_token = appmessage_favoriteslist_request_data();
-    menu_layer_reload_data(menu_layer);
+static void favorites_changed(void) {
+    redraw_menu(menu_layer);
 }
 
 static uint16_t menu_get_num_sections_callback(struct MenuLayer *menu_layer, void *callback_context) {
@@ -112,7 +68,7 @@ static uint16_t menu_get_num_sections_callback(struct MenuLayer *menu_layer, voi
 }
 
 static uint16_t menu_get_num_rows_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context) {
-    return (num_favorites) ? num_favorites : 1;
+    return favorites_count() ? favorites_count() : 1;
 }
 
 static int16_t menu_get_header_height_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context) {
@@ -120,7 +76,7 @@ static int16_t menu_get_header_height_callback(struct MenuLayer *menu_layer, uin
 }
 
 static int16_t menu_get_cell_height_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
-    if (num_favorites == 0 && !favorites_is_dirty) return 86;
+    if (favorites_count() == 0 && favorites_synced()) return 86;
     return 34;
 }
 
@@ -140,6 +96,7 @@ static void menu_draw_header_callback(GContext *ctx, const Layer *cell_layer, ui
 }
 
 static void menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *callback_context) {
+    redraw_count_row(menu_layer);
     if (menu_cell_layer_is_highlighted(cell_layer)) {
         graphics_context_set_text_color(ctx, GColorWhite);
     } else {
@@ -150,17 +107,17 @@ static void menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuI
 	const char *font = FONT_KEY_GOTHIC_24;
 	int height = 28;
 	int margin = PBL_IF_ROUND_ELSE(0, 8);
-    if (favorites_is_dirty) {
+    if (favorites_count() == 0 && !favorites_synced()) {
     	row_text = "Loading...";
-    } else if (num_favorites == 0) {
+    } else if (favorites_count() == 0) {
 		row_text = "Double tap the “Select” button while reading to add or remove favorites";
 		font = FONT_KEY_GOTHIC_18;
 		height = 80;
 		margin = 8;
     } else {
-        Favorite favorite = favorites[cell_index->row];
+        const Favorite *favorite = favorites_get(cell_index->row);
         static char title[40];
-        snprintf(title, sizeof(title), "%s %d:%s", favorite.book.name, favorite.chapter, favorite.range);
+        snprintf(title, sizeof(title), "%s %d:%s", bible_books[favorite->book].name, favorite->chapter, favorite->range);
         row_text = title;
     }
     
@@ -176,21 +133,27 @@ static void menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuI
 }
 
 static void menu_select_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
-    if (num_favorites == 0) {
+    const Favorite *favorite = favorites_get(cell_index->row);
+    if (favorite == NULL) {
         return;
     }
-    Favorite favorite = favorites[cell_index->row];
-    viewer_init(&favorite.book, favorite.chapter, favorite.range);
+    Book book;
+    bible_book_at_index(favorite->book, &book);
+    char range[sizeof(favorite->range)];
+    strcpy(range, favorite->range);
+    viewer_init(&book, favorite->chapter, range);
 }
 
 static void menu_select_long_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
-    refresh_list();
+    favorites_sync();
 }
 
 static void window_appear(Window *window) {
-    refresh_list();
+    redraw_menu(menu_layer);
+    favorites_sync();
 }
 
 static void window_unload(Window *window) {
-    appmessage_cancel_request(favorites_request_token);
+    favorites_subscribe(NULL);
+    redraw_forget(menu_layer);
 }
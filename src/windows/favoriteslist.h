@@ -4,5 +4,4 @@
 
 void favoriteslist_init();
 void favoriteslist_destroy(void);
-void favoriteslist_in_received_handler(DictionaryIterator *iter);
-void favoriteslist_mark_dirty(void);
+
@@ -0,0 +1,165 @@
+#include <pebble.h>
+#include "perflist.h"
+#include "../perf.h"
+
+#if PERF_ENABLED
+
+#include "../libs/pebble-assist.h"
+#include "../common.h"
+
+static const char *request_type_to_string(uint8_t request_type);
+static void format_event(char *buffer, size_t size, const char *label, uint16_t offset);
+static uint16_t menu_get_num_sections_callback(struct MenuLayer *menu_layer, void *callback_context);
+static uint16_t menu_get_num_rows_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context);
+static int16_t menu_get_header_height_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context);
+static void menu_draw_header_callback(GContext *ctx, const Layer *cell_layer, uint16_t section_index, void *callback_context);
+static void menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *callback_context);
+static void menu_select_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
+static void window_appear(Window *window);
+
+static Window *window;
+static MenuLayer *menu_layer;
+
+/*
+ * Hidden window listing the instrumentation, see perf.h
+ */
+void perflist_init(void) {
+    window = window_create();
+
+    window_set_window_handlers(window, (WindowHandlers) {
+        .appear = window_appear,
+    });
+
+    menu_layer = menu_layer_create_fullscreen(window);
+    menu_layer_set_callbacks(menu_layer, NULL, (MenuLayerCallbacks) {
+        .get_num_sections = menu_get_num_sections_callback,
+        .get_num_rows = menu_get_num_rows_callback,
+        .get_header_height = menu_get_header_height_callback,
+        .draw_header = menu_draw_header_callback,
+        .draw_row = menu_draw_row_callback,
+        .select_click = menu_select_callback,
+    });
+    menu_layer_set_click_config_onto_window(menu_layer, window);
+    menu_layer_add_to_window(menu_layer, window);
+
+    window_stack_push(window, true);
+}
+
+void perflist_destroy(void) {
+    if (window == NULL) {
+        return;
+    }
+    layer_remove_from_parent(menu_layer_get_layer(menu_layer));
+    menu_layer_destroy_safe(menu_layer);
+    window_destroy_safe(window);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+
+static const char *request_type_to_string(uint8_t request_type) {
+    switch (request_type) {
+        case RequestTypeBooks:
+            return "Books";
+        case RequestTypeVerses:
+            return "Verses";
+        case RequestTypeViewer:
+            return "Viewer";
+        case RequestTypeFavorites:
+            return "Favorites";
+        case RequestTypeToggleFavorite:
+            return "Toggle";
+        case RequestTypeConfigure:
+            return "Configure";
+        case RequestTypeNextPassage:
+            return "Next";
+        case RequestTypeSearch:
+            return "Search";
+        default:
+            return "?";
+    }
+}
+
+static void format_event(char *buffer, size_t size, const char *label, uint16_t offset) {
+    if (offset == PERF_NOT_YET) {
+        snprintf(buffer, size, "%s-", label);
+    } else {
+        snprintf(buffer, size, "%s%d", label, offset);
+    }
+}
+
+static uint16_t menu_get_num_sections_callback(struct MenuLayer *menu_layer, void *callback_context) {
+    return 3;
+}
+
+static uint16_t menu_get_num_rows_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context) {
+    switch (section_index) {
+        case 0:
+            return 1;
+        case 1:
+            return perf_num_records();
+        default:
+            return perf_num_heap_marks();
+    }
+}
+
+static int16_t menu_get_header_height_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context) {
+    return MENU_CELL_BASIC_HEADER_HEIGHT;
+}
+
+static void menu_draw_header_callback(GContext *ctx, const Layer *cell_layer, uint16_t section_index, void *callback_context) {
+    const char *headers[] = { "Instrumentation", "Requests (ms)", "Heap high water" };
+#if PBL_ROUND
+    graphics_draw_text(ctx,
+        headers[section_index],
+        fonts_get_system_font(FONT_KEY_GOTHIC_14_BOLD),
+        (GRect) { .origin = { 0, 0 }, .size = { PEBBLE_WIDTH, 16 } },
+        GTextOverflowModeTrailingEllipsis,
+        GTextAlignmentCenter,
+        NULL);
+#else
+    menu_cell_basic_header_draw(ctx, cell_layer, headers[section_index]);
+#endif
+}
+
+/*
+ * A request reads as its type and token, then the send, first chunk, last
+ * chunk and first paint times, retries, chunks and late packets
+ */
+static void menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *callback_context) {
+    static char title[32];
+    static char subtitle[48];
+
+    if (cell_index->section == 0) {
+        snprintf(title, sizeof(title), "Export %d", perf_num_records());
+        snprintf(subtitle, sizeof(subtitle), "JS %dms, %d dropped", (int)perf_js_ready_time(), perf_inbox_drops());
+    } else if (cell_index->section == 1) {
+        const PerfRecord *record = perf_get_record(cell_index->row);
+        char events[PerfEventCount][8];
+        const char *labels[PerfEventCount] = { "s", "f", "l", "p" };
+        for (int i = 0; i < PerfEventCount; i++) {
+            format_event(events[i], sizeof(events[i]), labels[i], record->events[i]);
+        }
+        snprintf(title, sizeof(title), "%s #%d", request_type_to_string(record->request_type), (int)record->token);
+        snprintf(subtitle, sizeof(subtitle), "%s %s %s %s r%d c%d x%d",
+            events[PerfEventSend], events[PerfEventFirstChunk], events[PerfEventLastChunk], events[PerfEventFirstPaint],
+            record->retries, record->chunks, record->late);
+    } else {
+        const PerfHeapMark *mark = perf_get_heap_mark(cell_index->row);
+        strncpy(title, mark->name, sizeof(title) - 1);
+        snprintf(subtitle, sizeof(subtitle), "%d bytes", (int)mark->high_water);
+    }
+    menu_cell_basic_draw(ctx, cell_layer, title, subtitle, NULL);
+}
+
+static void menu_select_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
+    if (cell_index->section == 0) {
+        perf_export();
+        vibes_short_pulse();
+    }
+}
+
+static void window_appear(Window *window) {
+    menu_layer_reload_data(menu_layer);
+}
+
+#endif
@@ -0,0 +1,6 @@
+#include "../common.h"
+
+#pragma once
+
+void perflist_init(void);
+void perflist_destroy(void);
@@ -0,0 +1,307 @@
+#include <pebble.h>
+#include "searchlist.h"
+#include "viewer.h"
+#include "../libs/pebble-assist.h"
+#include "../common.h"
+#include "../bible.h"
+#include "../appmessage.h"
+#include "../perf.h"
+#include "../redraw.h"
+
+// Matches options.search on the phone
+#define MAX_RESULTS 16
+#define MAX_SNIPPET_SIZE 48
+
+typedef enum {
+    SearchStateIdle,
+    SearchStateSearching,
+    SearchStateDone,
+} SearchState;
+
+typedef struct {
+    char book_name[24];
+    uint8_t chapter;
+    uint8_t verse;
+    char snippet[MAX_SNIPPET_SIZE];
+} SearchResult;
+
+static SearchResult results[MAX_RESULTS];
+static int num_results;
+static char query[SEARCH_QUERY_SIZE];
+static SearchState state;
+static int request_token;
+
+static void start_dictation(void);
+#if PBL_MICROPHONE
+static void start_search(char *text);
+#endif
+static void open_passage(char *book_name, int chapter, char *range);
+static uint16_t menu_get_num_sections_callback(struct MenuLayer *menu_layer, void *callback_context);
+static uint16_t menu_get_num_rows_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context);
+static int16_t menu_get_header_height_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context);
+static int16_t menu_get_cell_height_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
+static void menu_draw_header_callback(GContext *ctx, const Layer *cell_layer, uint16_t section_index, void *callback_context);
+static void menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *callback_context);
+static void menu_select_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
+static void menu_select_long_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
+static void window_unload(Window *window);
+
+static Window *window;
+static MenuLayer *menu_layer;
+#if PBL_MICROPHONE
+static DictationSession *dictation_session;
+#endif
+
+void searchlist_init(void) {
+    // the window of the last search is kept until now
+    searchlist_destroy();
+    window = window_create();
+    PERF_WINDOW(window, "search");
+
+    window_set_window_handlers(window, (WindowHandlers) {
+        .unload = window_unload,
+    });
+
+    menu_layer = menu_layer_create_fullscreen(window);
+    menu_layer_set_callbacks(menu_layer, NULL, (MenuLayerCallbacks) {
+        .get_num_sections = menu_get_num_sections_callback,
+        .get_num_rows = menu_get_num_rows_callback,
+        .get_header_height = menu_get_header_height_callback,
+        .get_cell_height = menu_get_cell_height_callback,
+        .draw_header = menu_draw_header_callback,
+        .draw_row = menu_draw_row_callback,
+        .select_click = menu_select_callback,
+        .select_long_click = menu_select_long_callback,
+    });
+    menu_layer_set_click_config_onto_window(menu_layer, window);
+    menu_layer_add_to_window(menu_layer, window);
+
+    num_results = 0;
+    query[0] = '\0';
+    state = SearchStateIdle;
+
+    window_stack_push(window, true);
+
+    start_dictation();
+}
+
+/*
+ * The viewer opened from here is the one verseslist_destroy() tears down
+ */
+void searchlist_destroy(void) {
+    if (window == NULL) {
+        return;
+    }
+    layer_remove_from_parent(menu_layer_get_layer(menu_layer));
+    menu_layer_destroy_safe(menu_layer);
+    window_destroy_safe(window);
+    menu_layer = NULL;
+    window = NULL;
+}
+
+/*
+ * A passage reference comes back as book, chapter and range and is opened
+ * straight away, anything else as rows of book, chapter, verse and snippet
+ */
+void searchlist_in_received_handler(DictionaryIterator *iter) {
+    Tuple *token_tuple = dict_find(iter, KEY_TOKEN);
+    Tuple *book_tuple = dict_find(iter, KEY_BOOK);
+    Tuple *chapter_tuple = dict_find(iter, KEY_CHAPTER);
+    Tuple *range_tuple = dict_find(iter, KEY_RANGE);
+    Tuple *index_tuple = dict_find(iter, KEY_INDEX);
+    Tuple *content_tuple = dict_find(iter, KEY_CONTENT);
+
+    if (!token_tuple || token_tuple->value->int32 != request_token) {
+        return;
+    }
+
+    state = SearchStateDone;
+    if (book_tuple && chapter_tuple && range_tuple) {
+        appmessage_finish_request(request_token);
+        request_token = 0;
+        redraw_menu(menu_layer);
+        open_passage(book_tuple->value->cstring, chapter_tuple->value->int32, range_tuple->value->cstring);
+        return;
+    }
+
+    if (index_tuple && content_tuple) {
+        int index = index_tuple->value->int16;
+        char *cursor = content_tuple->value->cstring;
+        char *fields[4];
+        while (index < MAX_RESULTS && appmessage_read_row(&cursor, fields, 4) == 4) {
+            SearchResult *result = &results[index++];
+            strncpy(result->book_name, fields[0], sizeof(result->book_name) - 1);
+            result->chapter = atoi(fields[1]);
+            result->verse = atoi(fields[2]);
+            strncpy(result->snippet, fields[3], sizeof(result->snippet) - 1);
+            num_results = index > num_results ? index : num_results;
+        }
+    }
+    redraw_menu(menu_layer);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+
+#if PBL_MICROPHONE
+static void start_search(char *text) {
+    appmessage_cancel_request(request_token);
+    memset(results, 0x0, sizeof(results));
+    num_results = 0;
+    strncpy(query, text, sizeof(query) - 1);
+    state = SearchStateSearching;
+    menu_layer_set_selected_index(menu_layer, (MenuIndex) { .row = 0, .section = 0 }, MenuRowAlignBottom, false);
+    redraw_menu(menu_layer);
+    request_token = appmessage_search_request(query);
+    if (request_token == 0) {
+        // could not be sent, show it as a search without results
+        state = SearchStateDone;
+        redraw_menu(menu_layer);
+    }
+}
+
+static void dictation_session_callback(DictationSession *session, DictationSessionStatus status, char *transcription, void *context) {
+    if (status == DictationSessionStatusSuccess) {
+        start_search(transcription);
+    } else {
+        APP_LOG(APP_LOG_LEVEL_DEBUG, "Dictation failed, %d", (int)status);
+    }
+}
+#endif
+
+static void start_dictation(void) {
+#if PBL_MICROPHONE
+    if (dictation_session == NULL) {
+        dictation_session = dictation_session_create(SEARCH_QUERY_SIZE, dictation_session_callback, NULL);
+    }
+    if (dictation_session != NULL) {
+        dictation_session_start(dictation_session);
+    }
+#endif
+}
+
+static void open_passage(char *book_name, int chapter, char *range) {
+    Book book;
+    memset(&book, 0x0, sizeof(book));
+    int book_index = bible_find_book(book_name);
+    if (book_index >= 0) {
+        bible_book_at_index(book_index, &book);
+    } else {
+        strncpy(book.name, book_name, sizeof(book.name) - 1);
+    }
+    viewer_init(&book, chapter, range);
+}
+
+static uint16_t menu_get_num_sections_callback(struct MenuLayer *menu_layer, void *callback_context) {
+    return 1;
+}
+
+static uint16_t menu_get_num_rows_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context) {
+    return (num_results) ? num_results : 1;
+}
+
+static int16_t menu_get_header_height_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context) {
+    return MENU_CELL_BASIC_HEADER_HEIGHT;
+}
+
+static int16_t menu_get_cell_height_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
+    if (num_results == 0 && state != SearchStateSearching) return 86;
+    return num_results ? 48 : 34;
+}
+
+static void menu_draw_header_callback(GContext *ctx, const Layer *cell_layer, uint16_t section_index, void *callback_context) {
+	const char *header = query[0] != '\0' ? query : "Search";
+#if PBL_ROUND
+	graphics_draw_text(ctx, 
+		header, 
+		fonts_get_system_font(FONT_KEY_GOTHIC_14_BOLD), 
+		(GRect) { .origin = { 0, 0 }, .size = { PEBBLE_WIDTH, 16 } }, 
+		GTextOverflowModeTrailingEllipsis, 
+		PBL_IF_ROUND_ELSE(GTextAlignmentCenter, GTextAlignmentLeft), 
+		NULL);
+#else
+	menu_cell_basic_header_draw(ctx, cell_layer, header);
+#endif
+}
+
+static void menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *callback_context) {
+    PERF_REQUEST_PAINTED(request_token);
+    redraw_count_row(menu_layer);
+    if (menu_cell_layer_is_highlighted(cell_layer)) {
+        graphics_context_set_text_color(ctx, GColorWhite);
+    } else {
+        graphics_context_set_text_color(ctx, GColorBlack);
+    }
+
+    int margin = PBL_IF_ROUND_ELSE(0, 8);
+    GTextAlignment alignment = PBL_IF_ROUND_ELSE(GTextAlignmentCenter, GTextAlignmentLeft);
+    if (num_results == 0) {
+        const char *row_text = "Searching...";
+        const char *font = FONT_KEY_GOTHIC_24;
+        int height = 28;
+        if (state == SearchStateIdle) {
+            row_text = "Press the “Select” button and say a passage or some words to find";
+        } else if (state == SearchStateDone) {
+            row_text = "No verses found, only chapters read before or stored offline are searched";
+        }
+        if (state != SearchStateSearching) {
+            font = FONT_KEY_GOTHIC_18;
+            height = 80;
+            margin = 8;
+        }
+        graphics_draw_text(ctx, 
+            row_text, 
+            fonts_get_system_font(font), 
+            (GRect) { .origin = { margin, 0 }, .size = { PEBBLE_WIDTH - (margin * PBL_IF_ROUND_ELSE(2, 1)), height } }, 
+            GTextOverflowModeTrailingEllipsis, 
+            alignment, 
+            NULL);
+        return;
+    }
+
+    SearchResult *result = &results[cell_index->row];
+    static char title[40];
+    snprintf(title, sizeof(title), "%s %d:%d", result->book_name, result->chapter, result->verse);
+    graphics_draw_text(ctx, 
+        title, 
+        fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD), 
+        (GRect) { .origin = { margin, 0 }, .size = { PEBBLE_WIDTH - margin, 22 } }, 
+        GTextOverflowModeTrailingEllipsis, 
+        alignment, 
+        NULL);
+    graphics_draw_text(ctx, 
+        result->snippet, 
+        fonts_get_system_font(FONT_KEY_GOTHIC_18), 
+        (GRect) { .origin = { margin, 20 }, .size = { PEBBLE_WIDTH - margin, 22 } }, 
+        GTextOverflowModeTrailingEllipsis, 
+        alignment, 
+        NULL);
+}
+
+static void menu_select_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
+    if (num_results == 0) {
+        if (state != SearchStateSearching) {
+            start_dictation();
+        }
+        return;
+    }
+    SearchResult *result = &results[cell_index->row];
+    char range[8];
+    snprintf(range, sizeof(range), "%d-%d", result->verse, result->verse);
+    open_passage(result->book_name, result->chapter, range);
+}
+
+static void menu_select_long_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
+    start_dictation();
+}
+
+static void window_unload(Window *window) {
+    appmessage_cancel_request(request_token);
+    request_token = 0;
+    redraw_forget(menu_layer);
+#if PBL_MICROPHONE
+    if (dictation_session != NULL) {
+        dictation_session_destroy(dictation_session);
+        dictation_session = NULL;
+    }
+#endif
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "../common.h"
+
+// Longest query sent to the phone, including the terminator
+#define SEARCH_QUERY_SIZE 40
+
+void searchlist_init(void);
+void searchlist_destroy(void);
+void searchlist_in_received_handler(DictionaryIterator *iter);
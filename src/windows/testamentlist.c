@@ -4,7 +4,11 @@
 #include "../common.h"
 #include "windows/booklist.h"
 #include "windows/favoriteslist.h"
+#include "windows/searchlist.h"
 #include "windows/coachmark.h"
+#include "windows/perflist.h"
+#include "../perf.h"
+#include "../startup.h"
 
 const char* testament_to_string(TestamentType testament);
 static uint16_t menu_get_num_sections_callback(struct MenuLayer *menu_layer, void *callback_context);
@@ -14,12 +18,16 @@ static int16_t menu_get_cell_height_callback(struct MenuLayer *menu_layer, MenuI
 static void menu_draw_header_callback(GContext *ctx, const Layer *cell_layer, uint16_t section_index, void *callback_context);
 static void menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *callback_context);
 static void menu_select_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
+#if PERF_ENABLED
+static void menu_select_long_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context);
+#endif
 
 static Window *window;
 static MenuLayer *menu_layer;
 
 void testamentlist_init(void) {
     window = window_create();
+    PERF_WINDOW(window, "testaments");
     
     menu_layer = menu_layer_create_fullscreen(window);
     menu_layer_set_callbacks(menu_layer, NULL, (MenuLayerCallbacks) {
@@ -30,6 +38,9 @@ void testamentlist_init(void) {
         .draw_header = menu_draw_header_callback,
         .draw_row = menu_draw_row_callback,
         .select_click = menu_select_callback,
+#if PERF_ENABLED
+        .select_long_click = menu_select_long_callback,
+#endif
     });
     menu_layer_set_click_config_onto_window(menu_layer, window);
     menu_layer_add_to_window(menu_layer, window);
@@ -41,6 +52,10 @@ void testamentlist_init(void) {
 
 void testamentlist_destroy(void) {
     booklist_destroy();
+    searchlist_destroy();
+#if PERF_ENABLED
+    perflist_destroy();
+#endif
     layer_remove_from_parent(menu_layer_get_layer(menu_layer));
     menu_layer_destroy_safe(menu_layer);
     window_destroy_safe(window);
@@ -65,7 +80,8 @@ static uint16_t menu_get_num_sections_callback(struct MenuLayer *menu_layer, voi
 
 static uint16_t menu_get_num_rows_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context) {
     if (section_index == 0) return 2;
-    return 1;
+    // searching starts with dictation, so only where there is a microphone
+    return PBL_IF_MICROPHONE_ELSE(2, 1);
 }
 
 static int16_t menu_get_header_height_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context) {
@@ -95,9 +111,12 @@ static void menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuI
     const char *title;
     if (cell_index->section == 0) {
         title = testament_to_string((TestamentType)cell_index->row);
-    } else {
+    } else if (cell_index->row == 0) {
         title = "Favorites";
+    } else {
+        title = "Search";
     }
+    startup_interactive("testament list");
     if (menu_cell_layer_is_highlighted(cell_layer)) {
         graphics_context_set_text_color(ctx, GColorWhite);
     } else {
@@ -115,7 +134,15 @@ static void menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuI
 static void menu_select_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
     if (cell_index->section == 0) {
         booklist_init((TestamentType)cell_index->row);
-    } else {
+    } else if (cell_index->row == 0) {
         favoriteslist_init();
+    } else {
+        searchlist_init();
     }
 }
+
+#if PERF_ENABLED
+static void menu_select_long_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
+    perflist_init();
+}
+#endif
@@ -5,11 +5,16 @@
 #include "../common.h"
 #include "windows/chapterlist.h"
 #include "../appmessage.h"
+#include "../perf.h"
+#include "../redraw.h"
 
-#define MAX_RANGES 6
 #define MAX_RANGE_SIZE 8
+#define CONTINUOUS_TITLE "Read on"
+#define CONTINUOUS_RANGE "1-"
 
-static char ranges[MAX_RANGES][MAX_RANGE_SIZE];
+// As many ranges as the chapter is cut into, grown as rows come in
+static char (*ranges)[MAX_RANGE_SIZE];
+static int ranges_capacity;
 
 static Book *current_book;
 static int current_chapter;
@@ -17,6 +22,8 @@ static int num_ranges;
 static int request_token;
 
 static void refresh_list();
+static void free_ranges(void);
+static bool reserve_ranges(int count);
 static uint16_t menu_get_num_sections_callback(struct MenuLayer *menu_layer, void *callback_context);
 static uint16_t menu_get_num_rows_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context);
 static int16_t menu_get_header_height_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context);
@@ -33,6 +40,7 @@ static MenuLayer *menu_layer;
 
 void verseslist_init(Book *book, int chapter) {
 	window = window_create();
+	PERF_WINDOW(window, "verses");
     current_book = book;
     current_chapter = chapter;
 
@@ -73,22 +81,59 @@ void verseslist_in_received_handler(DictionaryIterator *iter) {
 	if (content_tuple && index_tuple && token_tuple) {
         if (token_tuple->value->int32 != request_token) return;
 
-		strncpy(ranges[index_tuple->value->int16], content_tuple->value->cstring, MAX_RANGE_SIZE - 1);
-		num_ranges++;
-		menu_layer_reload_data(menu_layer);
-		APP_LOG(APP_LOG_LEVEL_DEBUG, "Received verse range %s", ranges[index_tuple->value->int16]);
+        int index = index_tuple->value->int16;
+        char *cursor = content_tuple->value->cstring;
+        char *fields[1];
+        while (appmessage_read_row(&cursor, fields, 1) == 1 && reserve_ranges(index + 1)) {
+            strncpy(ranges[index], fields[0], MAX_RANGE_SIZE - 1);
+            ranges[index][MAX_RANGE_SIZE - 1] = '\0';
+            APP_LOG(APP_LOG_LEVEL_DEBUG, "Received verse range %s", ranges[index]);
+            index++;
+            if (index > num_ranges) {
+                num_ranges = index;
+            }
+        }
+		redraw_menu(menu_layer);
 	}
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
 
 static void refresh_list() {
-	memset(ranges, 0x0, sizeof(ranges));
-	num_ranges = 0;
+	free_ranges();
 	menu_layer_set_selected_index(menu_layer, (MenuIndex) { .row = 0, .section = 0 }, MenuRowAlignBottom, false);
-	menu_layer_reload_data(menu_layer);
 	request_token = appmessage_verseslist_request_data(current_book->name, current_chapter);
-	menu_layer_reload_data(menu_layer);
+	redraw_menu(menu_layer);
+}
+
+static void free_ranges(void) {
+    free(ranges);
+    ranges = NULL;
+    ranges_capacity = 0;
+    num_ranges = 0;
+}
+
+/*
+ * Make room for count ranges, doubling the array. Returns false if there
+ * is no memory for them, the list then ends with the ranges it has.
+ */
+static bool reserve_ranges(int count) {
+    if (count <= ranges_capacity) {
+        return true;
+    }
+    int capacity = ranges_capacity > 0 ? ranges_capacity : 8;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+    char (*grown)[MAX_RANGE_SIZE] = realloc(ranges, capacity * MAX_RANGE_SIZE);
+    if (grown == NULL) {
+        APP_LOG(APP_LOG_LEVEL_ERROR, "No memory for %d verse ranges", count);
+        return false;
+    }
+    memset(grown[ranges_capacity], 0x0, (capacity - ranges_capacity) * MAX_RANGE_SIZE);
+    ranges = grown;
+    ranges_capacity = capacity;
+    return true;
 }
 
 static uint16_t menu_get_num_sections_callback(struct MenuLayer *menu_layer, void *callback_context) {
@@ -96,7 +141,8 @@ static uint16_t menu_get_num_sections_callback(struct MenuLayer *menu_layer, voi
 }
 
 static uint16_t menu_get_num_rows_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context) {
-	return (num_ranges) ? num_ranges : 1;
+	// the first row reads the whole chapter and on into the next ones
+	return (num_ranges) ? num_ranges + 1 : 1;
 }
 
 static int16_t menu_get_header_height_callback(struct MenuLayer *menu_layer, uint16_t section_index, void *callback_context) {
@@ -123,16 +169,18 @@ static void menu_draw_header_callback(GContext *ctx, const Layer *cell_layer, ui
 }
 
 static void menu_draw_row_callback(GContext *ctx, const Layer *cell_layer, MenuIndex *cell_index, void *callback_context) {
+	redraw_count_row(menu_layer);
 	if (num_ranges == 0) {
 		menu_cell_basic_draw(ctx, cell_layer, "Loading...", NULL, NULL);
 	} else {
+	    PERF_REQUEST_PAINTED(request_token);
 	    if (menu_cell_layer_is_highlighted(cell_layer)) {
             graphics_context_set_text_color(ctx, GColorWhite);
         } else {
             graphics_context_set_text_color(ctx, GColorBlack);
 	    }
 		graphics_draw_text(ctx, 
-			ranges[cell_index->row], 
+			cell_index->row == 0 ? CONTINUOUS_TITLE : ranges[cell_index->row - 1], 
 			fonts_get_system_font(FONT_KEY_GOTHIC_24), 
 			(GRect) { .origin = { PBL_IF_ROUND_ELSE(0, 8), 0 }, .size = { PEBBLE_WIDTH - PBL_IF_ROUND_ELSE(0, 8), 28 } }, 
 			GTextOverflowModeTrailingEllipsis, 
@@ -145,7 +193,7 @@ static void menu_select_callback(struct MenuLayer *menu_layer, MenuIndex *cell_i
 	if (num_ranges == 0) {
 		return;
 	}
-    viewer_init(current_book, current_chapter, ranges[cell_index->row]);
+    viewer_init(current_book, current_chapter, cell_index->row == 0 ? CONTINUOUS_RANGE : ranges[cell_index->row - 1]);
 }
 
 static void menu_select_long_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index, void *callback_context) {
@@ -158,4 +206,6 @@ static void window_load(Window *window) {
 
 static void window_unload(Window *window) {
     appmessage_cancel_request(request_token);
+    redraw_forget(menu_layer);
+    free_ranges();
 }
@@ -1,33 +1,105 @@
 #include <pebble.h>
 #include "booklist.h"
+#include "testamentlist.h"
 #include "../libs/pebble-assist.h"
 #include "../common.h"
 #include "../appmessage.h"
+#include "../request.h"
+#include "../textbuffer.h"
+#include "../textlayout.h"
+#include "../cache.h"
+#include "../bible.h"
+#include "../perf.h"
+#include "../session.h"
+#include "../startup.h"
 
 #define LOADING_TEXT        "Loading..."
-#define PADDING             5
+#define PADDING             PBL_IF_ROUND_ELSE(18, 5)
 #define SCROLL_UP_JUMP      110
 #define SCROLL_DOWN_JUMP    -(SCROLL_UP_JUMP)
 
+// The passage is fetched in windows of STREAM_WINDOW_BYTES. Blocks further
+// than KEEP_DISTANCE px from the screen lose their text, blocks within
+// REFILL_DISTANCE px get it back, and the next window is requested once less
+// than PREFETCH_DISTANCE px of text is left below the screen.
+#if defined(PBL_PLATFORM_APLITE)
+#define STREAM_WINDOW_BYTES 1024
+#else
+#define STREAM_WINDOW_BYTES 2048
+#endif
+#define KEEP_DISTANCE       (3 * PEBBLE_HEIGHT)
+#define REFILL_DISTANCE     PEBBLE_HEIGHT
+#define PREFETCH_DISTANCE   (2 * PEBBLE_HEIGHT)
+
+// A fetch that could not be requested is tried again after this long
+#define FETCH_RETRY_MS      1000
+// How often a fetch in flight is checked for having timed out, see
+// REQUEST_TIMEOUT_MS
+#define FETCH_CHECK_MS      5000
+
+typedef enum {
+    FetchNone,
+    FetchForward,
+    FetchRefill,
+} FetchKind;
+
 static Book current_book;
 static int current_chapter;
 static char *current_range;
-static int current_index;
 static int request_token;
-static char *current_text;
+static int next_token;
+static TextBuffer text_buffer;
+static TextLayout text_layout;
 
-static void set_current_text(char *text);
+static FetchKind fetch_kind;
+static int32_t fetch_length;
+static bool fetch_end;
+static size_t fetch_start;
+static int fetch_first_block;
+static int fetch_last_block;
+static TextBuffer refill_buffer;
+static AppTimer *retry_timer;
+static AppTimer *check_timer;
+static LzDecoder *decoder;
+static bool stream_end;
+
+// Set when reopened at launch: how far down to scroll once the text is in,
+// from the start of the passage, and whether the lists under the viewer are
+// still to be built
+static int32_t resume_offset;
+static bool resumed;
+
+static void start_passage(void);
+static void stop_passage(void);
+static void update_layout(void);
+static void resume_scroll(void);
+static int32_t screen_top(void);
+static void rebase_layout(void);
+static void cache_load_callback(const char *text, size_t length, void *context);
+static void fetch_forward(void);
+static void fetch_refill(int first, int last);
+static void fetch_finished(void);
+static void fetch_abandon(void);
+static void fetch_check(void);
+static void retry_timer_callback(void *data);
+static void check_timer_callback(void *data);
+static void stream_maintain(void);
+static void scroll_offset_changed_handler(ScrollLayer *scroll_layer, void *context);
+static void text_layer_update_proc(Layer *layer, GContext *ctx);
 static void click_config_provider(Window *window);
 static void select_multi_click_handler(ClickRecognizerRef recognizer, void *context);
+static void select_long_click_handler(ClickRecognizerRef recognizer, void *context);
+static void back_click_handler(ClickRecognizerRef recognizer, void *context);
 static void window_load(Window *window);
 static void window_unload(Window *window);
 
 static Window *window;
 static ScrollLayer *scroll_layer;
-static TextLayer *text_layer;
+static Layer *text_layer;
 
 void viewer_init(Book *book, int chapter, char *range) {
 	window = window_create();
+	PERF_WINDOW(window, "viewer");
 
     current_chapter = chapter;
     strncpy(current_book.name, book->name, sizeof(book->name));
@@ -45,26 +117,45 @@ void viewer_init(Book *book, int chapter, char *range) {
 
 	scroll_layer_set_click_config_onto_window(scroll_layer, window);
     scroll_layer_set_callbacks(scroll_layer, (ScrollLayerCallbacks) {
-        .click_config_provider = (ClickConfigProvider) click_config_provider
+        .click_config_provider = (ClickConfigProvider) click_config_provider,
+        .content_offset_changed_handler = scroll_offset_changed_handler,
     });
     
-    text_layer = text_layer_create(GRect(PADDING, PADDING, bounds.size.w - PADDING*2, bounds.size.h - PADDING*2));
-    text_layer_set_font(text_layer, fonts_get_system_font(FONT_KEY_GOTHIC_18));
+    text_layer = layer_create(GRect(PADDING, PADDING, bounds.size.w - PADDING*2, bounds.size.h - PADDING*2));
+    layer_set_update_proc(text_layer, text_layer_update_proc);
 
-    scroll_layer_add_child(scroll_layer, text_layer_get_layer(text_layer));
+    scroll_layer_add_child(scroll_layer, text_layer);
 
 	layer_add_child(window_layer, scroll_layer_get_layer(scroll_layer));
 
 #if PBL_ROUND    
-    text_layer_enable_screen_text_flow_and_paging(text_layer, 5);
+    scroll_layer_set_paging(scroll_layer, true);
 #endif
 
 	window_stack_push(window, true);
 }
 
+/*
+ * Reopen the passage read last where it was left, with nothing under it.
+ * Returns false if there is none.
+ */
+bool viewer_resume(void) {
+    Session session;
+    if (!session_restore(&session)) {
+        return false;
+    }
+    Book book;
+    bible_book_at_index(session.book, &book);
+    resumed = true;
+    resume_offset = session.scroll_offset;
+    viewer_init(&book, session.chapter, session.range);
+    return true;
+}
+
 void viewer_destroy(void) {
 	layer_remove_from_parent(scroll_layer_get_layer(scroll_layer));
 	scroll_layer_destroy(scroll_layer);
+	layer_destroy_safe(text_layer);
     
 	window_destroy_safe(window);
 }
@@ -74,45 +165,290 @@ void viewer_in_received_handler(DictionaryIterator *iter) {
 	Tuple *content_tuple = dict_find(iter, KEY_CONTENT);
     Tuple *index_tuple = dict_find(iter, KEY_INDEX);
     Tuple *token_tuple = dict_find(iter, KEY_TOKEN);
+    Tuple *length_tuple = dict_find(iter, KEY_LENGTH);
+    Tuple *end_tuple = dict_find(iter, KEY_END);
 
 	if (content_tuple && index_tuple && token_tuple) {
-        if (token_tuple->value->int32 != request_token) return;
-        if (index_tuple->value->int16 <= current_index) return;
-        current_index = index_tuple->value->int16;
-
-        char *additional_text = content_tuple->value->cstring;
-        char *new_text;
-        if (strcmp(current_text, LOADING_TEXT) == 0)
-        {
-            new_text = malloc(strlen(additional_text) + 1);
-            strcpy(new_text, additional_text);
-            current_text = NULL;
+        if (token_tuple->value->int32 != request_token || fetch_kind == FetchNone) return;
+
+        // the first chunk of a window says how many bytes the window holds
+        if (length_tuple) {
+            fetch_length = length_tuple->value->int32;
+            fetch_end = end_tuple && end_tuple->value->int32;
         }
-        else
-        {
-            new_text = malloc((strlen(current_text) + strlen(additional_text) + 1));
-            strcpy(new_text, current_text);
-            strcat(new_text, additional_text);
+
+        // compressed windows come as byte arrays, plain ones as strings
+        TextBuffer *buffer = fetch_kind == FetchForward ? &text_buffer : &refill_buffer;
+        bool compressed = content_tuple->type == TUPLE_BYTE_ARRAY;
+        const char *chunk = compressed ? (const char *)content_tuple->value->data : content_tuple->value->cstring;
+        size_t chunk_length = compressed ? content_tuple->length : strlen(chunk);
+        if (compressed && buffer->decoder == NULL) {
+            if (decoder == NULL) return;
+            text_buffer_set_decoder(buffer, decoder);
         }
-        if (NULL != current_text && strcmp(current_text, LOADING_TEXT) != 0) {
-            free(current_text);
-            current_text = NULL;
+
+        size_t received;
+        if (fetch_kind == FetchForward) {
+            size_t length = text_buffer.length;
+            if (text_buffer_add_chunk(&text_buffer, index_tuple->value->int16, chunk, chunk_length)) {
+                cache_store_append(text_buffer.text + length, text_buffer.length - length);
+                update_layout();
+            }
+            received = text_buffer.appended - fetch_start;
+        } else {
+            text_buffer_add_chunk(&refill_buffer, index_tuple->value->int16, chunk, chunk_length);
+            received = refill_buffer.appended;
+        }
+
+        if (fetch_length >= 0 && received >= (size_t)fetch_length) {
+            fetch_finished();
         }
-        set_current_text(new_text);
 		APP_LOG(APP_LOG_LEVEL_DEBUG, "received content for chapter [%d] %s", current_chapter, current_book.name);
 	}
 }
 
-static void set_current_text(char *text) {
-    Layer *window_layer = window_get_root_layer(window);
-    GRect bounds = layer_get_frame(window_layer);
-    text_layer_set_size(text_layer, GSize(bounds.size.w - PADDING*2, 9999));
-    
-    current_text = text;
-    text_layer_set_text(text_layer, current_text);
-    GSize max_size = text_layer_get_content_size(text_layer);
-    text_layer_set_size(text_layer, max_size);
-    scroll_layer_set_content_size(scroll_layer, GSize(bounds.size.w, max_size.h + PADDING*2));
+/*
+ * The phone resolved the passage after the current one, show it in place
+ */
+void viewer_next_passage_received_handler(DictionaryIterator *iter) {
+    Tuple *token_tuple = dict_find(iter, KEY_TOKEN);
+    Tuple *book_tuple = dict_find(iter, KEY_BOOK);
+    Tuple *chapter_tuple = dict_find(iter, KEY_CHAPTER);
+    Tuple *range_tuple = dict_find(iter, KEY_RANGE);
+
+    if (!token_tuple || next_token == 0 || token_tuple->value->int32 != next_token) return;
+    appmessage_finish_request(next_token);
+    next_token = 0;
+
+    if (!book_tuple || !chapter_tuple || !range_tuple) {
+        // nothing follows the last passage
+        vibes_short_pulse();
+        return;
+    }
+
+    stop_passage();
+
+    int book_index = bible_find_book(book_tuple->value->cstring);
+    if (book_index >= 0) {
+        bible_book_at_index(book_index, &current_book);
+    } else {
+        strncpy(current_book.name, book_tuple->value->cstring, sizeof(current_book.name) - 1);
+    }
+    current_chapter = chapter_tuple->value->int32;
+    free(current_range);
+    current_range = malloc(strlen(range_tuple->value->cstring) + 1);
+    strcpy(current_range, range_tuple->value->cstring);
+    resume_offset = 0;
+
+    GRect bounds = layer_get_frame(window_get_root_layer(window));
+    layer_set_frame(text_layer, GRect(PADDING, PADDING, bounds.size.w - PADDING*2, bounds.size.h - PADDING*2));
+    scroll_layer_set_content_size(scroll_layer, bounds.size);
+    scroll_layer_set_content_offset(scroll_layer, GPointZero, false);
+    layer_mark_dirty(text_layer);
+
+    start_passage();
+}
+
+/*
+ * Only the blocks completed by the last chunk and the unfinished tail get
+ * measured, the content height is the sum of the cached block heights
+ */
+static void update_layout(void) {
+    text_layout_update(&text_layout, &text_buffer);
+
+    GRect frame = layer_get_frame(text_layer);
+    frame.size.h = text_layout_get_height(&text_layout);
+    layer_set_frame(text_layer, frame);
+    scroll_layer_set_content_size(scroll_layer, GSize(layer_get_frame(window_get_root_layer(window)).size.w, frame.size.h + PADDING*2));
+    layer_mark_dirty(text_layer);
+    resume_scroll();
+}
+
+/*
+ * Scroll to where reading stopped last time, once the text reaches that far
+ */
+static void resume_scroll(void) {
+    int32_t offset = resume_offset - text_layout.origin;
+    int16_t height = layer_get_frame(window_get_root_layer(window)).size.h;
+    if (resume_offset == 0 || (!stream_end && text_layout_get_height(&text_layout) < offset + height)) {
+        return;
+    }
+    resume_offset = 0;
+    scroll_layer_set_content_offset(scroll_layer, GPoint(0, -offset), false);
+}
+
+/*
+ * Top of the screen in layout coordinates, or of where it is going to be
+ * while a resumed position is still loading
+ */
+static int32_t screen_top(void) {
+    if (resume_offset > 0) {
+        return resume_offset - text_layout.origin - PADDING;
+    }
+    return -scroll_layer_get_content_offset(scroll_layer).y - PADDING;
+}
+
+/*
+ * Drop the blocks far above the screen once a long stream outgrows the
+ * scroll layer, and move the scroll offset up by as much so the screen
+ * stays where it was
+ */
+static void rebase_layout(void) {
+    GPoint offset = scroll_layer_get_content_offset(scroll_layer);
+    int16_t dropped = text_layout_trim(&text_layout, screen_top() - KEEP_DISTANCE);
+    if (dropped == 0) {
+        return;
+    }
+    // moved before the content shrinks, which would clamp it first
+    if (resume_offset == 0) {
+        offset.y += dropped;
+        scroll_layer_set_content_offset(scroll_layer, offset, false);
+    }
+    update_layout();
+}
+
+/*
+ * Laid out in one go once cache_load() returns, the tail would otherwise be
+ * measured again for every decoded piece
+ */
+static void cache_load_callback(const char *text, size_t length, void *context) {
+    text_buffer_append(&text_buffer, text, length);
+}
+
+static void fetch_forward(void) {
+    fetch_kind = FetchForward;
+    fetch_length = -1;
+    fetch_start = text_buffer.appended;
+    text_buffer_restart(&text_buffer);
+    request_token = appmessage_viewer_request_data(current_book.name, current_chapter, current_range, text_buffer.appended, STREAM_WINDOW_BYTES);
+    if (request_token == 0) {
+        fetch_abandon();
+    } else {
+        fetch_check();
+    }
+}
+
+static void fetch_refill(int first, int last) {
+    TextBlock *first_block = &text_layout.blocks[first];
+    TextBlock *last_block = &text_layout.blocks[last];
+    fetch_kind = FetchRefill;
+    fetch_length = -1;
+    fetch_first_block = first;
+    fetch_last_block = last;
+    text_buffer_init(&refill_buffer);
+    request_token = appmessage_viewer_request_data(current_book.name, current_chapter, current_range,
+        first_block->offset, last_block->offset + last_block->span - first_block->offset);
+    if (request_token == 0) {
+        fetch_abandon();
+    } else {
+        fetch_check();
+    }
+}
+
+static void fetch_finished(void) {
+    // duplicates of what has already arrived are dropped from now on
+    appmessage_finish_request(request_token);
+    if (fetch_kind == FetchForward) {
+        stream_end = fetch_end;
+        if (stream_end) {
+            cache_store_end(true);
+        }
+    } else {
+        text_layout_fill(&text_layout, fetch_first_block, fetch_last_block, refill_buffer.text, refill_buffer.length);
+        text_buffer_deinit(&refill_buffer);
+        layer_mark_dirty(text_layer);
+    }
+    fetch_kind = FetchNone;
+    stream_maintain();
+}
+
+/*
+ * The fetch in flight will never be answered: it could not be requested, or
+ * the phone could not be reached. It is tried again in a while.
+ */
+static void fetch_abandon(void) {
+    if (fetch_kind == FetchRefill) {
+        text_buffer_deinit(&refill_buffer);
+    }
+    fetch_kind = FetchNone;
+    if (retry_timer == NULL) {
+        retry_timer = app_timer_register(FETCH_RETRY_MS, retry_timer_callback, NULL);
+    }
+}
+
+/*
+ * Keep looking at the fetch in flight until it is done, without scrolling
+ * stream_maintain() would otherwise never notice it timed out
+ */
+static void fetch_check(void) {
+    if (check_timer == NULL) {
+        check_timer = app_timer_register(FETCH_CHECK_MS, check_timer_callback, NULL);
+    }
+}
+
+static void retry_timer_callback(void *data) {
+    retry_timer = NULL;
+    stream_maintain();
+}
+
+static void check_timer_callback(void *data) {
+    check_timer = NULL;
+    if (fetch_kind != FetchNone) {
+        stream_maintain();
+    }
+    if (fetch_kind != FetchNone) {
+        fetch_check();
+    }
+}
+
+/*
+ * Keep the text around the screen in memory and nothing else: evict far
+ * blocks, refill evicted blocks that are close again, and read further
+ * ahead when the end of the loaded text comes near
+ */
+static void stream_maintain(void) {
+    resume_scroll();
+    // block indexes move, so never while a refill holds on to some
+    if (fetch_kind == FetchNone) {
+        rebase_layout();
+    }
+    int32_t top = screen_top();
+    int32_t bottom = top + layer_get_frame(window_get_root_layer(window)).size.h;
+
+    text_layout_evict(&text_layout, top - KEEP_DISTANCE, bottom + KEEP_DISTANCE);
+    if (fetch_kind != FetchNone && !request_is_live(request_token)) {
+        fetch_abandon();
+    }
+    if (fetch_kind != FetchNone || retry_timer != NULL) {
+        return;
+    }
+
+    int first, last;
+    if (text_layout_find_evicted(&text_layout, top - REFILL_DISTANCE, bottom + REFILL_DISTANCE, STREAM_WINDOW_BYTES, &first, &last)) {
+        fetch_refill(first, last);
+    } else if (!stream_end && text_layout_get_height(&text_layout) < bottom + PREFETCH_DISTANCE) {
+        fetch_forward();
+    }
+}
+
+static void scroll_offset_changed_handler(ScrollLayer *scroll_layer, void *context) {
+    stream_maintain();
+}
+
+static void text_layer_update_proc(Layer *layer, GContext *ctx) {
+    graphics_context_set_text_color(ctx, GColorBlack);
+    if (text_layout.num_blocks == 0 && text_layout.tail == NULL) {
+        graphics_draw_text(ctx, LOADING_TEXT, text_layout.font, layer_get_bounds(layer),
+            GTextOverflowModeWordWrap, text_layout.alignment, NULL);
+        return;
+    }
+
+    // draw only what the scroll layer is currently showing
+    int16_t top = -scroll_layer_get_content_offset(scroll_layer).y - PADDING;
+    int16_t bottom = top + layer_get_frame(window_get_root_layer(window)).size.h;
+    text_layout_draw(&text_layout, ctx, top, bottom);
+    PERF_REQUEST_PAINTED(request_token);
+    startup_interactive("viewer");
 }
 
 static void scroll_text_by(int16_t amount, ScrollLayer *layer) {
@@ -134,28 +470,98 @@ static void select_single_up_click_handler(ClickRecognizerRef recognizer, void *
 
 static void click_config_provider(Window *window) {
     window_multi_click_subscribe(BUTTON_ID_SELECT, 2, 0, 0, true, select_multi_click_handler);
+    window_long_click_subscribe(BUTTON_ID_SELECT, 0, select_long_click_handler, NULL);
     window_single_click_subscribe(BUTTON_ID_DOWN, select_single_down_click_handler);
     window_single_click_subscribe(BUTTON_ID_UP, select_single_up_click_handler);
+    if (resumed) {
+        window_single_click_subscribe(BUTTON_ID_BACK, back_click_handler);
+    }
 }
 
 static void select_multi_click_handler(ClickRecognizerRef recognizer, void *context) {
-    request_token = appmessage_viewer_toggle_favorite(current_book.name, current_chapter, current_range);
+    appmessage_viewer_toggle_favorite(current_book.name, current_chapter, current_range);
 }
 
-static void window_load(Window *window) {
-    current_text = LOADING_TEXT;
-    current_index = -1;
-    text_layer_set_text(text_layer, current_text);
-    request_token = appmessage_viewer_request_data(current_book.name, current_chapter, current_range);
+static void select_long_click_handler(ClickRecognizerRef recognizer, void *context) {
+    // a request the phone never got is asked again
+    if (next_token == 0 || !request_is_live(next_token)) {
+        next_token = appmessage_viewer_request_next(current_book.name, current_chapter, current_range);
+    }
 }
 
-static void window_unload(Window *window) {
+/*
+ * A resumed viewer is alone on the stack, Back first builds the lists that
+ * lead to its passage and then leaves it from under them
+ */
+static void back_click_handler(ClickRecognizerRef recognizer, void *context) {
+    int book = bible_find_book(current_book.name);
+    int chapter = current_chapter;
+    Window *resumed_window = window;
+    resumed = false;
+    testamentlist_init();
+    if (book >= 0) {
+        booklist_resume(book, chapter);
+    }
+    window_stack_remove(resumed_window, false);
+}
+
+static void start_passage(void) {
+    decoder = malloc(sizeof(LzDecoder));
+    text_buffer_init(&text_buffer);
+    text_layout_init(&text_layout, fonts_get_system_font(FONT_KEY_GOTHIC_18),
+        PBL_IF_ROUND_ELSE(GTextAlignmentCenter, GTextAlignmentLeft), layer_get_frame(text_layer).size.w);
+    fetch_kind = FetchNone;
+    stream_end = false;
+
+    // a passage read before renders straight from persist storage, only
+    // whatever the cache did not hold is streamed in from the phone
+    bool complete;
+    if (cache_load(current_book.name, current_chapter, current_range, cache_load_callback, NULL, &complete)) {
+        stream_end = complete;
+        update_layout();
+    } else {
+        cache_store_begin(current_book.name, current_chapter, current_range);
+    }
+    stream_maintain();
+}
+
+static void stop_passage(void) {
     appmessage_cancel_request(request_token);
     request_token = 0;
-    if (current_text != NULL && strcmp(current_text, LOADING_TEXT) != 0) {
-        free(current_text);
-        current_text = NULL;
+    if (fetch_kind == FetchRefill) {
+        text_buffer_deinit(&refill_buffer);
+    }
+    fetch_kind = FetchNone;
+    if (retry_timer != NULL) {
+        app_timer_cancel(retry_timer);
+        retry_timer = NULL;
+    }
+    if (check_timer != NULL) {
+        app_timer_cancel(check_timer);
+        check_timer = NULL;
+    }
+    cache_store_end(false);
+    text_layout_deinit(&text_layout);
+    text_buffer_deinit(&text_buffer);
+    free(decoder);
+    decoder = NULL;
+}
+
+static void window_load(Window *window) {
+    start_passage();
+}
+
+static void window_unload(Window *window) {
+    appmessage_cancel_request(next_token);
+    next_token = 0;
+    int book = bible_find_book(current_book.name);
+    if (book >= 0 && current_range != NULL) {
+        session_save(book, current_chapter, current_range,
+            resume_offset > 0 ? resume_offset : text_layout.origin - scroll_layer_get_content_offset(scroll_layer).y);
     }
+    resume_offset = 0;
+    resumed = false;
+    stop_passage();
     if (current_range != NULL) {
         free(current_range);
         current_range = NULL;
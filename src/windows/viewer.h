@@ -3,5 +3,7 @@
 #pragma once
 
 void viewer_init(Book *book, int chapter, char *range);
+bool viewer_resume(void);
 void viewer_destroy(void);
 void viewer_in_received_handler(DictionaryIterator *iter);
+void viewer_next_passage_received_handler(DictionaryIterator *iter);
@@ -0,0 +1,81 @@
+#!/usr/bin/env python
+#
+# Generates the book/chapter/verse tables and the LZSS preset dictionary for
+# the watch (src/generated/) and for PebbleKit JS (<out>/generated/). wscript
+# runs it on every build, the host tools run it on its own:
+#
+#     python tools/generate.py [out]
+#
+
+import json, os, sys
+
+def generate_bible_data(top, out):
+    """
+    Generates the book/chapter/verse tables for the watch (src/generated/bible_data.c)
+    and for PebbleKit JS from data/bible.json. Returns the path of the JS file.
+    """
+    books = json.load(open(os.path.join(top, 'data', 'bible.json')))
+
+    c_dir = os.path.join(top, 'src', 'generated')
+    js_dir = os.path.join(top, out, 'generated')
+    for d in [c_dir, js_dir]:
+        if not os.path.exists(d):
+            os.makedirs(d)
+
+    lines = ['// Generated by tools/generate.py from data/bible.json, do not edit', '#include <pebble.h>', '#include "../bible.h"', '']
+    lines.append('const BookInfo bible_books[BIBLE_NUM_BOOKS] = {')
+    first_chapter = 0
+    for book in books:
+        if len(book['name']) >= 24 or max(book['verses']) > 255:
+            raise ValueError('%s does not fit the watch tables' % book['name'])
+        lines.append('    { "%s", %d, %d },' % (book['name'], len(book['verses']), first_chapter))
+        first_chapter += len(book['verses'])
+    lines.append('};')
+    lines.append('')
+    lines.append('const uint8_t bible_verse_counts[%d] = {' % first_chapter)
+    for book in books:
+        lines.append('    ' + ', '.join(str(v) for v in book['verses']) + ',')
+    lines.append('};')
+    write_if_changed(os.path.join(c_dir, 'bible_data.c'), '\n'.join(lines) + '\n')
+
+    testaments = [[], []]
+    for book in books:
+        testaments[book['testament']].append({'name': book['name'], 'chapters': len(book['verses']), 'verses': book['verses']})
+    js_path = os.path.join(js_dir, 'bible-data.js')
+    write_if_changed(js_path, '// Generated by tools/generate.py from data/bible.json, do not edit\nvar bible = %s;\n' % json.dumps(testaments, separators=(',', ':')))
+    return js_path
+
+def generate_lz_dictionary(top, out):
+    """
+    Generates the preset dictionary of the LZSS codec for the watch
+    (src/generated/lz_dictionary.c) and for PebbleKit JS from
+    data/lz-dictionary.txt. Returns the path of the JS file.
+    """
+    dictionary = open(os.path.join(top, 'data', 'lz-dictionary.txt'), 'rb').read()
+    if len(dictionary) > 512:
+        raise ValueError('data/lz-dictionary.txt is larger than LZ_WINDOW_SIZE')
+
+    lines = ['// Generated by tools/generate.py from data/lz-dictionary.txt, do not edit', '#include <pebble.h>', '#include "../lz.h"', '']
+    lines.append('const uint8_t lz_dictionary[] = {')
+    for i in range(0, len(dictionary), 16):
+        lines.append('    ' + ' '.join('0x%02x,' % b for b in bytearray(dictionary[i:i + 16])))
+    lines.append('};')
+    lines.append('')
+    lines.append('const size_t lz_dictionary_length = %d;' % len(dictionary))
+    write_if_changed(os.path.join(top, 'src', 'generated', 'lz_dictionary.c'), '\n'.join(lines) + '\n')
+
+    js_path = os.path.join(top, out, 'generated', 'lz-dictionary.js')
+    write_if_changed(js_path, '// Generated by tools/generate.py from data/lz-dictionary.txt, do not edit\nvar LZ_DICTIONARY = %s;\n' % json.dumps(dictionary.decode('latin-1')))
+    return js_path
+
+def write_if_changed(path, contents):
+    if os.path.exists(path) and open(path).read() == contents:
+        return
+    with open(path, 'w') as f:
+        f.write(contents)
+
+if __name__ == '__main__':
+    top = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    out = sys.argv[1] if len(sys.argv) > 1 else 'build'
+    print(generate_bible_data(top, out))
+    print(generate_lz_dictionary(top, out))
@@ -0,0 +1,226 @@
+#include <pebble.h>
+#include <glob.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "host.h"
+#include "phone.h"
+#include "bible.h"
+#include "lz.h"
+
+// Compresses chapters window by window the way the phone does for the
+// viewer, and reports the compression ratio, the messages and bytes a
+// window takes on the link with and without compression, and what decoding
+// costs the watch per byte of text, timed on the host:
+//
+//     bench-lz [chapter.txt ...]
+//
+// The chapters default to ../fixtures/kjv/*.txt, real prose, and Psalm 119
+// of the phone's made-up text, so run it from tools/host like make bench.
+
+#define TEXT_SIZE       (32 * 1024)
+#define MIN_TIMING_NS   (50 * 1000 * 1000)
+
+// see STREAM_WINDOW_BYTES in viewer.c and INBOX_SIZE_LIMIT in appmessage.c
+#ifdef PBL_PLATFORM_APLITE
+#define WINDOW_BYTES    1024
+#define INBOX_SIZE      1024
+#else
+#define WINDOW_BYTES    2048
+#define INBOX_SIZE      4096
+#endif
+
+// dictionary header, a tuple header per key, int32 values
+#define DICT_HEADER     1
+#define TUPLE_HEADER    7
+#define INT_VALUE       4
+
+typedef struct {
+    size_t bytes;
+    size_t packed;
+    uint32_t windows;
+    uint32_t plain_messages;
+    size_t plain_wire;
+    uint32_t lz_messages;
+    size_t lz_wire;
+    double decode_ns;
+    double decode_cycles;
+} Result;
+
+static char text[TEXT_SIZE];
+static uint8_t packed[TEXT_SIZE];
+static size_t packed_length;
+static size_t decoded_length;
+
+static void packed_group(const uint8_t *data, size_t length, size_t consumed, void *context) {
+    memcpy(packed + packed_length, data, length);
+    packed_length += length;
+}
+
+static void decoded(const uint8_t *data, size_t length, void *context) {
+    decoded_length += length;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+static uint64_t cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Messages and bytes on the link for a window of length bytes of content,
+ * see packRows() and requestVerseText() in js/pebble-js-app.js: the first
+ * message carries token, type, index, length and end, the rest token, type
+ * and index, and every one a content tuple
+ */
+static void wire_cost(size_t length, bool string, uint32_t *messages, size_t *wire) {
+    size_t offset = 0;
+    for (int index = 0; offset < length || index == 0; index++) {
+        int ints = index == 0 ? 5 : 3;
+        size_t header = DICT_HEADER + (ints + 1) * TUPLE_HEADER + ints * INT_VALUE;
+        size_t budget = INBOX_SIZE - header - 1;
+        size_t content = length - offset < budget ? length - offset : budget;
+        *wire += header + content + (string ? 1 : 0);
+        (*messages)++;
+        offset += content;
+    }
+}
+
+static Result measure(const char *chapter, size_t length) {
+    Result result;
+    memset(&result, 0x0, sizeof(Result));
+    result.bytes = length;
+    static LzEncoder encoder;
+    static LzDecoder decoder;
+    static size_t starts[TEXT_SIZE / WINDOW_BYTES + 1];
+    static size_t lengths[TEXT_SIZE / WINDOW_BYTES + 1];
+
+    // every window is compressed on its own, the watch may ask for any
+    packed_length = 0;
+    for (size_t offset = 0; offset < length; offset += WINDOW_BYTES) {
+        size_t window = length - offset < WINDOW_BYTES ? length - offset : WINDOW_BYTES;
+        size_t start = packed_length;
+        lz_encoder_init(&encoder, packed_group, NULL);
+        lz_encode(&encoder, (const uint8_t *)chapter + offset, window);
+        lz_encoder_finish(&encoder);
+        starts[result.windows] = start;
+        lengths[result.windows] = packed_length - start;
+        result.windows++;
+        wire_cost(window, true, &result.plain_messages, &result.plain_wire);
+        // the phone sends a window as it is when compression does not pay
+        if (packed_length - start < window) {
+            wire_cost(packed_length - start, false, &result.lz_messages, &result.lz_wire);
+        } else {
+            wire_cost(window, true, &result.lz_messages, &result.lz_wire);
+        }
+    }
+    result.packed = packed_length;
+
+    // decode everything until enough time has passed to trust the clock
+    uint32_t rounds = 0;
+    uint64_t started = now_ns();
+    uint64_t started_cycles = cycles();
+    uint64_t elapsed = 0;
+    do {
+        decoded_length = 0;
+        for (uint32_t i = 0; i < result.windows; i++) {
+            lz_decoder_init(&decoder, decoded, NULL);
+            lz_decode(&decoder, packed + starts[i], lengths[i]);
+        }
+        rounds++;
+        elapsed = now_ns() - started;
+    } while (elapsed < MIN_TIMING_NS);
+    if (decoded_length != length) {
+        fprintf(stderr, "decoded %u of %u bytes\n", (unsigned)decoded_length, (unsigned)length);
+    }
+    result.decode_ns = (double)elapsed / rounds / length;
+    result.decode_cycles = (double)(cycles() - started_cycles) / rounds / length;
+    return result;
+}
+
+static void report(const char *name, const Result *result) {
+    printf("%-22.22s %6u %4u %6u %5.1f%%   %4u %6u   %4u %6u %8.2f %8.2f\n", name, (unsigned)result->bytes,
+        (unsigned)result->windows, (unsigned)result->packed, 100.0 * result->packed / result->bytes,
+        (unsigned)result->plain_messages, (unsigned)result->plain_wire, (unsigned)result->lz_messages,
+        (unsigned)result->lz_wire, result->decode_ns, result->decode_cycles);
+}
+
+static size_t read_chapter(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return 0;
+    }
+    size_t length = fread(text, 1, sizeof(text) - 1, file);
+    fclose(file);
+    // the phone sends no newline after the last verse
+    while (length > 0 && (text[length - 1] == '\n' || text[length - 1] == '\r')) {
+        length--;
+    }
+    text[length] = '\0';
+    return length;
+}
+
+int main(int argc, char *argv[]) {
+    host_set_log_level(APP_LOG_LEVEL_WARNING);
+    printf("%u byte windows, %u byte inbox, encoder %u and decoder %u bytes of state\n", WINDOW_BYTES, INBOX_SIZE,
+        (unsigned)sizeof(LzEncoder), (unsigned)sizeof(LzDecoder));
+    printf("%-22s %6s %4s %6s %6s   %11s   %11s %8s %8s\n", "", "", "", "", "", "plain", "compressed", "decode", "decode");
+    printf("%-22s %6s %4s %6s %6s   %4s %6s   %4s %6s %8s %8s\n", "chapter", "bytes", "wins", "packed", "ratio", "msgs",
+        "wire", "msgs", "wire", "ns/byte", "cyc/byte");
+
+    Result total;
+    memset(&total, 0x0, sizeof(Result));
+    glob_t found;
+    memset(&found, 0x0, sizeof(glob_t));
+    char **paths = argv + 1;
+    int num_paths = argc - 1;
+    if (num_paths == 0 && glob("../fixtures/kjv/*.txt", 0, NULL, &found) == 0) {
+        paths = found.gl_pathv;
+        num_paths = found.gl_pathc;
+    }
+    for (int i = 0; i < num_paths; i++) {
+        size_t length = read_chapter(paths[i]);
+        if (length == 0) {
+            continue;
+        }
+        const char *name = strrchr(paths[i], '/') != NULL ? strrchr(paths[i], '/') + 1 : paths[i];
+        Result result = measure(text, length);
+        report(name, &result);
+        total.bytes += result.bytes;
+        total.packed += result.packed;
+        total.windows += result.windows;
+        total.plain_messages += result.plain_messages;
+        total.plain_wire += result.plain_wire;
+        total.lz_messages += result.lz_messages;
+        total.lz_wire += result.lz_wire;
+        total.decode_ns += result.decode_ns * result.bytes;
+        total.decode_cycles += result.decode_cycles * result.bytes;
+    }
+    globfree(&found);
+    if (total.bytes > 0) {
+        total.decode_ns /= total.bytes;
+        total.decode_cycles /= total.bytes;
+        report("total", &total);
+    }
+
+    if (argc == 1) {
+        size_t length = phone_chapter_text(bible_find_book("Psalms"), 119, text, sizeof(text));
+        Result result = measure(text, length);
+        report("Psalms 119 (made up)", &result);
+    }
+    return 0;
+}
+
+// watch_main() is linked in but never run
+void app_event_loop(void) {
+}
@@ -0,0 +1,208 @@
+#include <pebble.h>
+#include "host.h"
+#include "phone.h"
+#include "bible.h"
+#include "textbuffer.h"
+
+// Feeds a chapter the size of Psalm 119 to the viewer's TextBuffer in
+// chunks, the way windows of it arrive over AppMessage, and counts the heap
+// allocations, the bytes copied and the heap peak. The same chunks also go
+// through the viewer's assembly before TextBuffer, a new string per chunk
+// holding all of the text so far, for comparison.
+//
+//     bench-textbuffer [chunk bytes ...]
+//
+// Chunks arrive in order, with every pair swapped, and each one twice like
+// after a lost acknowledgement.
+
+#define TEXT_SIZE       (32 * 1024)
+#define MAX_PENDING     TEXT_BUFFER_MAX_PENDING
+
+typedef enum {
+    OrderInOrder,
+    OrderSwapped,
+    OrderTwice,
+    NUM_ORDERS
+} Order;
+
+typedef struct {
+    uint32_t allocations;
+    size_t copied;
+    size_t peak;
+    size_t length;
+} Cost;
+
+// the viewer's state before TextBuffer
+typedef struct {
+    char *text;
+    int current_index;
+    char *pending[MAX_PENDING];
+    size_t copied;
+} Assembly;
+
+static const char *order_names[NUM_ORDERS] = { "in order", "swapped", "twice" };
+
+static char text[TEXT_SIZE];
+static size_t text_length;
+static char chunk[TEXT_SIZE];
+
+/*
+ * The index of the nth chunk to arrive
+ */
+static int arrival(Order order, int n, int num_chunks) {
+    switch (order) {
+        case OrderSwapped:
+            return (n ^ 1) < num_chunks ? n ^ 1 : n;
+        case OrderTwice:
+            return n / 2;
+        default:
+            return n;
+    }
+}
+
+static int arrivals(Order order, int num_chunks) {
+    return order == OrderTwice ? 2 * num_chunks : num_chunks;
+}
+
+static const char *chunk_at(int index, size_t chunk_size) {
+    size_t start = index * chunk_size;
+    size_t length = text_length - start < chunk_size ? text_length - start : chunk_size;
+    memcpy(chunk, text + start, length);
+    chunk[length] = '\0';
+    return chunk;
+}
+
+static void cost_begin(Cost *cost) {
+    memset(cost, 0x0, sizeof(Cost));
+    host_heap_reset_peak();
+    cost->allocations = host_heap_stats()->allocations;
+    cost->copied = host_heap_stats()->bytes_copied;
+    cost->peak = host_heap_stats()->used;
+}
+
+static void cost_end(Cost *cost) {
+    cost->allocations = host_heap_stats()->allocations - cost->allocations;
+    cost->copied = host_heap_stats()->bytes_copied - cost->copied;
+    cost->peak = host_heap_stats()->peak - cost->peak;
+}
+
+static void assembly_append(Assembly *assembly, const char *additional_text) {
+    char *new_text;
+    if (assembly->text == NULL) {
+        new_text = malloc(strlen(additional_text) + 1);
+        strcpy(new_text, additional_text);
+    } else {
+        new_text = malloc(strlen(assembly->text) + strlen(additional_text) + 1);
+        strcpy(new_text, assembly->text);
+        strcat(new_text, additional_text);
+        assembly->copied += strlen(assembly->text);
+        free(assembly->text);
+    }
+    assembly->copied += strlen(additional_text);
+    assembly->text = new_text;
+}
+
+/*
+ * viewer_in_received_handler() as it was before TextBuffer
+ */
+static void assembly_receive(Assembly *assembly, int index, const char *content) {
+    if (index <= assembly->current_index) {
+        return;
+    }
+    if (index > assembly->current_index + 1) {
+        int slot = index - assembly->current_index - 2;
+        if (slot >= MAX_PENDING || assembly->pending[slot] != NULL) {
+            return;
+        }
+        assembly->pending[slot] = malloc(strlen(content) + 1);
+        strcpy(assembly->pending[slot], content);
+        assembly->copied += strlen(content);
+        return;
+    }
+    assembly_append(assembly, content);
+    assembly->current_index = index;
+    while (assembly->pending[0] != NULL) {
+        char *pending = assembly->pending[0];
+        memmove(&assembly->pending[0], &assembly->pending[1], sizeof(assembly->pending[0]) * (MAX_PENDING - 1));
+        assembly->pending[MAX_PENDING - 1] = NULL;
+        assembly_append(assembly, pending);
+        free(pending);
+        assembly->current_index++;
+    }
+}
+
+static Cost run_assembly(Order order, size_t chunk_size) {
+    int num_chunks = (text_length + chunk_size - 1) / chunk_size;
+    Assembly assembly;
+    memset(&assembly, 0x0, sizeof(Assembly));
+    assembly.current_index = -1;
+    Cost cost;
+    cost_begin(&cost);
+    for (int n = 0; n < arrivals(order, num_chunks); n++) {
+        int index = arrival(order, n, num_chunks);
+        assembly_receive(&assembly, index, chunk_at(index, chunk_size));
+    }
+    cost_end(&cost);
+    cost.copied += assembly.copied;
+    cost.length = assembly.text != NULL ? strlen(assembly.text) : 0;
+    free(assembly.text);
+    return cost;
+}
+
+static Cost run_text_buffer(Order order, size_t chunk_size) {
+    int num_chunks = (text_length + chunk_size - 1) / chunk_size;
+    TextBuffer buffer;
+    text_buffer_init(&buffer);
+    size_t stashed = 0;
+    Cost cost;
+    cost_begin(&cost);
+    for (int n = 0; n < arrivals(order, num_chunks); n++) {
+        int index = arrival(order, n, num_chunks);
+        const char *content = chunk_at(index, chunk_size);
+        int slot = index - buffer.next_index - 1;
+        if (slot >= 0 && slot < TEXT_BUFFER_MAX_PENDING && buffer.pending[slot] == NULL) {
+            stashed += strlen(content);
+        }
+        text_buffer_add_chunk(&buffer, index, content, strlen(content));
+    }
+    cost_end(&cost);
+    cost.copied += buffer.appended + stashed;
+    cost.length = buffer.length;
+    text_buffer_deinit(&buffer);
+    return cost;
+}
+
+int main(int argc, char *argv[]) {
+    static const size_t default_sizes[] = { 100, 1000, 4000 };
+    host_set_log_level(APP_LOG_LEVEL_WARNING);
+    host_heap_set_limit(256 * 1024);
+    text_length = phone_chapter_text(bible_find_book("Psalms"), 119, text, sizeof(text));
+
+    printf("Psalms 119, %u bytes\n", (unsigned)text_length);
+    printf("%5s %-8s %6s   %6s %8s %6s   %6s %8s %6s\n", "", "", "", "before", "", "", "TextBuffer", "", "");
+    printf("%5s %-8s %6s   %6s %8s %6s   %6s %8s %6s\n", "chunk", "order", "chunks", "allocs", "copied", "peak", "allocs",
+        "copied", "peak");
+    int num_sizes = argc > 1 ? argc - 1 : (int)(sizeof(default_sizes) / sizeof(default_sizes[0]));
+    for (int i = 0; i < num_sizes; i++) {
+        size_t chunk_size = argc > 1 ? (size_t)atoi(argv[i + 1]) : default_sizes[i];
+        if (chunk_size == 0) {
+            continue;
+        }
+        for (Order order = 0; order < NUM_ORDERS; order++) {
+            Cost before = run_assembly(order, chunk_size);
+            Cost after = run_text_buffer(order, chunk_size);
+            if (before.length != text_length || after.length != text_length) {
+                fprintf(stderr, "%u byte chunks %s: assembled %u and %u of %u bytes\n", (unsigned)chunk_size,
+                    order_names[order], (unsigned)before.length, (unsigned)after.length, (unsigned)text_length);
+            }
+            printf("%5u %-8s %6u   %6u %8u %6u   %6u %8u %6u\n", (unsigned)chunk_size, order_names[order],
+                (unsigned)((text_length + chunk_size - 1) / chunk_size), (unsigned)before.allocations, (unsigned)before.copied,
+                (unsigned)before.peak, (unsigned)after.allocations, (unsigned)after.copied, (unsigned)after.peak);
+        }
+    }
+    return 0;
+}
+
+// watch_main() is linked in but never run
+void app_event_loop(void) {
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <pebble.h>
+
+// The host side of the stub SDK: a simulated clock and event queue, heap
+// and display accounting, a Bluetooth link to the scripted phone in
+// phone.c, and the hooks scenario.c drives the app's UI with.
+
+// Screen of the platform being simulated
+#if PBL_ROUND
+#define HOST_SCREEN_WIDTH   180
+#define HOST_SCREEN_HEIGHT  180
+#else
+#define HOST_SCREEN_WIDTH   144
+#define HOST_SCREEN_HEIGHT  168
+#endif
+
+// Largest inbox and outbox AppMessage offers
+#define HOST_APP_MESSAGE_SIZE_MAXIMUM 8200
+
+// Per-app persist storage
+#define HOST_PERSIST_BUDGET 4096
+
+typedef void (*HostEventCallback)(void *data);
+typedef struct HostEvent HostEvent;
+
+typedef enum {
+    HostClickSingle,
+    HostClickLong,
+    HostClickDouble,
+} HostClick;
+
+typedef struct {
+    size_t used;
+    size_t peak;
+    size_t limit;
+    uint32_t allocations;
+    uint32_t frees;
+    uint32_t failures;
+    // moved by realloc() from the old block to the new one
+    size_t bytes_copied;
+} HostHeapStats;
+
+typedef struct {
+    uint32_t frames;
+    uint32_t texts_drawn;
+    uint32_t texts_measured;
+    uint32_t bytes_measured;
+    uint32_t vibes;
+} HostDisplayStats;
+
+typedef struct {
+    // one way, and the time a byte takes on the air
+    uint32_t latency_ms;
+    uint32_t bytes_per_second;
+} HostLinkConfig;
+
+typedef struct {
+    uint32_t messages_out;
+    uint32_t bytes_out;
+    uint32_t messages_in;
+    uint32_t bytes_in;
+    uint32_t dropped_in;
+} HostLinkStats;
+
+// Clock and events
+uint32_t host_now(void);
+HostEvent *host_schedule(uint32_t delay_ms, HostEventCallback callback, void *data);
+bool host_cancel(HostEvent *event);
+bool host_idle(void);
+uint32_t host_next_time(void);
+bool host_run_next(void);
+
+// Heap
+const HostHeapStats *host_heap_stats(void);
+void host_heap_set_limit(size_t limit);
+void host_heap_reset_peak(void);
+size_t host_heap_report_leaks(FILE *out);
+
+// Display and UI
+const HostDisplayStats *host_display_stats(void);
+void host_render(void);
+bool host_has_windows(void);
+bool host_click(ButtonId button, HostClick click);
+bool host_menu_select(const char *label, HostClick click);
+void host_describe_screen(char *description, size_t size);
+void host_set_dictation(const char *transcription);
+
+// Link, the phone end in phone.c gets phone_receive() and answers with
+// host_link_send()
+void host_link_configure(const HostLinkConfig *config);
+const HostLinkStats *host_link_stats(void);
+uint32_t host_link_send(const uint8_t *dictionary, uint16_t size);
+uint32_t host_link_inbox_size(void);
+void host_app_message_close(void);
+
+// Persist
+bool host_persist_load(const char *path);
+bool host_persist_save(const char *path);
+size_t host_persist_bytes(void);
+
+// Logging, APP_LOG levels up to this one are printed
+void host_set_log_level(uint8_t level);
@@ -0,0 +1,705 @@
+#include <pebble.h>
+#include <ctype.h>
+#include "host.h"
+#include "phone.h"
+#include "common.h"
+#include "bible.h"
+#include "lz.h"
+
+#define PHONE_READY_MS       300
+#define DEFAULT_INBOX_SIZE   128
+#define DEFAULT_RANGE_BYTES  2048
+#define OUT_QUEUE_SIZE       64
+#define MAX_WAITING          16
+#define MAX_CANCELLED        32
+#define MAX_FAVORITES        64
+#define MAX_ROWS             256
+#define ROW_SIZE             64
+#define NUM_CHAPTERS         1189
+#define PASSAGE_SIZE         (512 * 1024)
+#define CONTENT_SIZE         HOST_APP_MESSAGE_SIZE_MAXIMUM
+
+// A request from the watch, kept while it waits for chapters to be fetched
+typedef struct {
+    bool used;
+    uint8_t type;
+    uint32_t token;
+    char book[24];
+    uint8_t chapter;
+    char range[8];
+    char query[64];
+    uint32_t offset;
+    uint16_t length;
+    uint32_t revision;
+    int fetch_book;
+    int fetch_chapter;
+} Request;
+
+typedef struct {
+    uint32_t token;
+    uint16_t size;
+    uint8_t bytes[HOST_APP_MESSAGE_SIZE_MAXIMUM];
+} OutMessage;
+
+typedef struct {
+    uint32_t key;
+    int32_t value;
+} Field;
+
+typedef struct {
+    char book[24];
+    uint8_t chapter;
+    char range[8];
+} PhoneFavorite;
+
+static void handle_request(Request *request);
+static void js_ready(void *data);
+static void fetched(void *data);
+static void acked(void *data);
+static void pump(void);
+static DictionaryIterator *reply_begin(uint32_t token, uint8_t message_type);
+static void reply_end(void);
+static uint32_t content_budget(void);
+static void pack_rows(uint32_t token, uint8_t message_type, const char *rows[], int num_rows, const Field *extra, int num_extra);
+static bool need_chapter(Request *request, int book, int chapter);
+static size_t chapter_text(int book, int chapter, int first, int last, char *text, size_t size);
+static size_t verse_line(int book, int chapter, int verse, char *line, size_t size);
+static int chapter_ranges(int book, int chapter, char ranges[][ROW_SIZE]);
+static bool parse_range(const char *range, int *first, int *last);
+static size_t utf8_boundary(const char *bytes, size_t length, size_t offset);
+static void packed_group(const uint8_t *data, size_t length, size_t consumed, void *context);
+static bool is_cancelled(uint32_t token);
+static int32_t tuple_int(const Tuple *tuple);
+static void tuple_string(const Tuple *tuple, char *string, size_t size);
+
+static PhoneConfig config;
+static uint32_t inbox_size = DEFAULT_INBOX_SIZE;
+static uint32_t range_bytes = DEFAULT_RANGE_BYTES;
+static bool compression;
+static int muted;
+
+static OutMessage out_queue[OUT_QUEUE_SIZE];
+static uint8_t out_queue_head;
+static uint8_t out_queue_count;
+static uint8_t in_flight;
+static DictionaryIterator reply_iter;
+
+static Request waiting[MAX_WAITING];
+static uint32_t cancelled[MAX_CANCELLED];
+static uint8_t num_cancelled;
+static bool chapter_fetched[NUM_CHAPTERS];
+static bool chapter_fetching[NUM_CHAPTERS];
+static int num_fetched;
+
+static PhoneFavorite favorites[MAX_FAVORITES];
+static int num_favorites;
+static uint32_t favorites_revision;
+
+static char passage[PASSAGE_SIZE];
+static uint8_t packed[PASSAGE_SIZE];
+static size_t packed_length;
+static char content[CONTENT_SIZE];
+static char rows_storage[MAX_ROWS][ROW_SIZE];
+
+void phone_start(const PhoneConfig *phone_config) {
+    config = *phone_config;
+    if (config.window == 0) {
+        config.window = 1;
+    }
+    host_schedule(PHONE_READY_MS, js_ready, NULL);
+}
+
+/*
+ * An AppMessage from the watch, see the 'appmessage' listener in
+ * js/pebble-js-app.js
+ */
+void phone_receive(DictionaryIterator *iter) {
+    Request request;
+    memset(&request, 0x0, sizeof(Request));
+    Tuple *request_tuple = dict_find(iter, KEY_REQUEST);
+    if (request_tuple == NULL) {
+        return;
+    }
+    request.type = tuple_int(request_tuple);
+    request.token = tuple_int(dict_find(iter, KEY_TOKEN));
+    request.chapter = tuple_int(dict_find(iter, KEY_CHAPTER));
+    request.offset = tuple_int(dict_find(iter, KEY_OFFSET));
+    request.length = tuple_int(dict_find(iter, KEY_LENGTH));
+    request.revision = tuple_int(dict_find(iter, KEY_REVISION));
+    tuple_string(dict_find(iter, KEY_BOOK), request.book, sizeof(request.book));
+    tuple_string(dict_find(iter, KEY_RANGE), request.range, sizeof(request.range));
+    tuple_string(dict_find(iter, KEY_CONTENT), request.query, sizeof(request.query));
+
+    if (request.type == RequestTypeConfigure) {
+        inbox_size = tuple_int(dict_find(iter, KEY_INBOX_SIZE));
+        inbox_size = inbox_size > 0 ? inbox_size : DEFAULT_INBOX_SIZE;
+        compression = tuple_int(dict_find(iter, KEY_COMPRESSION)) != 0;
+        range_bytes = tuple_int(dict_find(iter, KEY_RANGE_BYTES));
+        range_bytes = range_bytes > 0 ? range_bytes : DEFAULT_RANGE_BYTES;
+        char platform[16] = "";
+        tuple_string(dict_find(iter, KEY_PLATFORM), platform, sizeof(platform));
+        APP_LOG(APP_LOG_LEVEL_INFO, "Phone: handshake with %s watch, inbox %d bytes, compression %d", platform,
+            (int)inbox_size, compression);
+    } else if (request.type != RequestTypeCancel && muted > 0) {
+        APP_LOG(APP_LOG_LEVEL_INFO, "Phone: never answering request %d", (int)request.token);
+        muted--;
+        return;
+    }
+    handle_request(&request);
+}
+
+/*
+ * Leave the next requests unanswered without a word, the way the phone
+ * gives up on a reply once a message of it fails too often
+ */
+void phone_mute(int requests) {
+    muted = requests;
+}
+
+/*
+ * The whole text of a chapter, every verse on a line of its own, as the
+ * phone sends it
+ */
+size_t phone_chapter_text(int book, int chapter, char *text, size_t size) {
+    return chapter_text(book, chapter, 1, 0, text, size);
+}
+
+static void handle_request(Request *request) {
+    if (request->type != RequestTypeCancel && is_cancelled(request->token)) {
+        return;
+    }
+    int book = bible_find_book(request->book);
+    int first = 0;
+    int last = 0;
+
+    switch (request->type) {
+        case RequestTypeConfigure: {
+            // warm the passage the watch resumes, it asks for it next
+            if (book >= 0 && request->chapter > 0) {
+                need_chapter(request, book, request->chapter);
+            }
+            break;
+        }
+
+        case RequestTypeVerses: {
+            if (book < 0 || !need_chapter(request, book, request->chapter)) {
+                break;
+            }
+            const char *rows[MAX_ROWS];
+            int num_rows = chapter_ranges(book, request->chapter, rows_storage);
+            for (int i = 0; i < num_rows; i++) {
+                rows[i] = rows_storage[i];
+            }
+            pack_rows(request->token, MessageTypeVerses, rows, num_rows, NULL, 0);
+            break;
+        }
+
+        case RequestTypeViewer: {
+            if (book < 0 || !parse_range(request->range, &first, &last)) {
+                break;
+            }
+            // one verse per line, an open end continues with the next
+            // chapters of the book after a heading line, see PassageStream
+            size_t length = 0;
+            int chapter = request->chapter;
+            bool complete = false;
+            while (!complete && length < request->offset + request->length) {
+                if (!need_chapter(request, book, chapter)) {
+                    return;
+                }
+                if (length > 0) {
+                    length += snprintf(passage + length, sizeof(passage) - length, "\n%s %d\n", request->book, chapter);
+                }
+                length += chapter_text(book, chapter, chapter == request->chapter ? first : 1, last, passage + length,
+                    sizeof(passage) - length);
+                complete = last > 0 || chapter == bible_books[book].chapters || length + ROW_SIZE >= sizeof(passage);
+                chapter++;
+            }
+            size_t start = request->offset < length ? request->offset : length;
+            size_t end = start + request->length < length ? utf8_boundary(passage, length, start + request->length) : length;
+            bool passage_end = complete && end == length;
+
+            reply_begin(request->token, MessageTypeViewer);
+            dict_write_int32(&reply_iter, KEY_INDEX, 0);
+            dict_write_int32(&reply_iter, KEY_LENGTH, end - start);
+            dict_write_int32(&reply_iter, KEY_END, passage_end ? 1 : 0);
+            uint32_t budget = content_budget();
+
+            // compressed windows go out as byte arrays, see compressedChunks()
+            static LzEncoder encoder;
+            packed_length = 0;
+            if (compression) {
+                lz_encoder_init(&encoder, packed_group, NULL);
+                lz_encode(&encoder, (const uint8_t *)passage + start, end - start);
+                lz_encoder_finish(&encoder);
+            }
+            if (compression && packed_length < end - start) {
+                for (size_t chunk = 0, index = 0; chunk < packed_length || index == 0; chunk += budget, index++) {
+                    if (index > 0) {
+                        reply_begin(request->token, MessageTypeViewer);
+                        dict_write_int32(&reply_iter, KEY_INDEX, index);
+                    }
+                    size_t chunk_length = packed_length - chunk < budget ? packed_length - chunk : budget;
+                    dict_write_data(&reply_iter, KEY_CONTENT, packed + chunk, chunk_length);
+                    reply_end();
+                }
+                break;
+            }
+            size_t chunk = start;
+            int index = 0;
+            do {
+                if (index > 0) {
+                    reply_begin(request->token, MessageTypeViewer);
+                    dict_write_int32(&reply_iter, KEY_INDEX, index);
+                }
+                size_t chunk_end = chunk + budget < end ? utf8_boundary(passage, end, chunk + budget) : end;
+                memcpy(content, passage + chunk, chunk_end - chunk);
+                content[chunk_end - chunk] = '\0';
+                dict_write_cstring(&reply_iter, KEY_CONTENT, content);
+                reply_end();
+                chunk = chunk_end;
+                index++;
+            } while (chunk < end);
+            break;
+        }
+
+        case RequestTypeCancel: {
+            if (!is_cancelled(request->token)) {
+                cancelled[num_cancelled++ % MAX_CANCELLED] = request->token;
+            }
+            // what is still queued is dropped, what is in flight arrives
+            int kept = 0;
+            for (int i = 0; i < out_queue_count; i++) {
+                OutMessage *message = &out_queue[(out_queue_head + i) % OUT_QUEUE_SIZE];
+                if (message->token != request->token) {
+                    out_queue[(out_queue_head + kept++) % OUT_QUEUE_SIZE] = *message;
+                }
+            }
+            out_queue_count = kept;
+            break;
+        }
+
+        case RequestTypeFavorites: {
+            // the watch is either up to date or gets the whole list
+            const char *rows[MAX_FAVORITES];
+            int num_rows = 0;
+            if (request->revision != favorites_revision) {
+                for (int i = 0; i < num_favorites; i++) {
+                    int written = snprintf(rows_storage[num_rows], ROW_SIZE, "+%c%s%c%d%c%s", FIELD_SEPARATOR,
+                        favorites[i].book, FIELD_SEPARATOR, favorites[i].chapter, FIELD_SEPARATOR, favorites[i].range);
+                    if (written < 0 || written >= ROW_SIZE) {
+                        APP_LOG(APP_LOG_LEVEL_WARNING, "Phone: favorite %d does not fit a row", i);
+                        continue;
+                    }
+                    rows[num_rows] = rows_storage[num_rows];
+                    num_rows++;
+                }
+            }
+            Field extra[] = {
+                { KEY_REVISION, favorites_revision },
+                { KEY_RESET, request->revision != favorites_revision ? 1 : 0 },
+                { KEY_LENGTH, num_rows },
+            };
+            pack_rows(request->token, MessageTypeFavorites, rows, num_rows, extra, 3);
+            break;
+        }
+
+        case RequestTypeToggleFavorite: {
+            char op = '+';
+            int found = -1;
+            for (int i = 0; i < num_favorites && found < 0; i++) {
+                if (strcmp(favorites[i].book, request->book) == 0 && favorites[i].chapter == request->chapter &&
+                        strcmp(favorites[i].range, request->range) == 0) {
+                    found = i;
+                }
+            }
+            if (found >= 0) {
+                op = '-';
+                memmove(&favorites[found], &favorites[found + 1], (num_favorites - found - 1) * sizeof(PhoneFavorite));
+                num_favorites--;
+            } else if (num_favorites < MAX_FAVORITES) {
+                PhoneFavorite *favorite = &favorites[num_favorites++];
+                snprintf(favorite->book, sizeof(favorite->book), "%s", request->book);
+                favorite->chapter = request->chapter;
+                snprintf(favorite->range, sizeof(favorite->range), "%s", request->range);
+            } else {
+                break;
+            }
+            favorites_revision++;
+            reply_begin(request->token, MessageTypeFavoritesDidChange);
+            dict_write_int32(&reply_iter, KEY_REVISION, favorites_revision);
+            snprintf(content, sizeof(content), "%c%c%s%c%d%c%s", op, FIELD_SEPARATOR, request->book, FIELD_SEPARATOR,
+                request->chapter, FIELD_SEPARATOR, request->range);
+            dict_write_cstring(&reply_iter, KEY_CONTENT, content);
+            reply_end();
+            break;
+        }
+
+        case RequestTypeNextPassage: {
+            // see nextPassage() in js/pebble-js-app.js
+            if (book < 0 || !parse_range(request->range, &first, &last)) {
+                break;
+            }
+            int next_book = book;
+            int next_chapter = request->chapter + 1;
+            if (next_chapter > bible_books[book].chapters) {
+                next_book = book + 1 < BIBLE_NUM_BOOKS ? book + 1 : -1;
+                next_chapter = 1;
+            }
+            // a row of chapter_ranges(), which fits any range
+            char range[ROW_SIZE] = "";
+            int passage_book = -1;
+            int passage_chapter = 0;
+            if (last == 0) {
+                if (next_book >= 0) {
+                    passage_book = next_book;
+                    passage_chapter = next_chapter;
+                    snprintf(range, sizeof(range), "1-");
+                }
+            } else {
+                if (!need_chapter(request, book, request->chapter)) {
+                    return;
+                }
+                int num_ranges = chapter_ranges(book, request->chapter, rows_storage);
+                for (int i = 0; i < num_ranges && passage_book < 0; i++) {
+                    if (atoi(rows_storage[i]) > last) {
+                        passage_book = book;
+                        passage_chapter = request->chapter;
+                        memcpy(range, rows_storage[i], sizeof(range));
+                    }
+                }
+                if (passage_book < 0 && next_book >= 0) {
+                    if (!need_chapter(request, next_book, next_chapter)) {
+                        return;
+                    }
+                    chapter_ranges(next_book, next_chapter, rows_storage);
+                    passage_book = next_book;
+                    passage_chapter = next_chapter;
+                    memcpy(range, rows_storage[0], sizeof(range));
+                }
+            }
+            reply_begin(request->token, MessageTypeNextPassage);
+            if (passage_book >= 0) {
+                dict_write_cstring(&reply_iter, KEY_BOOK, bible_books[passage_book].name);
+                dict_write_int32(&reply_iter, KEY_CHAPTER, passage_chapter);
+                dict_write_cstring(&reply_iter, KEY_RANGE, range);
+            }
+            reply_end();
+            break;
+        }
+
+        case RequestTypeSearch: {
+            // references only, "<book> <chapter>[:<verse>[-<verse>]]" with
+            // the book named by the start of its name
+            char query[64];
+            size_t length = 0;
+            for (const char *c = request->query; *c != '\0' && length < sizeof(query) - 1; c++) {
+                if (*c != ' ' || (length > 0 && isdigit((unsigned char)c[1]))) {
+                    query[length++] = tolower((unsigned char)*c);
+                }
+            }
+            query[length] = '\0';
+            char *numbers = query + (isdigit((unsigned char)query[0]) ? 1 : 0);
+            numbers += strspn(numbers, "abcdefghijklmnopqrstuvwxyz");
+            int match = -1;
+            size_t letters = numbers - query;
+            for (int i = 0; i < BIBLE_NUM_BOOKS && match < 0 && letters > 0; i++) {
+                char name[24];
+                size_t name_length = 0;
+                for (const char *c = bible_books[i].name; *c != '\0'; c++) {
+                    if (*c != ' ') {
+                        name[name_length++] = tolower((unsigned char)*c);
+                    }
+                }
+                if (name_length >= letters && strncmp(name, query, letters) == 0) {
+                    match = i;
+                }
+            }
+            int chapter = 0;
+            int verse = 0;
+            int verse_last = 0;
+            int fields = sscanf(*numbers == ' ' ? numbers + 1 : numbers, "%d:%d-%d", &chapter, &verse, &verse_last);
+            if (match >= 0 && fields >= 1 && chapter >= 1 && chapter <= bible_books[match].chapters) {
+                char range[8] = "1-";
+                if (fields >= 2) {
+                    verse_last = fields == 3 ? verse_last : verse;
+                    snprintf(range, sizeof(range), "%d-%d", verse, verse_last);
+                }
+                reply_begin(request->token, MessageTypeSearch);
+                dict_write_cstring(&reply_iter, KEY_BOOK, bible_books[match].name);
+                dict_write_int32(&reply_iter, KEY_CHAPTER, chapter);
+                dict_write_cstring(&reply_iter, KEY_RANGE, range);
+                reply_end();
+            } else {
+                pack_rows(request->token, MessageTypeSearch, NULL, 0, NULL, 0);
+            }
+            break;
+        }
+    }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// Sending, several messages in flight like js/transport.js
+
+static void js_ready(void *data) {
+    reply_begin(0, MessageTypePebbleJSInitialized);
+    dict_write_int32(&reply_iter, KEY_VERSION, PROTOCOL_VERSION);
+    dict_write_int32(&reply_iter, KEY_LENGTH, num_fetched);
+    reply_end();
+}
+
+static DictionaryIterator *reply_begin(uint32_t token, uint8_t message_type) {
+    if (out_queue_count == OUT_QUEUE_SIZE) {
+        APP_LOG(APP_LOG_LEVEL_ERROR, "Phone: outgoing queue full");
+        out_queue_count--;
+    }
+    OutMessage *message = &out_queue[(out_queue_head + out_queue_count) % OUT_QUEUE_SIZE];
+    message->token = token;
+    dict_write_begin(&reply_iter, message->bytes, inbox_size);
+    if (token != 0) {
+        dict_write_int32(&reply_iter, KEY_TOKEN, token);
+    }
+    dict_write_int32(&reply_iter, KEY_MESSAGE_TYPE, message_type);
+    return &reply_iter;
+}
+
+static void reply_end(void) {
+    OutMessage *message = &out_queue[(out_queue_head + out_queue_count) % OUT_QUEUE_SIZE];
+    message->size = dict_write_end(&reply_iter);
+    out_queue_count++;
+    pump();
+}
+
+/*
+ * Bytes left for a content string in the message being written, see
+ * contentBudget() in js/transport.js
+ */
+static uint32_t content_budget(void) {
+    return inbox_size - dict_write_end(&reply_iter) - sizeof(Tuple) - 1;
+}
+
+static void pump(void) {
+    while (in_flight < config.window && out_queue_count > 0) {
+        OutMessage *message = &out_queue[out_queue_head];
+        out_queue_head = (out_queue_head + 1) % OUT_QUEUE_SIZE;
+        out_queue_count--;
+        in_flight++;
+        host_schedule(host_link_send(message->bytes, message->size), acked, NULL);
+    }
+}
+
+static void acked(void *data) {
+    in_flight--;
+    pump();
+}
+
+/*
+ * Pack rows of fields into as few messages as fit the watch's inbox, each
+ * with the index of its first row, see packRows()
+ */
+static void pack_rows(uint32_t token, uint8_t message_type, const char *rows[], int num_rows, const Field *extra, int num_extra) {
+    int32_t budget = 0;
+    size_t length = 0;
+    for (int i = 0; i < num_rows; i++) {
+        int32_t row_length = strlen(rows[i]);
+        if (length > 0 && row_length + 1 <= budget) {
+            length += snprintf(content + length, sizeof(content) - length, "%c%s", ROW_SEPARATOR, rows[i]);
+            budget -= row_length + 1;
+            continue;
+        }
+        if (length > 0) {
+            dict_write_cstring(&reply_iter, KEY_CONTENT, content);
+            reply_end();
+        }
+        reply_begin(token, message_type);
+        dict_write_int32(&reply_iter, KEY_INDEX, i);
+        for (int j = 0; j < num_extra; j++) {
+            dict_write_int32(&reply_iter, extra[j].key, extra[j].value);
+        }
+        budget = content_budget() - row_length;
+        length = snprintf(content, sizeof(content), "%s", rows[i]);
+    }
+    if (length > 0) {
+        dict_write_cstring(&reply_iter, KEY_CONTENT, content);
+        reply_end();
+        return;
+    }
+    reply_begin(token, message_type);
+    for (int j = 0; j < num_extra; j++) {
+        dict_write_int32(&reply_iter, extra[j].key, extra[j].value);
+    }
+    reply_end();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// Chapters and their text
+
+/*
+ * Whether a chapter has been fetched. If not, the fetch is started and the
+ * request handled again once it is in.
+ */
+static bool need_chapter(Request *request, int book, int chapter) {
+    int index = bible_books[book].first_chapter + chapter - 1;
+    if (chapter_fetched[index]) {
+        return true;
+    }
+    for (int i = 0; i < MAX_WAITING; i++) {
+        if (!waiting[i].used) {
+            waiting[i] = *request;
+            waiting[i].used = true;
+            waiting[i].fetch_book = book;
+            waiting[i].fetch_chapter = chapter;
+            // whoever asks for a chapter already being fetched waits for it
+            host_schedule(chapter_fetching[index] ? config.fetch_ms / 2 : config.fetch_ms, fetched, &waiting[i]);
+            chapter_fetching[index] = true;
+            return false;
+        }
+    }
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Phone: too many requests waiting for chapters");
+    return false;
+}
+
+static void fetched(void *data) {
+    Request *request = data;
+    int index = bible_books[request->fetch_book].first_chapter + request->fetch_chapter - 1;
+    if (!chapter_fetched[index]) {
+        chapter_fetched[index] = true;
+        num_fetched++;
+    }
+    Request retry = *request;
+    request->used = false;
+    if (retry.type != RequestTypeConfigure) {
+        handle_request(&retry);
+    }
+}
+
+/*
+ * The verse ranges of the verses list, whole verses of at most range_bytes
+ * each, see verseRanges()
+ */
+static int chapter_ranges(int book, int chapter, char ranges[][ROW_SIZE]) {
+    int num_ranges = 0;
+    int first = 0;
+    size_t bytes = 0;
+    int verses = bible_verse_count(book, chapter);
+    char line[256];
+    for (int verse = 1; verse <= verses && num_ranges < MAX_ROWS; verse++) {
+        size_t length = verse_line(book, chapter, verse, line, sizeof(line)) + 1;
+        if (bytes > 0 && bytes + length > range_bytes) {
+            snprintf(ranges[num_ranges++], ROW_SIZE, "%d-%d", first, verse - 1);
+            bytes = 0;
+        }
+        if (bytes == 0) {
+            first = verse;
+        }
+        bytes += length;
+    }
+    if (bytes > 0 && num_ranges < MAX_ROWS) {
+        snprintf(ranges[num_ranges++], ROW_SIZE, "%d-%d", first, verses);
+    }
+    return num_ranges;
+}
+
+/*
+ * Lines of verses first to last, or to the end of the chapter if last is 0,
+ * without the newline after the last one
+ */
+static size_t chapter_text(int book, int chapter, int first, int last, char *text, size_t size) {
+    int verses = bible_verse_count(book, chapter);
+    size_t length = 0;
+    for (int verse = first; verse <= (last > 0 && last < verses ? last : verses) && length + 256 < size; verse++) {
+        if (verse > first) {
+            text[length++] = '\n';
+        }
+        length += verse_line(book, chapter, verse, text + length, size - length);
+    }
+    text[length] = '\0';
+    return length;
+}
+
+/*
+ * "<verse>) " and words picked by a hash of the verse, some with curly
+ * quotes so there is UTF-8 to split
+ */
+static size_t verse_line(int book, int chapter, int verse, char *line, size_t size) {
+    static const char *words[] = {
+        "and", "the", "LORD", "said", "unto", "him", "in", "of", "that", "his", "was", "upon", "all", "them",
+        "they", "shall", "be", "for", "thou", "not", "with", "which", "God", "is", "earth", "heaven", "people",
+        "land", "day", "son", "house", "king", "Israel", "were", "from", "went", "came", "before", "hand",
+        "Jacob\xe2\x80\x99s", "\xe2\x80\x9c" "Behold\xe2\x80\x9d", "righteousness", "commandments", "therefore",
+    };
+    uint32_t state = ((book + 1) * 151 + chapter) * 211 + verse;
+    state = state * 2654435761u;
+    size_t target = 60 + (state >> 8) % 140;
+    size_t length = snprintf(line, size, "%d) ", verse);
+    bool first_word = true;
+    while (length < target && length + 24 < size) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        const char *word = words[state % (sizeof(words) / sizeof(words[0]))];
+        length += snprintf(line + length, size - length, "%s%c%s", first_word ? "" : " ", first_word ? toupper(word[0]) : word[0],
+            word + 1);
+        first_word = false;
+    }
+    length += snprintf(line + length, size - length, ".");
+    return length;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// Helpers
+
+/*
+ * "<first>-<last>" or "<first>-" for the rest of the book, last is then 0
+ */
+static bool parse_range(const char *range, int *first, int *last) {
+    *last = 0;
+    if (sscanf(range, "%d-%d", first, last) < 1) {
+        return false;
+    }
+    return *first > 0;
+}
+
+static size_t utf8_boundary(const char *bytes, size_t length, size_t offset) {
+    while (offset > 0 && offset < length && (bytes[offset] & 0xC0) == 0x80) {
+        offset--;
+    }
+    return offset;
+}
+
+static void packed_group(const uint8_t *data, size_t length, size_t consumed, void *context) {
+    if (packed_length + length <= sizeof(packed)) {
+        memcpy(packed + packed_length, data, length);
+        packed_length += length;
+    }
+}
+
+static bool is_cancelled(uint32_t token) {
+    for (int i = 0; i < MAX_CANCELLED && i < num_cancelled; i++) {
+        if (cancelled[i] == token) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int32_t tuple_int(const Tuple *tuple) {
+    if (tuple == NULL) {
+        return 0;
+    }
+    switch (tuple->length) {
+        case 1:
+            return tuple->type == TUPLE_INT ? tuple->value->int8 : tuple->value->uint8;
+        case 2:
+            return tuple->type == TUPLE_INT ? tuple->value->int16 : tuple->value->uint16;
+        default:
+            return tuple->value->int32;
+    }
+}
+
+static void tuple_string(const Tuple *tuple, char *string, size_t size) {
+    string[0] = '\0';
+    if (tuple != NULL && tuple->type == TUPLE_CSTRING) {
+        snprintf(string, size, "%s", tuple->value->cstring);
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <pebble.h>
+
+// Stand-in for PebbleKit JS on the other end of the host's link. It answers
+// the watch's requests the way js/pebble-js-app.js does, with the same
+// message layout and packing, over synthetic passage text: every verse of
+// data/bible.json gets a line of made-up words, the same on every run.
+// Its buffers are static so none of it shows up on the watch's heap.
+
+typedef struct {
+    // first use of a chapter waits this long, like a fetch from the API
+    uint32_t fetch_ms;
+    // messages sent to the watch before waiting for an acknowledgement
+    uint8_t window;
+} PhoneConfig;
+
+void phone_start(const PhoneConfig *config);
+void phone_receive(DictionaryIterator *iter);
+void phone_mute(int requests);
+size_t phone_chapter_text(int book, int chapter, char *text, size_t size);
@@ -0,0 +1,237 @@
+#include <pebble.h>
+#include <ctype.h>
+#include <getopt.h>
+#include "host.h"
+#include "phone.h"
+
+// Runs the watch app from src/ against the stub SDK and the scripted phone,
+// one scenario line at a time, and prints what each step cost:
+//
+//     bible-host [-v] [-m heap] [-l latency] [-b bytes/s] [-f fetch] [-w window]
+//                [-s state] scenario.txt
+//
+// A scenario has one command per line, # starts a comment:
+//
+//     select <label>   select the menu row showing label, or starting with it,
+//                      or "#<n>", the nth row counting across sections
+//     long <label>     the same with a long press
+//     up [n], down [n] press up or down n times
+//     click, double, hold
+//                      press select once, twice quickly or long
+//     back             press back
+//     say <text>       what dictation hears next
+//     mute [n]         the phone leaves the next n requests unanswered
+//     wait <ms>        let time pass
+//
+// A step runs until nothing is due within SETTLE_MS. Its reply column is when
+// the first message from the phone came in, settled when the screen last
+// changed, both in simulated ms from the start of the step.
+
+#define SETTLE_MS     10000
+#define MAX_STEP_MS   (10 * 60 * 1000)
+#define MAX_LINES     256
+#define LINE_SIZE     128
+
+int watch_main(void);
+
+typedef struct {
+    uint32_t start;
+    uint32_t first_reply;
+    uint32_t last_frame;
+    bool replied;
+    HostHeapStats heap;
+    HostLinkStats link;
+    HostDisplayStats display;
+} Step;
+
+static void step_begin(Step *step);
+static void step_run(Step *step, uint32_t until);
+static void step_report(const Step *step, const char *name);
+static bool run_command(char *line);
+static void wait_done(void *data);
+
+static char lines[MAX_LINES][LINE_SIZE];
+static int num_lines;
+static size_t heap_high_water;
+
+int main(int argc, char *argv[]) {
+    PhoneConfig phone = { .fetch_ms = 200, .window = 2 };
+    HostLinkConfig link = { .latency_ms = 40, .bytes_per_second = 4000 };
+    const char *state_path = NULL;
+    int option;
+    while ((option = getopt(argc, argv, "vm:l:b:f:w:s:")) != -1) {
+        switch (option) {
+            case 'v': host_set_log_level(APP_LOG_LEVEL_DEBUG_VERBOSE); break;
+            case 'm': host_heap_set_limit(atoi(optarg)); break;
+            case 'l': link.latency_ms = atoi(optarg); break;
+            case 'b': link.bytes_per_second = atoi(optarg); break;
+            case 'f': phone.fetch_ms = atoi(optarg); break;
+            case 'w': phone.window = atoi(optarg); break;
+            case 's': state_path = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-v] [-m heap] [-l latency] [-b bytes/s] [-f fetch] [-w window] [-s state] scenario.txt\n",
+                    argv[0]);
+                return 2;
+        }
+    }
+    if (optind != argc - 1) {
+        fprintf(stderr, "%s: no scenario given\n", argv[0]);
+        return 2;
+    }
+    FILE *scenario = fopen(argv[optind], "r");
+    if (scenario == NULL) {
+        perror(argv[optind]);
+        return 1;
+    }
+    while (num_lines < MAX_LINES && fgets(lines[num_lines], LINE_SIZE, scenario) != NULL) {
+        lines[num_lines][strcspn(lines[num_lines], "\r\n")] = '\0';
+        num_lines++;
+    }
+    fclose(scenario);
+
+    if (state_path != NULL) {
+        host_persist_load(state_path);
+    }
+    host_link_configure(&link);
+    phone_start(&phone);
+
+    printf("%-24s %7s %7s %6s %6s %6s %4s %5s %4s %6s %5s  %s\n", "step", "reply", "settled", "heap", "peak", "allocs",
+        "out", "bytes", "in", "bytes", "meas", "screen");
+
+    // init() is part of the launch step, app_event_loop() reports it
+    host_heap_reset_peak();
+    watch_main();
+
+    // whatever the app still holds once deinit() is done
+    host_app_message_close();
+    printf("\n");
+    size_t leaked = host_heap_report_leaks(stdout);
+    printf("ticks %u ms, heap high-water %u of %u bytes, %u allocations, %u failed, leaked %u bytes, persist %u bytes\n",
+        (unsigned)host_now(), (unsigned)heap_high_water, (unsigned)host_heap_stats()->limit,
+        (unsigned)host_heap_stats()->allocations, (unsigned)host_heap_stats()->failures, (unsigned)leaked,
+        (unsigned)host_persist_bytes());
+
+    if (state_path != NULL) {
+        host_persist_save(state_path);
+    }
+    return 0;
+}
+
+/*
+ * The app's event loop: settles the launch, then plays the scenario until
+ * it ends or the app leaves its last window
+ */
+void app_event_loop(void) {
+    Step step;
+    memset(&step, 0x0, sizeof(Step));
+    host_render();
+    step_run(&step, MAX_STEP_MS);
+    step_report(&step, "launch");
+
+    for (int i = 0; i < num_lines && host_has_windows(); i++) {
+        char *line = lines[i];
+        while (isspace((unsigned char)*line)) {
+            line++;
+        }
+        if (*line == '\0' || *line == '#') {
+            continue;
+        }
+        step_begin(&step);
+        if (!run_command(line)) {
+            fprintf(stderr, "line %d: cannot %s\n", i + 1, line);
+        }
+        step_run(&step, step.start + MAX_STEP_MS);
+        step_report(&step, line);
+    }
+}
+
+static bool run_command(char *line) {
+    char *argument = line + strcspn(line, " ");
+    if (*argument != '\0') {
+        *argument++ = '\0';
+    }
+    int count = *argument != '\0' ? atoi(argument) : 1;
+
+    bool done = true;
+    if (strcmp(line, "select") == 0) {
+        done = host_menu_select(argument, HostClickSingle);
+    } else if (strcmp(line, "long") == 0) {
+        done = host_menu_select(argument, HostClickLong);
+    } else if (strcmp(line, "up") == 0 || strcmp(line, "down") == 0) {
+        for (int i = 0; i < count && done; i++) {
+            done = host_click(line[0] == 'u' ? BUTTON_ID_UP : BUTTON_ID_DOWN, HostClickSingle);
+        }
+    } else if (strcmp(line, "click") == 0) {
+        done = host_click(BUTTON_ID_SELECT, HostClickSingle);
+    } else if (strcmp(line, "double") == 0) {
+        done = host_click(BUTTON_ID_SELECT, HostClickDouble);
+    } else if (strcmp(line, "hold") == 0) {
+        done = host_click(BUTTON_ID_SELECT, HostClickLong);
+    } else if (strcmp(line, "back") == 0) {
+        done = host_click(BUTTON_ID_BACK, HostClickSingle);
+    } else if (strcmp(line, "say") == 0) {
+        host_set_dictation(argument);
+    } else if (strcmp(line, "mute") == 0) {
+        phone_mute(count);
+    } else if (strcmp(line, "wait") == 0) {
+        host_schedule(atoi(argument), wait_done, NULL);
+    } else {
+        done = false;
+    }
+    if (*argument != '\0') {
+        argument[-1] = ' ';
+    }
+    return done;
+}
+
+static void wait_done(void *data) {
+}
+
+static void step_begin(Step *step) {
+    memset(step, 0x0, sizeof(Step));
+    step->start = host_now();
+    step->last_frame = step->start;
+    step->heap = *host_heap_stats();
+    step->link = *host_link_stats();
+    step->display = *host_display_stats();
+    host_heap_reset_peak();
+}
+
+/*
+ * Run events until nothing more is due soon, noting when the phone answers
+ * and when frames are drawn
+ */
+static void step_run(Step *step, uint32_t until) {
+    if (host_display_stats()->frames != step->display.frames) {
+        step->last_frame = host_now();
+    }
+    while (host_next_time() <= host_now() + SETTLE_MS && host_next_time() <= until) {
+        uint32_t frames = host_display_stats()->frames;
+        uint32_t messages_in = host_link_stats()->messages_in;
+        host_run_next();
+        if (!step->replied && host_link_stats()->messages_in != messages_in) {
+            step->first_reply = host_now();
+            step->replied = true;
+        }
+        if (host_display_stats()->frames != frames) {
+            step->last_frame = host_now();
+        }
+    }
+}
+
+static void step_report(const Step *step, const char *name) {
+    const HostHeapStats *heap = host_heap_stats();
+    const HostLinkStats *link = host_link_stats();
+    const HostDisplayStats *display = host_display_stats();
+    char screen[96];
+    host_describe_screen(screen, sizeof(screen));
+
+    heap_high_water = heap->peak > heap_high_water ? heap->peak : heap_high_water;
+    printf("%-24.24s %7u %7u %6u %6u %6u %4u %5u %4u %6u %5u  %s\n", name,
+        (unsigned)(step->replied ? step->first_reply - step->start : 0),
+        (unsigned)(step->last_frame - step->start),
+        (unsigned)heap->used, (unsigned)heap->peak, (unsigned)(heap->allocations - step->heap.allocations),
+        (unsigned)(link->messages_out - step->link.messages_out), (unsigned)(link->bytes_out - step->link.bytes_out),
+        (unsigned)(link->messages_in - step->link.messages_in), (unsigned)(link->bytes_in - step->link.bytes_in),
+        (unsigned)(display->texts_measured - step->display.texts_measured), screen);
+}
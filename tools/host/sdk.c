@@ -0,0 +1,1992 @@
+#include <pebble.h>
+#include <stdarg.h>
+#include "host.h"
+#include "phone.h"
+
+// The app's allocations are accounted on the simulated heap. The stub's own
+// bookkeeping, like the firmware's, lives outside of it.
+#undef malloc
+#undef calloc
+#undef realloc
+#undef free
+
+#define HEAP_MAGIC          0x48454150
+#define HEAP_HEADER_SIZE    ((sizeof(HeapBlock) + 15) & ~(size_t)15)
+#define MAX_LEAK_SITES      64
+#define MAX_WINDOWS         16
+#define MAX_PERSIST_KEYS    256
+#define DEFAULT_CELL_HEIGHT 44
+#define SCROLL_CLICK_JUMP   32
+#define DICTATION_MS        2000
+#define EPOCH_SECONDS       1700000000
+
+typedef struct HeapBlock {
+    uint32_t magic;
+    size_t size;
+    const char *file;
+    int line;
+    struct HeapBlock *previous;
+    struct HeapBlock *next;
+} HeapBlock;
+
+struct HostEvent {
+    uint32_t time;
+    uint32_t sequence;
+    HostEventCallback callback;
+    void *data;
+    HostEvent *next;
+};
+
+struct HostFont {
+    const char *key;
+    int16_t line_height;
+    int16_t advance;
+};
+
+struct GContext {
+    // set while a menu row is drawn only to read its text
+    char *capture;
+    size_t capture_size;
+};
+
+typedef enum {
+    LayerKindPlain,
+    LayerKindRoot,
+    LayerKindText,
+    LayerKindScroll,
+    LayerKindMenu,
+    LayerKindCell,
+} LayerKind;
+
+struct Layer {
+    GRect frame;
+    GRect bounds;
+    Layer *parent;
+    Layer *first_child;
+    Layer *next_sibling;
+    LayerUpdateProc update_proc;
+    LayerKind kind;
+    Window *window;
+    void *data;
+};
+
+struct Window {
+    Layer root;
+    WindowHandlers handlers;
+    bool loaded;
+    bool dirty;
+    ClickConfigProvider click_config_provider;
+    void *click_context;
+    ScrollLayer *click_scroll_layer;
+    MenuLayer *click_menu_layer;
+    ClickHandler single_click[NUM_BUTTONS];
+    ClickHandler multi_click[NUM_BUTTONS];
+    ClickHandler long_click[NUM_BUTTONS];
+};
+
+struct TextLayer {
+    Layer layer;
+    const char *text;
+    GFont font;
+    GTextAlignment alignment;
+    GTextOverflowMode overflow_mode;
+};
+
+struct ScrollLayer {
+    Layer layer;
+    Layer content;
+    ScrollLayerCallbacks callbacks;
+    void *context;
+};
+
+struct MenuLayer {
+    Layer layer;
+    MenuLayerCallbacks callbacks;
+    void *context;
+    MenuIndex selected;
+    int16_t scroll;
+};
+
+struct Dictionary {
+    uint8_t count;
+    uint8_t head[];
+} __attribute__((__packed__));
+
+typedef struct {
+    uint32_t key;
+    uint16_t size;
+    uint8_t data[PERSIST_DATA_MAX_LENGTH];
+} PersistValue;
+
+struct DictationSession {
+    DictationSessionStatusCallback callback;
+    void *context;
+    HostEvent *event;
+    uint32_t buffer_size;
+    char *transcription;
+};
+
+typedef struct {
+    uint8_t *bytes;
+    uint16_t size;
+} Packet;
+
+static void *heap_allocate(size_t size, const char *file, int line);
+static Window *layer_window(const Layer *layer);
+static void mark_dirty(const Layer *layer);
+static void detach_children(Layer *layer);
+static Window *top_window(void);
+static void remove_window_at(int position);
+static void configure_clicks(Window *window);
+static void render_layer(Layer *layer, GContext *ctx);
+static GSize measure_text(const char *text, GFont font, GRect box);
+static void menu_draw(MenuLayer *menu_layer, GContext *ctx);
+static void menu_draw_cell(MenuLayer *menu_layer, GContext *ctx, MenuIndex *index, bool header, GRect frame);
+static uint16_t menu_num_sections(MenuLayer *menu_layer);
+static uint16_t menu_num_rows(MenuLayer *menu_layer, uint16_t section);
+static int16_t menu_row_height(MenuLayer *menu_layer, MenuIndex *index);
+static int16_t menu_header_height(MenuLayer *menu_layer, uint16_t section);
+static void menu_clamp_selection(MenuLayer *menu_layer);
+static bool menu_row_text(MenuLayer *menu_layer, MenuIndex *index, char *text, size_t size);
+static MenuLayer *find_menu_layer(Layer *layer);
+static ScrollLayer *find_scroll_layer(Layer *layer);
+static GPoint scroll_clamp(ScrollLayer *scroll_layer, GPoint offset);
+static DictionaryResult dict_write_raw(DictionaryIterator *iter, uint32_t key, TupleType type, const void *data, uint16_t length);
+static void phone_arrival(void *data);
+static void outbox_acked(void *data);
+static void inbox_arrival(void *data);
+static uint32_t link_transmit_time(uint16_t size);
+static PersistValue *persist_find(uint32_t key);
+static void dictation_finished(void *data);
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// Heap
+
+static HeapBlock *heap_blocks;
+static HostHeapStats heap_stats = { .limit = HOST_HEAP_SIZE };
+
+void *host_malloc(size_t size, const char *file, int line) {
+    return heap_allocate(size, file, line);
+}
+
+void *host_calloc(size_t count, size_t size, const char *file, int line) {
+    if (size != 0 && count > SIZE_MAX / size) {
+        heap_stats.failures++;
+        return NULL;
+    }
+    void *ptr = heap_allocate(count * size, file, line);
+    if (ptr != NULL) {
+        memset(ptr, 0x0, count * size);
+    }
+    return ptr;
+}
+
+/*
+ * Like the firmware's heap, a new block is allocated and the old one freed,
+ * so the peak covers both
+ */
+void *host_realloc(void *ptr, size_t size, const char *file, int line) {
+    if (ptr == NULL) {
+        return heap_allocate(size, file, line);
+    }
+    if (size == 0) {
+        host_free(ptr);
+        return NULL;
+    }
+    HeapBlock *block = (HeapBlock *)((uint8_t *)ptr - HEAP_HEADER_SIZE);
+    void *grown = heap_allocate(size, file, line);
+    if (grown == NULL) {
+        return NULL;
+    }
+    memcpy(grown, ptr, block->size < size ? block->size : size);
+    heap_stats.bytes_copied += block->size < size ? block->size : size;
+    host_free(ptr);
+    return grown;
+}
+
+void host_free(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    HeapBlock *block = (HeapBlock *)((uint8_t *)ptr - HEAP_HEADER_SIZE);
+    if (block->magic != HEAP_MAGIC) {
+        fprintf(stderr, "free() of %p, which the app heap does not hold\n", ptr);
+        abort();
+    }
+    if (block->previous != NULL) {
+        block->previous->next = block->next;
+    } else {
+        heap_blocks = block->next;
+    }
+    if (block->next != NULL) {
+        block->next->previous = block->previous;
+    }
+    heap_stats.used -= block->size;
+    heap_stats.frees++;
+    // anything still reading it reads garbage
+    block->magic = 0;
+    memset(ptr, 0xdd, block->size);
+    free(block);
+}
+
+size_t heap_bytes_used(void) {
+    return heap_stats.used;
+}
+
+size_t heap_bytes_free(void) {
+    return heap_stats.limit - heap_stats.used;
+}
+
+const HostHeapStats *host_heap_stats(void) {
+    return &heap_stats;
+}
+
+void host_heap_set_limit(size_t limit) {
+    heap_stats.limit = limit;
+}
+
+void host_heap_reset_peak(void) {
+    heap_stats.peak = heap_stats.used;
+}
+
+/*
+ * Print the blocks still allocated, summed up by where they were allocated.
+ * Returns the number of bytes.
+ */
+size_t host_heap_report_leaks(FILE *out) {
+    struct {
+        const char *file;
+        int line;
+        uint32_t blocks;
+        size_t bytes;
+    } sites[MAX_LEAK_SITES];
+    int num_sites = 0;
+    size_t total = 0;
+
+    for (HeapBlock *block = heap_blocks; block != NULL; block = block->next) {
+        int site = 0;
+        while (site < num_sites && (sites[site].line != block->line || strcmp(sites[site].file, block->file) != 0)) {
+            site++;
+        }
+        if (site == num_sites && num_sites < MAX_LEAK_SITES) {
+            sites[num_sites].file = block->file;
+            sites[num_sites].line = block->line;
+            sites[num_sites].blocks = 0;
+            sites[num_sites].bytes = 0;
+            num_sites++;
+        }
+        if (site < num_sites) {
+            sites[site].blocks++;
+            sites[site].bytes += block->size;
+        }
+        total += block->size;
+    }
+
+    for (int i = 0; i < num_sites; i++) {
+        if (sites[i].line > 0) {
+            fprintf(out, "  %6d bytes in %3d blocks  %s:%d\n", (int)sites[i].bytes, (int)sites[i].blocks, sites[i].file, sites[i].line);
+        } else {
+            fprintf(out, "  %6d bytes in %3d blocks  %s()\n", (int)sites[i].bytes, (int)sites[i].blocks, sites[i].file);
+        }
+    }
+    return total;
+}
+
+static void *heap_allocate(size_t size, const char *file, int line) {
+    if (size > heap_stats.limit - heap_stats.used) {
+        heap_stats.failures++;
+        return NULL;
+    }
+    HeapBlock *block = malloc(HEAP_HEADER_SIZE + size);
+    if (block == NULL) {
+        heap_stats.failures++;
+        return NULL;
+    }
+    const char *slash = strrchr(file, '/');
+    block->magic = HEAP_MAGIC;
+    block->size = size;
+    block->file = slash != NULL ? slash + 1 : file;
+    block->line = line;
+    block->previous = NULL;
+    block->next = heap_blocks;
+    if (heap_blocks != NULL) {
+        heap_blocks->previous = block;
+    }
+    heap_blocks = block;
+
+    heap_stats.used += size;
+    heap_stats.allocations++;
+    if (heap_stats.used > heap_stats.peak) {
+        heap_stats.peak = heap_stats.used;
+    }
+    // nothing may count on fresh memory being zeroed
+    uint8_t *ptr = (uint8_t *)block + HEAP_HEADER_SIZE;
+    memset(ptr, 0xcd, size);
+    return ptr;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// Clock, events and timers
+
+static HostEvent *events;
+static uint32_t now;
+static uint32_t next_sequence;
+
+uint32_t host_now(void) {
+    return now;
+}
+
+HostEvent *host_schedule(uint32_t delay_ms, HostEventCallback callback, void *data) {
+    HostEvent *event = malloc(sizeof(HostEvent));
+    event->time = now + delay_ms;
+    event->sequence = next_sequence++;
+    event->callback = callback;
+    event->data = data;
+
+    // after every event due at the same time, they run in order
+    HostEvent **link = &events;
+    while (*link != NULL && (*link)->time <= event->time) {
+        link = &(*link)->next;
+    }
+    event->next = *link;
+    *link = event;
+    return event;
+}
+
+/*
+ * Returns false if the event already ran or was cancelled
+ */
+bool host_cancel(HostEvent *event) {
+    for (HostEvent **link = &events; *link != NULL; link = &(*link)->next) {
+        if (*link == event) {
+            *link = event->next;
+            free(event);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool host_idle(void) {
+    return events == NULL;
+}
+
+/*
+ * When the next event is due, UINT32_MAX if none is scheduled
+ */
+uint32_t host_next_time(void) {
+    return events != NULL ? events->time : UINT32_MAX;
+}
+
+/*
+ * Move the clock to the next event and run it, then draw whatever it
+ * changed on screen. Returns false if nothing is scheduled.
+ */
+bool host_run_next(void) {
+    HostEvent *event = events;
+    if (event == NULL) {
+        return false;
+    }
+    events = event->next;
+    now = event->time;
+    HostEventCallback callback = event->callback;
+    void *data = event->data;
+    free(event);
+    callback(data);
+    host_render();
+    return true;
+}
+
+uint16_t time_ms(time_t *t_utc, uint16_t *out_ms) {
+    if (t_utc != NULL) {
+        *t_utc = EPOCH_SECONDS + now / 1000;
+    }
+    if (out_ms != NULL) {
+        *out_ms = now % 1000;
+    }
+    return now % 1000;
+}
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data) {
+    return (AppTimer *)host_schedule(timeout_ms, callback, callback_data);
+}
+
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms) {
+    HostEvent *event = (HostEvent *)timer_handle;
+    for (HostEvent *scheduled = events; scheduled != NULL; scheduled = scheduled->next) {
+        if (scheduled == event) {
+            HostEventCallback callback = event->callback;
+            void *data = event->data;
+            host_cancel(event);
+            return host_schedule(new_timeout_ms, callback, data) != NULL;
+        }
+    }
+    return false;
+}
+
+void app_timer_cancel(AppTimer *timer_handle) {
+    host_cancel((HostEvent *)timer_handle);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// Logging, vibes, data logging
+
+static uint8_t log_level = APP_LOG_LEVEL_WARNING;
+static HostDisplayStats display_stats;
+
+void host_set_log_level(uint8_t level) {
+    log_level = level;
+}
+
+void app_log(uint8_t level, const char *src_filename, int src_line_number, const char *fmt, ...) {
+    if (level > log_level) {
+        return;
+    }
+    const char *slash = strrchr(src_filename, '/');
+    char tag = level <= APP_LOG_LEVEL_ERROR ? 'E' : level <= APP_LOG_LEVEL_WARNING ? 'W' : level <= APP_LOG_LEVEL_INFO ? 'I' : 'D';
+    fprintf(stderr, "[%c %7u] %s:%d ", tag, (unsigned)now, slash != NULL ? slash + 1 : src_filename, src_line_number);
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+void vibes_short_pulse(void) {
+    display_stats.vibes++;
+    APP_LOG(APP_LOG_LEVEL_INFO, "Vibe");
+}
+
+DataLoggingSessionRef data_logging_create(uint32_t tag, DataLoggingItemType item_type, uint16_t item_length, bool resume) {
+    static int session;
+    return (DataLoggingSessionRef)&session;
+}
+
+DataLoggingResult data_logging_log(DataLoggingSessionRef logging_session, const void *data, uint32_t num_items) {
+    return DATA_LOGGING_SUCCESS;
+}
+
+void data_logging_finish(DataLoggingSessionRef logging_session) {
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// Fonts and text
+
+// Rounded averages of the system fonts, close enough for layout maths
+static const struct HostFont fonts[] = {
+    { FONT_KEY_GOTHIC_14_BOLD, 16, 6 },
+    { FONT_KEY_GOTHIC_18, 22, 7 },
+    { FONT_KEY_GOTHIC_18_BOLD, 22, 8 },
+    { FONT_KEY_GOTHIC_24, 28, 10 },
+    { FONT_KEY_GOTHIC_24_BOLD, 28, 11 },
+};
+
+GFont fonts_get_system_font(const char *font_key) {
+    for (size_t i = 0; i < sizeof(fonts) / sizeof(fonts[0]); i++) {
+        if (strcmp(fonts[i].key, font_key) == 0) {
+            return &fonts[i];
+        }
+    }
+    APP_LOG(APP_LOG_LEVEL_WARNING, "No metrics for font %s", font_key);
+    return &fonts[0];
+}
+
+void graphics_context_set_text_color(GContext *ctx, GColor color) {
+}
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color) {
+}
+
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, int corner_mask) {
+}
+
+void graphics_draw_text(GContext *ctx, const char *text, GFont font, GRect box, GTextOverflowMode overflow_mode,
+        GTextAlignment alignment, GTextAttributes *text_attributes) {
+    if (ctx != NULL && ctx->capture != NULL) {
+        size_t length = strlen(ctx->capture);
+        snprintf(ctx->capture + length, ctx->capture_size - length, "%s%s", length > 0 ? " " : "", text);
+        return;
+    }
+    display_stats.texts_drawn++;
+}
+
+GSize graphics_text_layout_get_content_size(const char *text, GFont font, GRect box, GTextOverflowMode overflow_mode,
+        GTextAlignment alignment) {
+    display_stats.texts_measured++;
+    display_stats.bytes_measured += text != NULL ? strlen(text) : 0;
+    return measure_text(text, font, box);
+}
+
+const HostDisplayStats *host_display_stats(void) {
+    return &display_stats;
+}
+
+/*
+ * Word wrap with a fixed advance per character. Words longer than a line
+ * are broken, and only as many lines as fit the box are counted.
+ */
+static GSize measure_text(const char *text, GFont font, GRect box) {
+    if (text == NULL || *text == '\0' || font == NULL) {
+        return GSizeZero;
+    }
+    int columns = box.size.w / font->advance;
+    if (columns < 1) {
+        columns = 1;
+    }
+    int lines = 1;
+    int column = 0;
+    int widest = 0;
+    const char *cursor = text;
+    while (*cursor != '\0') {
+        if (*cursor == '\n') {
+            widest = column > widest ? column : widest;
+            lines++;
+            column = 0;
+            cursor++;
+            continue;
+        }
+        int spaces = 0;
+        while (*cursor == ' ') {
+            spaces++;
+            cursor++;
+        }
+        int letters = 0;
+        while (*cursor != '\0' && *cursor != ' ' && *cursor != '\n') {
+            if ((*cursor & 0xC0) != 0x80) {
+                letters++;
+            }
+            cursor++;
+        }
+        if (column > 0 && column + spaces + letters > columns) {
+            widest = column > widest ? column : widest;
+            lines++;
+            column = 0;
+            spaces = 0;
+        }
+        column += spaces;
+        while (column + letters > columns) {
+            letters -= columns - column;
+            widest = columns;
+            lines++;
+            column = 0;
+        }
+        column += letters;
+    }
+    widest = column > widest ? column : widest;
+
+    int max_lines = box.size.h / font->line_height;
+    if (lines > max_lines) {
+        lines = max_lines > 0 ? max_lines : 1;
+    }
+    int width = widest * font->advance;
+    return GSize(width < box.size.w ? width : box.size.w, lines * font->line_height);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// Layers
+
+static void init_layer(Layer *layer, GRect frame, LayerKind kind) {
+    memset(layer, 0x0, sizeof(Layer));
+    layer->frame = frame;
+    layer->bounds = GRect(0, 0, frame.size.w, frame.size.h);
+    layer->kind = kind;
+}
+
+Layer *layer_create(GRect frame) {
+    return layer_create_with_data(frame, 0);
+}
+
+Layer *layer_create_with_data(GRect frame, size_t data_size) {
+    Layer *layer = heap_allocate(sizeof(Layer) + data_size, "layer_create", 0);
+    if (layer == NULL) {
+        return NULL;
+    }
+    init_layer(layer, frame, LayerKindPlain);
+    layer->data = data_size > 0 ? layer + 1 : NULL;
+    return layer;
+}
+
+void layer_destroy(Layer *layer) {
+    if (layer == NULL) {
+        return;
+    }
+    layer_remove_from_parent(layer);
+    detach_children(layer);
+    host_free(layer);
+}
+
+void *layer_get_data(const Layer *layer) {
+    return layer->data;
+}
+
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc) {
+    layer->update_proc = update_proc;
+}
+
+void layer_mark_dirty(Layer *layer) {
+    mark_dirty(layer);
+}
+
+void layer_add_child(Layer *parent, Layer *child) {
+    if (parent == NULL || child == NULL) {
+        return;
+    }
+    layer_remove_from_parent(child);
+    Layer **link = &parent->first_child;
+    while (*link != NULL) {
+        link = &(*link)->next_sibling;
+    }
+    *link = child;
+    child->parent = parent;
+    mark_dirty(parent);
+}
+
+void layer_remove_from_parent(Layer *child) {
+    if (child == NULL || child->parent == NULL) {
+        return;
+    }
+    for (Layer **link = &child->parent->first_child; *link != NULL; link = &(*link)->next_sibling) {
+        if (*link == child) {
+            *link = child->next_sibling;
+            break;
+        }
+    }
+    mark_dirty(child->parent);
+    child->parent = NULL;
+    child->next_sibling = NULL;
+}
+
+GRect layer_get_frame(const Layer *layer) {
+    return layer != NULL ? layer->frame : GRectZero;
+}
+
+void layer_set_frame(Layer *layer, GRect frame) {
+    layer->frame = frame;
+    layer->bounds.size = frame.size;
+    mark_dirty(layer);
+}
+
+GRect layer_get_bounds(const Layer *layer) {
+    return layer != NULL ? layer->bounds : GRectZero;
+}
+
+void layer_set_bounds(Layer *layer, GRect bounds) {
+    layer->bounds = bounds;
+    mark_dirty(layer);
+}
+
+static Window *layer_window(const Layer *layer) {
+    while (layer != NULL && layer->parent != NULL) {
+        layer = layer->parent;
+    }
+    return layer != NULL && layer->kind == LayerKindRoot ? layer->window : NULL;
+}
+
+static void mark_dirty(const Layer *layer) {
+    Window *window = layer_window(layer);
+    if (window != NULL) {
+        window->dirty = true;
+    }
+}
+
+static void detach_children(Layer *layer) {
+    Layer *child = layer->first_child;
+    while (child != NULL) {
+        Layer *next = child->next_sibling;
+        child->parent = NULL;
+        child->next_sibling = NULL;
+        child = next;
+    }
+    layer->first_child = NULL;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// Windows, the window stack and clicks
+
+static Window *window_stack[MAX_WINDOWS];
+static int window_stack_depth;
+static Window *configuring_window;
+
+Window *window_create(void) {
+    Window *window = heap_allocate(sizeof(Window), "window_create", 0);
+    if (window == NULL) {
+        return NULL;
+    }
+    memset(window, 0x0, sizeof(Window));
+    init_layer(&window->root, GRect(0, 0, HOST_SCREEN_WIDTH, HOST_SCREEN_HEIGHT), LayerKindRoot);
+    window->root.window = window;
+    window->click_context = window;
+    return window;
+}
+
+void window_destroy(Window *window) {
+    if (window == NULL) {
+        return;
+    }
+    window_stack_remove(window, false);
+    detach_children(&window->root);
+    host_free(window);
+}
+
+void window_set_window_handlers(Window *window, WindowHandlers handlers) {
+    window->handlers = handlers;
+}
+
+Layer *window_get_root_layer(const Window *window) {
+    return window != NULL ? (Layer *)&window->root : NULL;
+}
+
+void window_set_click_config_provider(Window *window, ClickConfigProvider click_config_provider) {
+    window_set_click_config_provider_with_context(window, click_config_provider, window);
+}
+
+void window_set_click_config_provider_with_context(Window *window, ClickConfigProvider click_config_provider, void *context) {
+    window->click_config_provider = click_config_provider;
+    window->click_context = context;
+    window->click_scroll_layer = NULL;
+    window->click_menu_layer = NULL;
+    if (window == top_window()) {
+        configure_clicks(window);
+    }
+}
+
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler) {
+    if (configuring_window != NULL) {
+        configuring_window->single_click[button_id] = handler;
+    }
+}
+
+void window_multi_click_subscribe(ButtonId button_id, uint8_t min_clicks, uint8_t max_clicks, uint16_t timeout,
+        bool last_click_only, ClickHandler handler) {
+    if (configuring_window != NULL) {
+        configuring_window->multi_click[button_id] = handler;
+    }
+}
+
+void window_long_click_subscribe(ButtonId button_id, uint16_t delay_ms, ClickHandler down_handler, ClickHandler up_handler) {
+    if (configuring_window != NULL) {
+        configuring_window->long_click[button_id] = down_handler != NULL ? down_handler : up_handler;
+    }
+}
+
+void window_stack_push(Window *window, bool animated) {
+    if (window_stack_depth == MAX_WINDOWS) {
+        APP_LOG(APP_LOG_LEVEL_ERROR, "Window stack full");
+        return;
+    }
+    Window *previous = top_window();
+    if (previous != NULL && previous->handlers.disappear != NULL) {
+        previous->handlers.disappear(previous);
+    }
+    window_stack[window_stack_depth++] = window;
+    if (!window->loaded) {
+        window->loaded = true;
+        if (window->handlers.load != NULL) {
+            window->handlers.load(window);
+        }
+    }
+    if (window->handlers.appear != NULL) {
+        window->handlers.appear(window);
+    }
+    configure_clicks(window);
+    window->dirty = true;
+}
+
+Window *window_stack_pop(bool animated) {
+    Window *window = top_window();
+    if (window != NULL) {
+        remove_window_at(window_stack_depth - 1);
+    }
+    return window;
+}
+
+bool window_stack_remove(Window *window, bool animated) {
+    for (int position = 0; position < window_stack_depth; position++) {
+        if (window_stack[position] == window) {
+            remove_window_at(position);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool window_stack_contains_window(Window *window) {
+    for (int position = 0; position < window_stack_depth; position++) {
+        if (window_stack[position] == window) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Window *window_stack_get_top_window(void) {
+    return top_window();
+}
+
+bool host_has_windows(void) {
+    return window_stack_depth > 0;
+}
+
+/*
+ * Press a button on the top window. A long press without a long click
+ * handler counts as a single click, and so does each of a double click
+ * without a multi click handler. Back leaves the window unless handled.
+ */
+bool host_click(ButtonId button, HostClick click) {
+    Window *window = top_window();
+    if (window == NULL) {
+        return false;
+    }
+    ClickHandler handler = window->single_click[button];
+    if (click == HostClickLong && window->long_click[button] != NULL) {
+        handler = window->long_click[button];
+    } else if (click == HostClickDouble && window->multi_click[button] != NULL) {
+        handler = window->multi_click[button];
+        click = HostClickSingle;
+    }
+
+    int presses = click == HostClickDouble ? 2 : 1;
+    for (int i = 0; i < presses; i++) {
+        if (handler != NULL) {
+            handler(NULL, window->click_context);
+        } else if (button == BUTTON_ID_BACK) {
+            window_stack_pop(true);
+        }
+    }
+    host_render();
+    return true;
+}
+
+static Window *top_window(void) {
+    return window_stack_depth > 0 ? window_stack[window_stack_depth - 1] : NULL;
+}
+
+static void remove_window_at(int position) {
+    Window *window = window_stack[position];
+    bool was_top = position == window_stack_depth - 1;
+    if (was_top && window->handlers.disappear != NULL) {
+        window->handlers.disappear(window);
+    }
+    memmove(&window_stack[position], &window_stack[position + 1], (window_stack_depth - position - 1) * sizeof(Window *));
+    window_stack_depth--;
+    if (window->loaded) {
+        window->loaded = false;
+        if (window->handlers.unload != NULL) {
+            window->handlers.unload(window);
+        }
+    }
+    Window *top = top_window();
+    if (was_top && top != NULL) {
+        if (top->handlers.appear != NULL) {
+            top->handlers.appear(top);
+        }
+        configure_clicks(top);
+        top->dirty = true;
+    }
+}
+
+static void configure_clicks(Window *window) {
+    memset(window->single_click, 0x0, sizeof(window->single_click));
+    memset(window->multi_click, 0x0, sizeof(window->multi_click));
+    memset(window->long_click, 0x0, sizeof(window->long_click));
+    if (window->click_config_provider != NULL) {
+        configuring_window = window;
+        window->click_config_provider(window->click_context);
+        configuring_window = NULL;
+    }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// Drawing and describing the screen
+
+static char dictation_transcription[256];
+
+void host_render(void) {
+    Window *window = top_window();
+    if (window == NULL || !window->dirty) {
+        return;
+    }
+    window->dirty = false;
+    display_stats.frames++;
+    GContext ctx = { .capture = NULL };
+    render_layer(&window->root, &ctx);
+}
+
+/*
+ * What the top window shows: the header and selected row of a menu, or
+ * the position of a scroll layer
+ */
+void host_describe_screen(char *description, size_t size) {
+    Window *window = top_window();
+    MenuLayer *menu_layer = window != NULL ? find_menu_layer(&window->root) : NULL;
+    ScrollLayer *scroll_layer = window != NULL ? find_scroll_layer(&window->root) : NULL;
+    if (window == NULL) {
+        snprintf(description, size, "(no window)");
+    } else if (menu_layer != NULL) {
+        char header[64] = "";
+        char row[64] = "";
+        if (menu_layer->callbacks.draw_header != NULL && menu_num_sections(menu_layer) > 0) {
+            GContext ctx = { .capture = header, .capture_size = sizeof(header) };
+            menu_layer->callbacks.draw_header(&ctx, NULL, menu_layer->selected.section, menu_layer->context);
+        }
+        menu_row_text(menu_layer, &menu_layer->selected, row, sizeof(row));
+        snprintf(description, size, "%s > %s", header, row);
+    } else if (scroll_layer != NULL) {
+        snprintf(description, size, "scrolled %d of %d px", -scroll_layer->content.frame.origin.y,
+            scroll_layer->content.frame.size.h);
+    } else {
+        snprintf(description, size, "(window)");
+    }
+}
+
+/*
+ * Select a row of the menu on the top window by what it shows, the first
+ * row starting with label if none shows exactly that, or by number as
+ * "#<row>" counted across sections
+ */
+bool host_menu_select(const char *label, HostClick click) {
+    Window *window = top_window();
+    MenuLayer *menu_layer = window != NULL ? find_menu_layer(&window->root) : NULL;
+    if (menu_layer == NULL) {
+        return false;
+    }
+    int wanted = label[0] == '#' ? atoi(label + 1) : -1;
+    MenuIndex match = { 0, 0 };
+    bool found = false;
+    // whole labels first, then the start of one
+    for (int pass = 0; pass < 2 && !found; pass++) {
+        int count = 0;
+        for (uint16_t section = 0; section < menu_num_sections(menu_layer) && !found; section++) {
+            for (uint16_t row = 0; row < menu_num_rows(menu_layer, section) && !found; row++, count++) {
+                MenuIndex index = { section, row };
+                char text[128];
+                menu_row_text(menu_layer, &index, text, sizeof(text));
+                if (wanted >= 0) {
+                    found = count == wanted;
+                } else if (pass == 0) {
+                    found = strcmp(text, label) == 0;
+                } else {
+                    found = strncmp(text, label, strlen(label)) == 0;
+                }
+                match = index;
+            }
+        }
+    }
+    if (!found) {
+        return false;
+    }
+
+    menu_layer->selected = match;
+    mark_dirty(&menu_layer->layer);
+    host_render();
+    if (click == HostClickLong && menu_layer->callbacks.select_long_click != NULL) {
+        menu_layer->callbacks.select_long_click(menu_layer, &match, menu_layer->context);
+    } else if (menu_layer->callbacks.select_click != NULL) {
+        menu_layer->callbacks.select_click(menu_layer, &match, menu_layer->context);
+    }
+    host_render();
+    return true;
+}
+
+static void render_layer(Layer *layer, GContext *ctx) {
+    if (layer->kind == LayerKindText) {
+        TextLayer *text_layer = (TextLayer *)layer;
+        if (text_layer->text != NULL) {
+            graphics_draw_text(ctx, text_layer->text, text_layer->font, layer->bounds, text_layer->overflow_mode,
+                text_layer->alignment, NULL);
+        }
+    } else if (layer->kind == LayerKindMenu) {
+        menu_draw((MenuLayer *)layer, ctx);
+    }
+    if (layer->update_proc != NULL) {
+        layer->update_proc(layer, ctx);
+    }
+    for (Layer *child = layer->first_child; child != NULL; child = child->next_sibling) {
+        render_layer(child, ctx);
+    }
+}
+
+static MenuLayer *find_menu_layer(Layer *layer) {
+    if (layer->kind == LayerKindMenu) {
+        return (MenuLayer *)layer;
+    }
+    for (Layer *child = layer->first_child; child != NULL; child = child->next_sibling) {
+        MenuLayer *menu_layer = find_menu_layer(child);
+        if (menu_layer != NULL) {
+            return menu_layer;
+        }
+    }
+    return NULL;
+}
+
+static ScrollLayer *find_scroll_layer(Layer *layer) {
+    if (layer->kind == LayerKindScroll) {
+        return (ScrollLayer *)layer;
+    }
+    for (Layer *child = layer->first_child; child != NULL; child = child->next_sibling) {
+        ScrollLayer *scroll_layer = find_scroll_layer(child);
+        if (scroll_layer != NULL) {
+            return scroll_layer;
+        }
+    }
+    return NULL;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// TextLayer
+
+TextLayer *text_layer_create(GRect frame) {
+    TextLayer *text_layer = heap_allocate(sizeof(TextLayer), "text_layer_create", 0);
+    if (text_layer == NULL) {
+        return NULL;
+    }
+    init_layer(&text_layer->layer, frame, LayerKindText);
+    text_layer->text = NULL;
+    text_layer->font = fonts_get_system_font(FONT_KEY_GOTHIC_14_BOLD);
+    text_layer->alignment = GTextAlignmentLeft;
+    text_layer->overflow_mode = GTextOverflowModeWordWrap;
+    return text_layer;
+}
+
+void text_layer_destroy(TextLayer *text_layer) {
+    if (text_layer == NULL) {
+        return;
+    }
+    layer_remove_from_parent(&text_layer->layer);
+    detach_children(&text_layer->layer);
+    host_free(text_layer);
+}
+
+Layer *text_layer_get_layer(TextLayer *text_layer) {
+    return text_layer != NULL ? &text_layer->layer : NULL;
+}
+
+void text_layer_set_text(TextLayer *text_layer, const char *text) {
+    text_layer->text = text;
+    mark_dirty(&text_layer->layer);
+}
+
+void text_layer_set_font(TextLayer *text_layer, GFont font) {
+    text_layer->font = font;
+    mark_dirty(&text_layer->layer);
+}
+
+void text_layer_set_size(TextLayer *text_layer, const GSize max_size) {
+    text_layer->layer.frame.size = max_size;
+    text_layer->layer.bounds.size = max_size;
+    mark_dirty(&text_layer->layer);
+}
+
+GSize text_layer_get_content_size(TextLayer *text_layer) {
+    return graphics_text_layout_get_content_size(text_layer->text, text_layer->font, text_layer->layer.bounds,
+        text_layer->overflow_mode, text_layer->alignment);
+}
+
+void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment text_alignment) {
+    text_layer->alignment = text_alignment;
+}
+
+void text_layer_set_overflow_mode(TextLayer *text_layer, GTextOverflowMode line_mode) {
+    text_layer->overflow_mode = line_mode;
+}
+
+void text_layer_set_text_color(TextLayer *text_layer, GColor color) {
+}
+
+void text_layer_set_background_color(TextLayer *text_layer, GColor color) {
+}
+
+void text_layer_enable_screen_text_flow_and_paging(TextLayer *text_layer, uint8_t inset) {
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// ScrollLayer
+
+static void scroll_click_up(ClickRecognizerRef recognizer, void *context);
+static void scroll_click_down(ClickRecognizerRef recognizer, void *context);
+static void scroll_click_config(void *context);
+
+ScrollLayer *scroll_layer_create(GRect frame) {
+    ScrollLayer *scroll_layer = heap_allocate(sizeof(ScrollLayer), "scroll_layer_create", 0);
+    if (scroll_layer == NULL) {
+        return NULL;
+    }
+    init_layer(&scroll_layer->layer, frame, LayerKindScroll);
+    init_layer(&scroll_layer->content, GRect(0, 0, frame.size.w, frame.size.h), LayerKindPlain);
+    layer_add_child(&scroll_layer->layer, &scroll_layer->content);
+    memset(&scroll_layer->callbacks, 0x0, sizeof(ScrollLayerCallbacks));
+    scroll_layer->context = scroll_layer;
+    return scroll_layer;
+}
+
+void scroll_layer_destroy(ScrollLayer *scroll_layer) {
+    if (scroll_layer == NULL) {
+        return;
+    }
+    layer_remove_from_parent(&scroll_layer->layer);
+    detach_children(&scroll_layer->content);
+    host_free(scroll_layer);
+}
+
+Layer *scroll_layer_get_layer(const ScrollLayer *scroll_layer) {
+    return scroll_layer != NULL ? (Layer *)&scroll_layer->layer : NULL;
+}
+
+void scroll_layer_add_child(ScrollLayer *scroll_layer, Layer *child) {
+    layer_add_child(&scroll_layer->content, child);
+}
+
+void scroll_layer_set_click_config_onto_window(ScrollLayer *scroll_layer, Window *window) {
+    window_set_click_config_provider_with_context(window, scroll_click_config, scroll_layer->context);
+    window->click_scroll_layer = scroll_layer;
+}
+
+void scroll_layer_set_callbacks(ScrollLayer *scroll_layer, ScrollLayerCallbacks callbacks) {
+    scroll_layer->callbacks = callbacks;
+}
+
+void scroll_layer_set_context(ScrollLayer *scroll_layer, void *context) {
+    scroll_layer->context = context;
+}
+
+void scroll_layer_set_content_offset(ScrollLayer *scroll_layer, GPoint offset, bool animated) {
+    offset = scroll_clamp(scroll_layer, offset);
+    GPoint current = scroll_layer->content.frame.origin;
+    if (offset.x == current.x && offset.y == current.y) {
+        return;
+    }
+    scroll_layer->content.frame.origin = offset;
+    mark_dirty(&scroll_layer->layer);
+    if (scroll_layer->callbacks.content_offset_changed_handler != NULL) {
+        scroll_layer->callbacks.content_offset_changed_handler(scroll_layer, scroll_layer->context);
+    }
+}
+
+GPoint scroll_layer_get_content_offset(ScrollLayer *scroll_layer) {
+    return scroll_layer->content.frame.origin;
+}
+
+/*
+ * A smaller content size pulls the offset back in, which is reported like
+ * any other change of the offset
+ */
+void scroll_layer_set_content_size(ScrollLayer *scroll_layer, GSize size) {
+    scroll_layer->content.frame.size = size;
+    scroll_layer->content.bounds.size = size;
+    mark_dirty(&scroll_layer->layer);
+    GPoint offset = scroll_layer->content.frame.origin;
+    GPoint clamped = scroll_clamp(scroll_layer, offset);
+    if (clamped.x != offset.x || clamped.y != offset.y) {
+        scroll_layer->content.frame.origin = offset;
+        scroll_layer_set_content_offset(scroll_layer, clamped, false);
+    }
+}
+
+GSize scroll_layer_get_content_size(const ScrollLayer *scroll_layer) {
+    return scroll_layer->content.frame.size;
+}
+
+void scroll_layer_set_paging(ScrollLayer *scroll_layer, bool paging_enabled) {
+}
+
+static GPoint scroll_clamp(ScrollLayer *scroll_layer, GPoint offset) {
+    int16_t min_x = scroll_layer->layer.frame.size.w - scroll_layer->content.frame.size.w;
+    int16_t min_y = scroll_layer->layer.frame.size.h - scroll_layer->content.frame.size.h;
+    min_x = min_x < 0 ? min_x : 0;
+    min_y = min_y < 0 ? min_y : 0;
+    offset.x = offset.x > 0 ? 0 : offset.x < min_x ? min_x : offset.x;
+    offset.y = offset.y > 0 ? 0 : offset.y < min_y ? min_y : offset.y;
+    return offset;
+}
+
+/*
+ * Up and down scroll, then the app's own click config provider may take
+ * over any button
+ */
+static void scroll_click_config(void *context) {
+    Window *window = configuring_window;
+    ScrollLayer *scroll_layer = window->click_scroll_layer;
+    window_single_click_subscribe(BUTTON_ID_UP, scroll_click_up);
+    window_single_click_subscribe(BUTTON_ID_DOWN, scroll_click_down);
+    if (scroll_layer != NULL && scroll_layer->callbacks.click_config_provider != NULL) {
+        scroll_layer->callbacks.click_config_provider(scroll_layer->context);
+    }
+}
+
+static void scroll_click_by(int16_t amount) {
+    ScrollLayer *scroll_layer = top_window()->click_scroll_layer;
+    GPoint offset = scroll_layer->content.frame.origin;
+    offset.y += amount;
+    scroll_layer_set_content_offset(scroll_layer, offset, true);
+}
+
+static void scroll_click_up(ClickRecognizerRef recognizer, void *context) {
+    scroll_click_by(SCROLL_CLICK_JUMP);
+}
+
+static void scroll_click_down(ClickRecognizerRef recognizer, void *context) {
+    scroll_click_by(-SCROLL_CLICK_JUMP);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// MenuLayer
+
+static void menu_click_up(ClickRecognizerRef recognizer, void *context);
+static void menu_click_down(ClickRecognizerRef recognizer, void *context);
+static void menu_click_select(ClickRecognizerRef recognizer, void *context);
+static void menu_click_select_long(ClickRecognizerRef recognizer, void *context);
+static void menu_click_config(void *context);
+
+static Layer cell_layer;
+static bool cell_highlighted;
+
+MenuLayer *menu_layer_create(GRect frame) {
+    MenuLayer *menu_layer = heap_allocate(sizeof(MenuLayer), "menu_layer_create", 0);
+    if (menu_layer == NULL) {
+        return NULL;
+    }
+    memset(menu_layer, 0x0, sizeof(MenuLayer));
+    init_layer(&menu_layer->layer, frame, LayerKindMenu);
+    return menu_layer;
+}
+
+void menu_layer_destroy(MenuLayer *menu_layer) {
+    if (menu_layer == NULL) {
+        return;
+    }
+    layer_remove_from_parent(&menu_layer->layer);
+    detach_children(&menu_layer->layer);
+    host_free(menu_layer);
+}
+
+Layer *menu_layer_get_layer(const MenuLayer *menu_layer) {
+    return menu_layer != NULL ? (Layer *)&menu_layer->layer : NULL;
+}
+
+void menu_layer_set_callbacks(MenuLayer *menu_layer, void *callback_context, MenuLayerCallbacks callbacks) {
+    menu_layer->callbacks = callbacks;
+    menu_layer->context = callback_context;
+    mark_dirty(&menu_layer->layer);
+}
+
+void menu_layer_set_click_config_onto_window(MenuLayer *menu_layer, Window *window) {
+    window_set_click_config_provider_with_context(window, menu_click_config, menu_layer);
+    window->click_menu_layer = menu_layer;
+}
+
+void menu_layer_reload_data(MenuLayer *menu_layer) {
+    menu_clamp_selection(menu_layer);
+    mark_dirty(&menu_layer->layer);
+}
+
+void menu_layer_set_selected_index(MenuLayer *menu_layer, MenuIndex index, MenuRowAlign scroll_align, bool animated) {
+    menu_layer->selected = index;
+    menu_clamp_selection(menu_layer);
+    mark_dirty(&menu_layer->layer);
+}
+
+MenuIndex menu_layer_get_selected_index(const MenuLayer *menu_layer) {
+    return menu_layer->selected;
+}
+
+bool menu_cell_layer_is_highlighted(const Layer *layer) {
+    return layer == &cell_layer && cell_highlighted;
+}
+
+void menu_cell_basic_draw(GContext *ctx, const Layer *cell_layer, const char *title, const char *subtitle, void *icon) {
+    if (title != NULL) {
+        graphics_draw_text(ctx, title, fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD), layer_get_bounds(cell_layer),
+            GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+    }
+    if (subtitle != NULL) {
+        graphics_draw_text(ctx, subtitle, fonts_get_system_font(FONT_KEY_GOTHIC_18), layer_get_bounds(cell_layer),
+            GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+    }
+}
+
+void menu_cell_title_draw(GContext *ctx, const Layer *cell_layer, const char *title) {
+    menu_cell_basic_draw(ctx, cell_layer, title, NULL, NULL);
+}
+
+void menu_cell_basic_header_draw(GContext *ctx, const Layer *cell_layer, const char *title) {
+    graphics_draw_text(ctx, title, fonts_get_system_font(FONT_KEY_GOTHIC_14_BOLD), layer_get_bounds(cell_layer),
+        GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+}
+
+/*
+ * Scroll just far enough to show the selected row, then draw the headers
+ * and rows on screen
+ */
+static void menu_draw(MenuLayer *menu_layer, GContext *ctx) {
+    int16_t height = menu_layer->layer.frame.size.h;
+    int16_t y = 0;
+    int16_t selected_top = 0;
+    int16_t selected_bottom = 0;
+    uint16_t num_sections = menu_num_sections(menu_layer);
+    for (uint16_t section = 0; section < num_sections; section++) {
+        y += menu_header_height(menu_layer, section);
+        for (uint16_t row = 0; row < menu_num_rows(menu_layer, section); row++) {
+            MenuIndex index = { section, row };
+            int16_t row_height = menu_row_height(menu_layer, &index);
+            if (section == menu_layer->selected.section && row == menu_layer->selected.row) {
+                selected_top = y;
+                selected_bottom = y + row_height;
+            }
+            y += row_height;
+        }
+    }
+    if (selected_bottom > menu_layer->scroll + height) {
+        menu_layer->scroll = selected_bottom - height;
+    }
+    if (selected_top < menu_layer->scroll) {
+        menu_layer->scroll = selected_top;
+    }
+
+    y = -menu_layer->scroll;
+    for (uint16_t section = 0; section < num_sections && y < height; section++) {
+        MenuIndex header = { section, 0 };
+        int16_t header_height = menu_header_height(menu_layer, section);
+        if (header_height > 0 && y + header_height > 0) {
+            menu_draw_cell(menu_layer, ctx, &header, true, GRect(0, y, menu_layer->layer.frame.size.w, header_height));
+        }
+        y += header_height;
+        for (uint16_t row = 0; row < menu_num_rows(menu_layer, section) && y < height; row++) {
+            MenuIndex index = { section, row };
+            int16_t row_height = menu_row_height(menu_layer, &index);
+            if (y + row_height > 0) {
+                menu_draw_cell(menu_layer, ctx, &index, false, GRect(0, y, menu_layer->layer.frame.size.w, row_height));
+            }
+            y += row_height;
+        }
+    }
+}
+
+static void menu_draw_cell(MenuLayer *menu_layer, GContext *ctx, MenuIndex *index, bool header, GRect frame) {
+    init_layer(&cell_layer, frame, LayerKindCell);
+    cell_highlighted = !header && index->section == menu_layer->selected.section && index->row == menu_layer->selected.row;
+    if (header && menu_layer->callbacks.draw_header != NULL) {
+        menu_layer->callbacks.draw_header(ctx, &cell_layer, index->section, menu_layer->context);
+    } else if (!header && menu_layer->callbacks.draw_row != NULL) {
+        menu_layer->callbacks.draw_row(ctx, &cell_layer, index, menu_layer->context);
+    }
+}
+
+static uint16_t menu_num_sections(MenuLayer *menu_layer) {
+    if (menu_layer->callbacks.get_num_sections == NULL) {
+        return 1;
+    }
+    return menu_layer->callbacks.get_num_sections(menu_layer, menu_layer->context);
+}
+
+static uint16_t menu_num_rows(MenuLayer *menu_layer, uint16_t section) {
+    if (menu_layer->callbacks.get_num_rows == NULL) {
+        return 0;
+    }
+    return menu_layer->callbacks.get_num_rows(menu_layer, section, menu_layer->context);
+}
+
+static int16_t menu_row_height(MenuLayer *menu_layer, MenuIndex *index) {
+    if (menu_layer->callbacks.get_cell_height == NULL) {
+        return DEFAULT_CELL_HEIGHT;
+    }
+    return menu_layer->callbacks.get_cell_height(menu_layer, index, menu_layer->context);
+}
+
+static int16_t menu_header_height(MenuLayer *menu_layer, uint16_t section) {
+    if (menu_layer->callbacks.get_header_height == NULL) {
+        return 0;
+    }
+    return menu_layer->callbacks.get_header_height(menu_layer, section, menu_layer->context);
+}
+
+static void menu_clamp_selection(MenuLayer *menu_layer) {
+    uint16_t num_sections = menu_num_sections(menu_layer);
+    if (menu_layer->selected.section >= num_sections) {
+        menu_layer->selected.section = num_sections > 0 ? num_sections - 1 : 0;
+        menu_layer->selected.row = UINT16_MAX;
+    }
+    uint16_t num_rows = num_sections > 0 ? menu_num_rows(menu_layer, menu_layer->selected.section) : 0;
+    if (menu_layer->selected.row >= num_rows) {
+        menu_layer->selected.row = num_rows > 0 ? num_rows - 1 : 0;
+    }
+}
+
+/*
+ * Draw a row into a context that only collects the text
+ */
+static bool menu_row_text(MenuLayer *menu_layer, MenuIndex *index, char *text, size_t size) {
+    text[0] = '\0';
+    if (menu_layer->callbacks.draw_row == NULL) {
+        return false;
+    }
+    GContext ctx = { .capture = text, .capture_size = size };
+    menu_draw_cell(menu_layer, &ctx, index, false, GRect(0, 0, menu_layer->layer.frame.size.w, menu_row_height(menu_layer, index)));
+    return true;
+}
+
+static void menu_click_config(void *context) {
+    window_single_click_subscribe(BUTTON_ID_UP, menu_click_up);
+    window_single_click_subscribe(BUTTON_ID_DOWN, menu_click_down);
+    window_single_click_subscribe(BUTTON_ID_SELECT, menu_click_select);
+    window_long_click_subscribe(BUTTON_ID_SELECT, 0, menu_click_select_long, NULL);
+}
+
+static void menu_click_up(ClickRecognizerRef recognizer, void *context) {
+    MenuLayer *menu_layer = context;
+    if (menu_layer->selected.row > 0) {
+        menu_layer->selected.row--;
+    } else if (menu_layer->selected.section > 0) {
+        menu_layer->selected.section--;
+        menu_layer->selected.row = UINT16_MAX;
+        menu_clamp_selection(menu_layer);
+    }
+    mark_dirty(&menu_layer->layer);
+}
+
+static void menu_click_down(ClickRecognizerRef recognizer, void *context) {
+    MenuLayer *menu_layer = context;
+    if (menu_layer->selected.row + 1 < menu_num_rows(menu_layer, menu_layer->selected.section)) {
+        menu_layer->selected.row++;
+    } else if (menu_layer->selected.section + 1 < menu_num_sections(menu_layer)) {
+        menu_layer->selected.section++;
+        menu_layer->selected.row = 0;
+    }
+    mark_dirty(&menu_layer->layer);
+}
+
+static void menu_click_select(ClickRecognizerRef recognizer, void *context) {
+    MenuLayer *menu_layer = context;
+    if (menu_layer->callbacks.select_click != NULL) {
+        menu_layer->callbacks.select_click(menu_layer, &menu_layer->selected, menu_layer->context);
+    }
+}
+
+static void menu_click_select_long(ClickRecognizerRef recognizer, void *context) {
+    MenuLayer *menu_layer = context;
+    if (menu_layer->callbacks.select_long_click != NULL) {
+        menu_layer->callbacks.select_long_click(menu_layer, &menu_layer->selected, menu_layer->context);
+    } else {
+        menu_click_select(recognizer, context);
+    }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// Dictionaries
+
+uint32_t dict_calc_buffer_size(const uint8_t tuple_count, ...) {
+    uint32_t size = sizeof(struct Dictionary);
+    va_list args;
+    va_start(args, tuple_count);
+    for (int i = 0; i < tuple_count; i++) {
+        size += sizeof(Tuple) + va_arg(args, uint32_t);
+    }
+    va_end(args);
+    return size;
+}
+
+DictionaryResult dict_write_begin(DictionaryIterator *iter, uint8_t *buffer, const uint16_t size) {
+    if (iter == NULL || buffer == NULL || size < sizeof(struct Dictionary)) {
+        return DICT_INVALID_ARGS;
+    }
+    iter->dictionary = (struct Dictionary *)buffer;
+    iter->dictionary->count = 0;
+    iter->cursor = (Tuple *)iter->dictionary->head;
+    iter->end = buffer + size;
+    return DICT_OK;
+}
+
+DictionaryResult dict_write_tuplet(DictionaryIterator *iter, const Tuplet *tuplet) {
+    switch (tuplet->type) {
+        case TUPLE_BYTE_ARRAY:
+            return dict_write_raw(iter, tuplet->key, TUPLE_BYTE_ARRAY, tuplet->bytes.data, tuplet->bytes.length);
+        case TUPLE_CSTRING:
+            return dict_write_raw(iter, tuplet->key, TUPLE_CSTRING, tuplet->cstring.data, tuplet->cstring.length);
+        default:
+            return dict_write_raw(iter, tuplet->key, tuplet->type, &tuplet->integer.storage, tuplet->integer.width);
+    }
+}
+
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t *data, const uint16_t size) {
+    return dict_write_raw(iter, key, TUPLE_BYTE_ARRAY, data, size);
+}
+
+DictionaryResult dict_write_cstring(DictionaryIterator *iter, const uint32_t key, const char *cstring) {
+    return dict_write_raw(iter, key, TUPLE_CSTRING, cstring, cstring != NULL ? strlen(cstring) + 1 : 0);
+}
+
+DictionaryResult dict_write_int(DictionaryIterator *iter, const uint32_t key, const void *integer, const uint8_t width_bytes,
+        const bool is_signed) {
+    if (width_bytes != 1 && width_bytes != 2 && width_bytes != 4) {
+        return DICT_INVALID_ARGS;
+    }
+    return dict_write_raw(iter, key, is_signed ? TUPLE_INT : TUPLE_UINT, integer, width_bytes);
+}
+
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value) {
+    return dict_write_int(iter, key, &value, sizeof(value), false);
+}
+
+DictionaryResult dict_write_uint16(DictionaryIterator *iter, const uint32_t key, const uint16_t value) {
+    return dict_write_int(iter, key, &value, sizeof(value), false);
+}
+
+DictionaryResult dict_write_uint32(DictionaryIterator *iter, const uint32_t key, const uint32_t value) {
+    return dict_write_int(iter, key, &value, sizeof(value), false);
+}
+
+DictionaryResult dict_write_int32(DictionaryIterator *iter, const uint32_t key, const int32_t value) {
+    return dict_write_int(iter, key, &value, sizeof(value), true);
+}
+
+uint32_t dict_write_end(DictionaryIterator *iter) {
+    if (iter == NULL || iter->dictionary == NULL) {
+        return 0;
+    }
+    return (uint8_t *)iter->cursor - (uint8_t *)iter->dictionary;
+}
+
+Tuple *dict_read_begin_from_buffer(DictionaryIterator *iter, const uint8_t *buffer, const uint16_t size) {
+    if (iter == NULL || buffer == NULL || size < sizeof(struct Dictionary)) {
+        return NULL;
+    }
+    iter->dictionary = (struct Dictionary *)buffer;
+    iter->end = buffer + size;
+    return dict_read_first(iter);
+}
+
+Tuple *dict_read_first(DictionaryIterator *iter) {
+    iter->cursor = (Tuple *)iter->dictionary->head;
+    if (iter->dictionary->count == 0 || (uint8_t *)iter->cursor + sizeof(Tuple) > (uint8_t *)iter->end) {
+        return NULL;
+    }
+    return iter->cursor;
+}
+
+Tuple *dict_read_next(DictionaryIterator *iter) {
+    uint8_t *next = (uint8_t *)iter->cursor + sizeof(Tuple) + iter->cursor->length;
+    if (next + sizeof(Tuple) > (uint8_t *)iter->end) {
+        return NULL;
+    }
+    iter->cursor = (Tuple *)next;
+    return iter->cursor;
+}
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key) {
+    uint8_t *cursor = iter->dictionary->head;
+    for (int i = 0; i < iter->dictionary->count; i++) {
+        Tuple *tuple = (Tuple *)cursor;
+        if (tuple->key == key) {
+            return tuple;
+        }
+        cursor += sizeof(Tuple) + tuple->length;
+    }
+    return NULL;
+}
+
+static DictionaryResult dict_write_raw(DictionaryIterator *iter, uint32_t key, TupleType type, const void *data, uint16_t length) {
+    if (iter == NULL || iter->dictionary == NULL) {
+        return DICT_INVALID_ARGS;
+    }
+    uint8_t *cursor = (uint8_t *)iter->cursor;
+    if (cursor + sizeof(Tuple) + length > (uint8_t *)iter->end) {
+        return DICT_NOT_ENOUGH_STORAGE;
+    }
+    Tuple *tuple = iter->cursor;
+    tuple->key = key;
+    tuple->type = type;
+    tuple->length = length;
+    if (length > 0) {
+        memcpy(tuple->value->data, data, length);
+    }
+    iter->cursor = (Tuple *)(cursor + sizeof(Tuple) + length);
+    iter->dictionary->count++;
+    return DICT_OK;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// AppMessage over the simulated link. Each direction sends one message at
+// a time: it takes latency_ms plus its bytes at bytes_per_second to arrive.
+// The watch's outbox is freed once the phone's acknowledgement is back.
+
+static HostLinkConfig link_config = { .latency_ms = 40, .bytes_per_second = 4000 };
+static HostLinkStats link_stats;
+static uint32_t uplink_free_at;
+static uint32_t downlink_free_at;
+
+static uint8_t *inbox;
+static uint32_t inbox_size;
+static uint8_t *outbox;
+static uint32_t outbox_size;
+static DictionaryIterator outbox_iter;
+static bool outbox_begun;
+static bool outbox_sending;
+static AppMessageInboxReceived inbox_received_callback;
+static AppMessageInboxDropped inbox_dropped_callback;
+static AppMessageOutboxSent outbox_sent_callback;
+static AppMessageOutboxFailed outbox_failed_callback;
+
+void host_link_configure(const HostLinkConfig *config) {
+    link_config = *config;
+}
+
+const HostLinkStats *host_link_stats(void) {
+    return &link_stats;
+}
+
+uint32_t host_link_inbox_size(void) {
+    return inbox_size;
+}
+
+/*
+ * The firmware frees the AppMessage buffers when the app exits, they are
+ * not the app's leak
+ */
+void host_app_message_close(void) {
+    host_free(inbox);
+    host_free(outbox);
+    inbox = NULL;
+    outbox = NULL;
+}
+
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound) {
+    if (inbox != NULL) {
+        return APP_MSG_INVALID_ARGS;
+    }
+    if (size_inbound > HOST_APP_MESSAGE_SIZE_MAXIMUM || size_outbound > HOST_APP_MESSAGE_SIZE_MAXIMUM) {
+        return APP_MSG_OUT_OF_MEMORY;
+    }
+    // both buffers come out of the app's heap on the watch too
+    inbox = heap_allocate(size_inbound, "app_message_open", 0);
+    outbox = heap_allocate(size_outbound, "app_message_open", 0);
+    if (inbox == NULL || outbox == NULL) {
+        return APP_MSG_OUT_OF_MEMORY;
+    }
+    inbox_size = size_inbound;
+    outbox_size = size_outbound;
+    return APP_MSG_OK;
+}
+
+uint32_t app_message_inbox_size_maximum(void) {
+    return HOST_APP_MESSAGE_SIZE_MAXIMUM;
+}
+
+uint32_t app_message_outbox_size_maximum(void) {
+    return HOST_APP_MESSAGE_SIZE_MAXIMUM;
+}
+
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback) {
+    AppMessageInboxReceived previous = inbox_received_callback;
+    inbox_received_callback = received_callback;
+    return previous;
+}
+
+AppMessageInboxDropped app_message_register_inbox_dropped(AppMessageInboxDropped dropped_callback) {
+    AppMessageInboxDropped previous = inbox_dropped_callback;
+    inbox_dropped_callback = dropped_callback;
+    return previous;
+}
+
+AppMessageOutboxSent app_message_register_outbox_sent(AppMessageOutboxSent sent_callback) {
+    AppMessageOutboxSent previous = outbox_sent_callback;
+    outbox_sent_callback = sent_callback;
+    return previous;
+}
+
+AppMessageOutboxFailed app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback) {
+    AppMessageOutboxFailed previous = outbox_failed_callback;
+    outbox_failed_callback = failed_callback;
+    return previous;
+}
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator) {
+    *iterator = NULL;
+    if (outbox == NULL) {
+        return APP_MSG_INVALID_ARGS;
+    }
+    if (outbox_sending) {
+        return APP_MSG_BUSY;
+    }
+    dict_write_begin(&outbox_iter, outbox, outbox_size);
+    outbox_begun = true;
+    *iterator = &outbox_iter;
+    return APP_MSG_OK;
+}
+
+AppMessageResult app_message_outbox_send(void) {
+    if (!outbox_begun) {
+        return APP_MSG_INVALID_ARGS;
+    }
+    if (outbox_sending) {
+        return APP_MSG_BUSY;
+    }
+    outbox_begun = false;
+    outbox_sending = true;
+
+    Packet *packet = malloc(sizeof(Packet));
+    packet->size = dict_write_end(&outbox_iter);
+    packet->bytes = malloc(packet->size);
+    memcpy(packet->bytes, outbox, packet->size);
+    link_stats.messages_out++;
+    link_stats.bytes_out += packet->size;
+
+    uint32_t start = uplink_free_at > now ? uplink_free_at : now;
+    uplink_free_at = start + link_transmit_time(packet->size);
+    uint32_t arrival = uplink_free_at + link_config.latency_ms;
+    host_schedule(arrival - now, phone_arrival, packet);
+    host_schedule(arrival + link_config.latency_ms - now, outbox_acked, NULL);
+    return APP_MSG_OK;
+}
+
+/*
+ * Called by the phone with a message for the watch, messages arrive in the
+ * order they are sent. Returns when the watch's acknowledgement is back, in
+ * ms from now.
+ */
+uint32_t host_link_send(const uint8_t *dictionary, uint16_t size) {
+    Packet *packet = malloc(sizeof(Packet));
+    packet->size = size;
+    packet->bytes = malloc(size);
+    memcpy(packet->bytes, dictionary, size);
+
+    uint32_t start = downlink_free_at > now ? downlink_free_at : now;
+    downlink_free_at = start + link_transmit_time(size);
+    uint32_t arrival = downlink_free_at + link_config.latency_ms - now;
+    host_schedule(arrival, inbox_arrival, packet);
+    return arrival + link_config.latency_ms;
+}
+
+static uint32_t link_transmit_time(uint16_t size) {
+    return link_config.bytes_per_second > 0 ? (uint32_t)size * 1000 / link_config.bytes_per_second : 0;
+}
+
+static void phone_arrival(void *data) {
+    Packet *packet = data;
+    DictionaryIterator iter;
+    if (dict_read_begin_from_buffer(&iter, packet->bytes, packet->size) != NULL) {
+        phone_receive(&iter);
+    }
+    free(packet->bytes);
+    free(packet);
+}
+
+static void outbox_acked(void *data) {
+    outbox_sending = false;
+    if (outbox_sent_callback != NULL) {
+        DictionaryIterator sent;
+        dict_read_begin_from_buffer(&sent, outbox, dict_write_end(&outbox_iter));
+        outbox_sent_callback(&sent, NULL);
+    }
+}
+
+static void inbox_arrival(void *data) {
+    Packet *packet = data;
+    link_stats.messages_in++;
+    link_stats.bytes_in += packet->size;
+    if (inbox == NULL || packet->size > inbox_size) {
+        link_stats.dropped_in++;
+        if (inbox_dropped_callback != NULL) {
+            inbox_dropped_callback(APP_MSG_BUFFER_OVERFLOW, NULL);
+        }
+    } else if (inbox_received_callback != NULL) {
+        memcpy(inbox, packet->bytes, packet->size);
+        DictionaryIterator iter;
+        dict_read_begin_from_buffer(&iter, inbox, packet->size);
+        inbox_received_callback(&iter, NULL);
+    }
+    free(packet->bytes);
+    free(packet);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// Persist, with the watch's limits of PERSIST_DATA_MAX_LENGTH per value and
+// HOST_PERSIST_BUDGET in all
+
+static PersistValue persist_values[MAX_PERSIST_KEYS];
+static int num_persist_values;
+
+bool persist_exists(const uint32_t key) {
+    return persist_find(key) != NULL;
+}
+
+int persist_get_size(const uint32_t key) {
+    PersistValue *value = persist_find(key);
+    return value != NULL ? value->size : E_DOES_NOT_EXIST;
+}
+
+bool persist_read_bool(const uint32_t key) {
+    PersistValue *value = persist_find(key);
+    return value != NULL && value->size > 0 && value->data[0] != 0;
+}
+
+int32_t persist_read_int(const uint32_t key) {
+    int32_t result = 0;
+    PersistValue *value = persist_find(key);
+    if (value != NULL) {
+        memcpy(&result, value->data, value->size < sizeof(result) ? value->size : sizeof(result));
+    }
+    return result;
+}
+
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size) {
+    PersistValue *value = persist_find(key);
+    if (value == NULL) {
+        return E_DOES_NOT_EXIST;
+    }
+    size_t size = value->size < buffer_size ? value->size : buffer_size;
+    memcpy(buffer, value->data, size);
+    return size;
+}
+
+int persist_read_string(const uint32_t key, char *buffer, const size_t buffer_size) {
+    PersistValue *value = persist_find(key);
+    if (value == NULL) {
+        return E_DOES_NOT_EXIST;
+    }
+    if (buffer_size == 0) {
+        return 0;
+    }
+    size_t size = value->size < buffer_size - 1 ? value->size : buffer_size - 1;
+    memcpy(buffer, value->data, size);
+    buffer[size] = '\0';
+    return size;
+}
+
+status_t persist_write_bool(const uint32_t key, const bool value) {
+    uint8_t byte = value ? 1 : 0;
+    return persist_write_data(key, &byte, sizeof(byte));
+}
+
+status_t persist_write_int(const uint32_t key, const int32_t value) {
+    return persist_write_data(key, &value, sizeof(value));
+}
+
+int persist_write_data(const uint32_t key, const void *data, const size_t size) {
+    size_t length = size < PERSIST_DATA_MAX_LENGTH ? size : PERSIST_DATA_MAX_LENGTH;
+    PersistValue *value = persist_find(key);
+    size_t stored = host_persist_bytes() - (value != NULL ? value->size : 0);
+    if (stored + length > HOST_PERSIST_BUDGET) {
+        return E_OUT_OF_STORAGE;
+    }
+    if (value == NULL) {
+        if (num_persist_values == MAX_PERSIST_KEYS) {
+            return E_OUT_OF_RESOURCES;
+        }
+        value = &persist_values[num_persist_values++];
+        value->key = key;
+    }
+    value->size = length;
+    memcpy(value->data, data, length);
+    return length;
+}
+
+int persist_write_string(const uint32_t key, const char *cstring) {
+    return persist_write_data(key, cstring, strlen(cstring) + 1);
+}
+
+status_t persist_delete(const uint32_t key) {
+    PersistValue *value = persist_find(key);
+    if (value == NULL) {
+        return E_DOES_NOT_EXIST;
+    }
+    *value = persist_values[--num_persist_values];
+    return S_SUCCESS;
+}
+
+size_t host_persist_bytes(void) {
+    size_t bytes = 0;
+    for (int i = 0; i < num_persist_values; i++) {
+        bytes += persist_values[i].size;
+    }
+    return bytes;
+}
+
+/*
+ * Storage is kept between runs in a file of key, size and data records,
+ * so a session can pick up where another one left the watch
+ */
+bool host_persist_load(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    num_persist_values = 0;
+    PersistValue value;
+    while (num_persist_values < MAX_PERSIST_KEYS && fread(&value.key, sizeof(value.key), 1, file) == 1 &&
+            fread(&value.size, sizeof(value.size), 1, file) == 1 && value.size <= PERSIST_DATA_MAX_LENGTH &&
+            fread(value.data, 1, value.size, file) == value.size) {
+        persist_values[num_persist_values++] = value;
+    }
+    fclose(file);
+    return true;
+}
+
+bool host_persist_save(const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return false;
+    }
+    for (int i = 0; i < num_persist_values; i++) {
+        fwrite(&persist_values[i].key, sizeof(persist_values[i].key), 1, file);
+        fwrite(&persist_values[i].size, sizeof(persist_values[i].size), 1, file);
+        fwrite(persist_values[i].data, 1, persist_values[i].size, file);
+    }
+    return fclose(file) == 0;
+}
+
+static PersistValue *persist_find(uint32_t key) {
+    for (int i = 0; i < num_persist_values; i++) {
+        if (persist_values[i].key == key) {
+            return &persist_values[i];
+        }
+    }
+    return NULL;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - //
+// Dictation answers a while after it starts with what the script said last
+
+void host_set_dictation(const char *transcription) {
+    snprintf(dictation_transcription, sizeof(dictation_transcription), "%s", transcription);
+}
+
+DictationSession *dictation_session_create(uint32_t buffer_size, DictationSessionStatusCallback callback, void *callback_context) {
+    DictationSession *session = heap_allocate(sizeof(DictationSession) + buffer_size, "dictation_session_create", 0);
+    if (session == NULL) {
+        return NULL;
+    }
+    session->callback = callback;
+    session->context = callback_context;
+    session->event = NULL;
+    session->buffer_size = buffer_size;
+    session->transcription = (char *)(session + 1);
+    return session;
+}
+
+void dictation_session_destroy(DictationSession *session) {
+    if (session == NULL) {
+        return;
+    }
+    if (session->event != NULL) {
+        host_cancel(session->event);
+    }
+    host_free(session);
+}
+
+DictationSessionStatus dictation_session_start(DictationSession *session) {
+    if (session->event == NULL) {
+        session->event = host_schedule(DICTATION_MS, dictation_finished, session);
+    }
+    return DictationSessionStatusSuccess;
+}
+
+static void dictation_finished(void *data) {
+    DictationSession *session = data;
+    session->event = NULL;
+    if (dictation_transcription[0] == '\0') {
+        session->callback(session, DictationSessionStatusFailureNoSpeechDetected, NULL, session->context);
+        return;
+    }
+    snprintf(session->transcription, session->buffer_size, "%s", dictation_transcription);
+    dictation_transcription[0] = '\0';
+    session->callback(session, DictationSessionStatusSuccess, session->transcription, session->context);
+}
@@ -0,0 +1,164 @@
+/*
+ * FavoriteList with thousands of favorites: adding them one by one, looking
+ * them up, removing a few and loading the list again from localStorage,
+ * against the array backed list it replaced, which wrote the whole list on
+ * every change and re-added every favorite on load. Times are real, writes
+ * are calls to localStorage.setItem() and the characters they wrote.
+ *
+ *     node tools/js/bench-favorites.js [--counts 100,1000,3000]
+ */
+var harness = require('./harness');
+
+var args = harness.parseArgs(process.argv.slice(2), {counts: '100,1000,3000'});
+var counts = args.counts.split(',').map(Number);
+
+/*
+ * js/favorite.js's FavoriteList before it was keyed by passage, reading
+ * and writing storage instead of the global localStorage
+ */
+function LegacyFavoriteList(storage, Favorite) {
+
+    this.favorites = [];
+
+    this.count = function() {
+        return this.favorites.length;
+    };
+
+    this.contains = function(aFavorite) {
+        for (var i = 0; i < this.favorites.length; i++) {
+            if (this.favorites[i].isEqual(aFavorite)) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    this.add = function(aFavorite) {
+        if (this.contains(aFavorite)) {
+            return false;
+        }
+        this.favorites.push(aFavorite);
+        this.save();
+        return true;
+    };
+
+    this.remove = function(aFavorite) {
+        for (var i = 0; i < this.favorites.length; i++) {
+            if (this.favorites[i].isEqual(aFavorite)) {
+                this.favorites.splice(i, 1);
+                this.save();
+                return true;
+            }
+        }
+        return false;
+    };
+
+    this.save = function() {
+        var jsonFavorites = [];
+        for (var i = 0; i < this.favorites.length; i++) {
+            jsonFavorites.push(this.favorites[i].asJSONObject());
+        }
+        storage.setItem('favoriteList', JSON.stringify(jsonFavorites));
+    };
+
+    this.reload = function() {
+        var jsonFavorites = JSON.parse(storage.getItem('favoriteList')) || [];
+        for (var i = 0; i < jsonFavorites.length; i++) {
+            this.add(new Favorite(jsonFavorites[i]));
+        }
+    };
+
+    this.reload();
+}
+
+/*
+ * count distinct passages, a verse each, spread over the Bible
+ */
+function passages(app, count) {
+    var verses = [];
+    var books = app.bible[0].concat(app.bible[1]);
+    books.forEach(function(book) {
+        for (var chapter = 1; chapter <= book.chapters; chapter++) {
+            for (var verse = 1; verse <= book.verses[chapter - 1]; verse++) {
+                verses.push({book: book.name, chapter: chapter, range: verse + '-' + verse});
+            }
+        }
+    });
+    var list = [];
+    var stride = Math.max(1, Math.floor(verses.length / count));
+    for (var i = 0; i < count && i * stride < verses.length; i++) {
+        list.push(new app.Favorite(verses[i * stride]));
+    }
+    return list;
+}
+
+function ms(started) {
+    var elapsed = process.hrtime(started);
+    return elapsed[0] * 1e3 + elapsed[1] / 1e6;
+}
+
+/*
+ * @param create Makes a list on the phone, loading what is stored
+ * @param settle Lets batched writes happen
+ */
+function run(phone, favorites, create, settle) {
+    var storage = phone.localStorage;
+    var result = {};
+    var list = create();
+
+    var started = process.hrtime();
+    favorites.forEach(function(favorite) {
+        list.add(favorite);
+    });
+    settle();
+    result.add = ms(started);
+    result.addWrites = storage.writes;
+    result.addWritten = storage.bytesWritten;
+
+    started = process.hrtime();
+    favorites.forEach(function(favorite) {
+        list.contains(favorite);
+    });
+    result.contains = ms(started);
+
+    var removed = favorites.slice(0, 10);
+    started = process.hrtime();
+    removed.forEach(function(favorite) {
+        list.remove(favorite);
+    });
+    settle();
+    result.remove = ms(started);
+
+    storage.writes = 0;
+    started = process.hrtime();
+    list = create();
+    result.load = ms(started);
+    result.loadWrites = storage.writes;
+    result.count = list.count();
+    result.stored = storage.bytes();
+    return result;
+}
+
+var widths = [7, 7, 10, 7, 10, 10, 10, 9, 7, 8];
+console.log(harness.formatRow(['count', 'list', 'add ms', 'writes', 'written', 'contains', 'remove 10', 'load ms', 'writes',
+    'stored'], widths));
+counts.forEach(function(count) {
+    var lists = ['before', 'keyed'];
+    lists.forEach(function(name) {
+        var phone = new harness.Phone();
+        var app = phone.app;
+        var favorites = passages(app, count);
+        var result = name === 'keyed' ? run(phone, favorites, function() {
+            return new app.FavoriteList(app.options.favorites);
+        }, function() {
+            phone.settle();
+        }) : run(phone, favorites, function() {
+            return new LegacyFavoriteList(phone.localStorage, app.Favorite);
+        }, function() {});
+        if (result.count !== count - 10) {
+            throw new Error(name + ' list loaded ' + result.count + ' of ' + (count - 10) + ' favorites');
+        }
+        console.log(harness.formatRow([count, name, result.add, result.addWrites, result.addWritten, result.contains, result.remove,
+            result.load, result.loadWrites, result.stored], widths));
+    });
+});
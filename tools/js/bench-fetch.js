@@ -0,0 +1,195 @@
+/*
+ * The fetch layer in front of labs.bible.org, against the mock API. The
+ * first table runs a few bursts of chapter lookups with the fetch layer as
+ * it was before, one request per lookup however many asked for the chapter,
+ * with only shared fetches and with shared fetches batched:
+ *
+ * - list + viewer: the watch asks for the verse list and the text of a
+ *   chapter at once
+ * - warm 6: launch with six favorites in neighbouring chapters to warm, see
+ *   options.startup.warmFavorites
+ * - reading: ten chapters of Genesis in turn, each prefetching the next
+ *
+ * Each cell is HTTP requests / KB served / simulated ms the reader waited:
+ * for the later of the two replies to start, for the last favorite to be
+ * fetched after launch, for the ten chapters to start in all.
+ *
+ * The second table replays a reading trace, mostly straight on through a
+ * few books with jumps back to favorite chapters and elsewhere, under
+ * several chapter cache budgets, and counts how many reads the cache
+ * answered and what went over HTTP.
+ *
+ *     node tools/js/bench-fetch.js [--platform basalt] [--http 150]
+ *         [--reads 300] [--budgets 32,64,128,256,512] [--seed 1]
+ */
+var harness = require('./harness');
+var sim = require('./sim');
+
+var args = harness.parseArgs(process.argv.slice(2), {platform: 'basalt', http: 150, reads: 300, budgets: '32,64,128,256,512', seed: 1});
+var window = harness.PLATFORMS[args.platform].windowBytes;
+
+var LAYERS = [
+    {name: 'before', shared: false, maxConcurrent: Infinity, maxBatchChapters: 1},
+    {name: 'shared', shared: true, maxConcurrent: 2, maxBatchChapters: 1},
+    {name: 'batched', shared: true}
+];
+
+var WARM = [['Psalms', 20], ['Psalms', 21], ['Psalms', 22], ['Psalms', 23], ['Psalms', 24], ['Psalms', 25]];
+
+/*
+ * A phone whose fetch layer behaves like layer, noting when each fetch is
+ * answered
+ */
+function phoneWith(layer, storage) {
+    var phone = new harness.Phone({platform: args.platform, http: {latency: args.http}, storage: storage});
+    var app = phone.app;
+    // options.http is the provider's config
+    app.options.http.maxConcurrent = layer.maxConcurrent || app.options.http.maxConcurrent;
+    app.options.http.maxBatchChapters = layer.maxBatchChapters || app.options.http.maxBatchChapters;
+    if (!layer.shared) {
+        // getVerseText() never finds a fetch in flight to wait for
+        app.pendingChapters.hasOwnProperty = function() {
+            return false;
+        };
+    }
+    phone.answered = 0;
+    var finish = app.httpProvider.finish;
+    app.httpProvider.finish = function(batch, verses, error) {
+        phone.answered = phone.clock.now;
+        finish.call(app.httpProvider, batch, verses, error);
+    };
+    return phone;
+}
+
+/*
+ * localStorage of a phone with the WARM favorites
+ */
+function favoritesStorage() {
+    var phone = new harness.Phone({platform: args.platform});
+    WARM.forEach(function(passage) {
+        phone.app.favoriteList.add(new phone.app.Favorite({book: passage[0], chapter: passage[1], range: '1-'}));
+    });
+    phone.settle();
+    return phone.localStorage.dump();
+}
+
+var SCENARIOS = [
+    {name: 'list + viewer', run: function(layer) {
+        var phone = phoneWith(layer);
+        phone.start();
+        var started = phone.clock.now;
+        var tokens = [
+            phone.watch.request({request: 1, book: 'John', chapter: 3}),
+            phone.watch.request({request: 2, book: 'John', chapter: 3, range: '1-', offset: 0, length: window})
+        ];
+        phone.settle();
+        return {phone: phone, waited: Math.max.apply(null, tokens.map(function(token) {
+            return phone.watch.requests[token].first;
+        })) - started};
+    }},
+    {name: 'warm 6', run: function(layer, storage) {
+        var phone = phoneWith(layer, storage);
+        phone.app.options.startup.warmFavorites = WARM.length;
+        var started = phone.clock.now;
+        phone.start();
+        phone.settle();
+        return {phone: phone, waited: phone.answered - started};
+    }},
+    {name: 'reading', run: function(layer) {
+        var phone = phoneWith(layer);
+        phone.start();
+        var waited = 0;
+        for (var chapter = 1; chapter <= 10; chapter++) {
+            var request = phone.request({request: 2, book: 'Genesis', chapter: chapter, range: '1-', offset: 0, length: window});
+            waited += request.first - request.sent;
+            phone.settle();
+        }
+        return {phone: phone, waited: waited};
+    }}
+];
+
+/*
+ * Chapters to read: on through the book most of the time, back to one of
+ * the favorite chapters, the first the most often, or anywhere at all
+ */
+function trace(books, count, seed) {
+    var random = new sim.Random(seed);
+    var favorites = [];
+    for (var i = 0; i < 10; i++) {
+        favorites.push(pick(books, random));
+    }
+    var reads = [];
+    var at = pick(books, random);
+    while (reads.length < count) {
+        reads.push(at);
+        var roll = random.next();
+        if (roll < 0.15) {
+            at = favorites[Math.floor(favorites.length * random.next() * random.next())];
+        } else if (roll < 0.2) {
+            at = pick(books, random);
+        } else if (at.chapter < books[at.book].verses.length) {
+            at = {book: at.book, chapter: at.chapter + 1};
+        } else {
+            at = {book: (at.book + 1) % books.length, chapter: 1};
+        }
+    }
+    return reads;
+}
+
+function pick(books, random) {
+    var book = Math.floor(random.next() * books.length);
+    return {book: book, chapter: 1 + Math.floor(random.next() * books[book].verses.length)};
+}
+
+function replay(reads, budget) {
+    var phone = new harness.Phone({platform: args.platform, http: {latency: args.http}});
+    var app = phone.app;
+    app.options.cache.maxBytes = budget * 1024;
+    phone.start();
+    var books = phone.api.books;
+    var cached = 0;
+    reads.forEach(function(read) {
+        var book = books[read.book].name;
+        if (app.bibleCache.peek(book + read.chapter) !== null) {
+            cached++;
+        }
+        phone.request({request: 2, book: book, chapter: read.chapter, range: '1-', offset: 0, length: window});
+        phone.settle();
+    });
+    var stats = app.bibleCache.stats();
+    return {
+        chapters: stats.chapters, cached: cached, hits: stats.hits, misses: stats.misses, evictions: stats.evictions,
+        requests: phone.api.requests, served: phone.api.bytesServed
+    };
+}
+
+console.log(args.platform + ', API ' + args.http + ' ms, cells are HTTP requests / KB served / ms waited');
+var storage = favoritesStorage();
+var widths = [9].concat(SCENARIOS.map(function() {
+    return 20;
+}));
+console.log(harness.formatRow(['layer'].concat(SCENARIOS.map(function(scenario) {
+    return scenario.name;
+})), widths));
+LAYERS.forEach(function(layer) {
+    var row = [layer.name];
+    SCENARIOS.forEach(function(scenario) {
+        var result = scenario.run(layer, storage);
+        var phone = result.phone;
+        row.push(phone.api.requests + ' / ' + (phone.api.bytesServed / 1024).toFixed(1) + ' / ' +
+            Math.round(result.waited));
+    });
+    console.log(harness.formatRow(row, widths));
+});
+console.log();
+
+var reads = trace(new harness.Phone().api.books, args.reads, args.seed);
+console.log(reads.length + ' reads, cache budgets in KB; cached is the reads the cache already held, hits and misses include prefetches');
+widths = [7, 9, 7, 8, 6, 7, 10, 9, 9];
+console.log(harness.formatRow(['budget', 'chapters', 'cached', 'of reads', 'hits', 'misses', 'evictions', 'requests',
+    'KB served'], widths));
+args.budgets.split(',').map(Number).forEach(function(budget) {
+    var result = replay(reads, budget);
+    console.log(harness.formatRow([budget, result.chapters, result.cached, (100 * result.cached / reads.length).toFixed(1) + '%',
+        result.hits, result.misses, result.evictions, result.requests, result.served / 1024], widths));
+});
@@ -0,0 +1,104 @@
+/*
+ * The phone's side of link compression: lzEncode() and lzDecode() from
+ * js/lz.js on the same chapters as tools/host/bench_lz.c, window by window
+ * like requestVerseText(), timed for real.
+ *
+ *     node tools/js/bench-lz.js [--window 2048] [chapter.txt ...]
+ *
+ * The chapters default to tools/fixtures/kjv/*.txt and Psalm 119 of the
+ * mock API's made-up text.
+ */
+var fs = require('fs');
+var path = require('path');
+var harness = require('./harness');
+
+var MIN_TIMING_MS = 50;
+
+var args = harness.parseArgs(process.argv.slice(2), {window: 2048});
+var app = new harness.Phone().app;
+
+/*
+ * Real ms per call of fn, repeated until the clock can be trusted
+ */
+function timed(fn) {
+    var rounds = 0;
+    var started = process.hrtime();
+    var elapsed = 0;
+    do {
+        fn();
+        rounds++;
+        var time = process.hrtime(started);
+        elapsed = time[0] * 1e3 + time[1] / 1e6;
+    } while (elapsed < MIN_TIMING_MS);
+    return elapsed / rounds;
+}
+
+function measure(text) {
+    var bytes = app.toUtf8Bytes(text);
+    var windows = [];
+    for (var offset = 0; offset < bytes.length; offset += args.window) {
+        windows.push(bytes.substring(offset, app.utf8Boundary(bytes, Math.min(offset + args.window, bytes.length))));
+    }
+    var packed = windows.map(function(window) {
+        return app.lzEncode(window);
+    });
+    var decoded = packed.map(function(window) {
+        return app.lzDecode(window);
+    }).join('');
+    if (decoded !== windows.join('')) {
+        throw new Error('lzDecode() did not give back what lzEncode() was given');
+    }
+    var packedLength = packed.reduce(function(sum, window) {
+        return sum + window.length;
+    }, 0);
+    return {
+        bytes: bytes.length,
+        windows: windows.length,
+        packed: packedLength,
+        encode: timed(function() {
+            windows.forEach(function(window) {
+                app.lzEncode(window);
+            });
+        }),
+        decode: timed(function() {
+            packed.forEach(function(window) {
+                app.lzDecode(window);
+            });
+        })
+    };
+}
+
+var chapters = [];
+var files = args._;
+if (files.length === 0) {
+    var fixtures = path.join(__dirname, '..', 'fixtures', 'kjv');
+    files = fs.readdirSync(fixtures).filter(function(name) {
+        return /\.txt$/.test(name);
+    }).sort().map(function(name) {
+        return path.join(fixtures, name);
+    });
+}
+files.forEach(function(file) {
+    chapters.push({name: path.basename(file), text: fs.readFileSync(file, 'utf8').replace(/[\r\n]+$/, '')});
+});
+if (args._.length === 0) {
+    var verses = new harness.Phone().api.chapter('Psalms', 119);
+    chapters.push({name: 'Psalms 119 (made up)', text: verses.map(function(verse) {
+        return verse.verse + ') ' + app.cleanString(verse.text);
+    }).join('\n')});
+}
+
+// one round for the JIT to settle before anything counts
+chapters.forEach(function(chapter) {
+    measure(chapter.text);
+});
+
+var widths = [22, 6, 4, 6, 6, 9, 9];
+console.log(args.window + ' byte windows, times in µs per KB of text');
+console.log(harness.formatRow(['chapter', 'bytes', 'wins', 'packed', 'ratio', 'encode', 'decode'], widths));
+chapters.forEach(function(chapter) {
+    var result = measure(chapter.text);
+    console.log(harness.formatRow([chapter.name, result.bytes, result.windows, result.packed,
+        (100 * result.packed / result.bytes).toFixed(1) + '%', 1000 * result.encode / (result.bytes / 1024),
+        1000 * result.decode / (result.bytes / 1024)], widths));
+});
@@ -0,0 +1,132 @@
+/*
+ * The passage providers side by side: the same reading session on a phone
+ * that fetches every chapter from the mock API, on one with a slow API, on
+ * one with the offline pack installed and on one with the pack and no
+ * network at all. Times are simulated ms from the watch asking for the
+ * first window of a passage to its arrival, they leave out the app's own
+ * work unless --cpu charges it to the clock. Decompressing a book of the
+ * pack is CPU bound, so it is also timed on its own, for real.
+ *
+ *     node tools/js/bench-providers.js [--platform basalt] [--http 150]
+ *         [--slow 1500] [--rate 50] [--cpu 0]
+ *
+ * The fetches include the app's prefetches of the following chapter.
+ */
+var harness = require('./harness');
+
+var args = harness.parseArgs(process.argv.slice(2), {platform: 'basalt', http: 150, slow: 1500, rate: 50, cpu: 0});
+var window = harness.PLATFORMS[args.platform].windowBytes;
+var PACK_URL = 'http://labs.bible.org/pack.json';
+
+var SESSION = [['Genesis', 1], ['Genesis', 2], ['Genesis', 3], ['Psalms', 23], ['Psalms', 119], ['Isaiah', 53], ['John', 1],
+    ['John', 3], ['Romans', 8], ['Revelation', 22]];
+
+var PHONES = [
+    {name: 'online', http: {latency: args.http, bytesPerMs: args.rate}},
+    {name: 'slow API', http: {latency: args.slow, bytesPerMs: args.rate}},
+    {name: 'offline pack', pack: true, http: {latency: args.http, bytesPerMs: args.rate}},
+    {name: 'pack, no network', pack: true, http: {latency: args.http, bytesPerMs: args.rate, failure: 1}}
+];
+
+/*
+ * localStorage of a phone that has downloaded and installed the pack
+ */
+function installedPack() {
+    var phone = new harness.Phone({platform: args.platform});
+    phone.app.options.offline.packUrl = PACK_URL;
+    phone.start();
+    // the first miss of the offline provider starts the download
+    phone.request({request: 1, book: 'Genesis', chapter: 1});
+    phone.settle(5 * 60 * 1000);
+    var storage = phone.localStorage.dump();
+    for (var key in storage) {
+        if (key.indexOf('pack:') !== 0) {
+            delete storage[key];
+        }
+    }
+    return storage;
+}
+
+function session(config, storage) {
+    var phone = new harness.Phone({
+        platform: args.platform, http: config.http, storage: config.pack ? storage : null, cpuScale: args.cpu
+    });
+    if (config.pack) {
+        // the offline provider is only asked with a pack URL configured
+        phone.app.options.offline.packUrl = PACK_URL;
+    }
+    phone.start();
+    var times = [];
+    var failed = 0;
+    for (var i = 0; i < SESSION.length; i++) {
+        var request = phone.request({request: 2, book: SESSION[i][0], chapter: SESSION[i][1], range: '1-', offset: 0, length: window});
+        if (request.error || request.first < 0) {
+            failed++;
+            continue;
+        }
+        times.push(request.first - request.sent);
+        phone.settle();
+    }
+    times.sort(function(a, b) {
+        return a - b;
+    });
+    var sum = times.reduce(function(a, b) {
+        return a + b;
+    }, 0);
+    return {
+        mean: times.length ? sum / times.length : 0,
+        median: times.length ? times[Math.floor(times.length / 2)] : 0,
+        max: times.length ? times[times.length - 1] : 0,
+        failed: failed,
+        fetches: phone.api.requests,
+        http: phone.httpStats.bytes
+    };
+}
+
+/*
+ * Real ms to decompress each book of the session from the pack
+ */
+function decodeTimes(storage) {
+    var phone = new harness.Phone({platform: args.platform, storage: storage});
+    var offline = phone.app.offlineProvider;
+    var times = {};
+    for (var i = 0; i < SESSION.length; i++) {
+        var book = SESSION[i][0];
+        if (times.hasOwnProperty(book)) {
+            continue;
+        }
+        offline.bookName = null;
+        var started = process.hrtime();
+        offline.loadBook(book);
+        var elapsed = process.hrtime(started);
+        times[book] = {ms: elapsed[0] * 1e3 + elapsed[1] / 1e6, bytes: storage[offline.storageKey(book)].length};
+    }
+    return times;
+}
+
+var storage = installedPack();
+var packBytes = 0;
+var books = 0;
+for (var key in storage) {
+    packBytes += key.length + storage[key].length;
+    books += /^pack:\d+:index$/.test(key) ? 0 : 1;
+}
+console.log(args.platform + ', first ' + window + ' byte window of ' + SESSION.length + ' chapters, API ' + args.http + ' ms (slow ' +
+    args.slow + ' ms) + ' + args.rate + ' bytes/ms');
+console.log('pack: ' + books + ' books in ' + packBytes + ' characters of localStorage');
+console.log();
+
+var widths = [18, 7, 7, 7, 7, 8, 9];
+console.log(harness.formatRow(['provider', 'mean', 'median', 'max', 'failed', 'fetches', 'http'], widths));
+for (var i = 0; i < PHONES.length; i++) {
+    var result = session(PHONES[i], storage);
+    console.log(harness.formatRow([PHONES[i].name, Math.round(result.mean), Math.round(result.median), Math.round(result.max),
+        result.failed, result.fetches, result.http], widths));
+}
+console.log();
+
+var decoded = decodeTimes(storage);
+console.log(harness.formatRow(['book', 'stored', 'decode ms'], [18, 9, 10]));
+for (var book in decoded) {
+    console.log(harness.formatRow([book, decoded[book].bytes, decoded[book].ms.toFixed(2)], [18, 9, 10]));
+}
@@ -0,0 +1,90 @@
+/*
+ * Time to first chunk and to completion of each request the watch makes,
+ * on a fresh phone (cold: nothing cached, every chapter fetched from the
+ * mock API) and again right after (warm). Times are simulated ms from the
+ * watch sending the request.
+ *
+ *     node tools/js/bench-requests.js [--platform basalt] [--latency 40]
+ *         [--mtu 158] [--packet 8] [--loss 0] [--http 150] [--rate 50]
+ *         [--seed 1] [--cpu 0] [--compression 1]
+ *
+ * --rate is the HTTP body rate in bytes per ms, --cpu charges the real time
+ * the app's handlers take to the simulated clock, times that factor, and
+ * --compression 0 has the watch turn LZ compression of the link off.
+ */
+var harness = require('./harness');
+
+var args = harness.parseArgs(process.argv.slice(2), {
+    platform: 'basalt', latency: 40, mtu: 158, packet: 8, loss: 0, http: 150, rate: 50, seed: 1, cpu: 0, compression: 1
+});
+
+var config = {
+    platform: args.platform,
+    link: {latency: args.latency, mtu: args.mtu, packetMs: args.packet, loss: args.loss, seed: args.seed},
+    http: {latency: args.http, bytesPerMs: args.rate},
+    cpuScale: args.cpu
+};
+var window = harness.PLATFORMS[args.platform].windowBytes;
+
+// Request numbers from js/pebble-js-app.js
+var Request = {Verses: 1, Viewer: 2, Favorites: 4, ToggleFavorite: 5, NextPassage: 7, Search: 8};
+
+var BENCHMARKS = [
+    {name: 'Verses Genesis 1', payload: {request: Request.Verses, book: 'Genesis', chapter: 1}},
+    {name: 'Viewer Genesis 1', payload: {request: Request.Viewer, book: 'Genesis', chapter: 1, range: '1-', offset: 0, length: window}},
+    {name: 'Viewer Psalms 119', payload: {request: Request.Viewer, book: 'Psalms', chapter: 119, range: '1-', offset: 0, length: window}},
+    {name: 'Viewer Psalms 119 +3', payload: {request: Request.Viewer, book: 'Psalms', chapter: 119, range: '1-', offset: 3 * window, length: window}},
+    {name: 'NextPassage Genesis 1', payload: {request: Request.NextPassage, book: 'Genesis', chapter: 1, range: '1-31'}},
+    {name: 'ToggleFavorite', payload: {request: Request.ToggleFavorite, book: 'John', chapter: 3, range: '16-16'}},
+    {name: 'Favorites', setup: toggleFavorites, payload: {request: Request.Favorites, revision: 0}},
+    {name: 'Search reference', payload: {request: Request.Search, content: 'Psalm 23'}},
+    {name: 'Search words', setup: readChapters, payload: {request: Request.Search, content: 'righteousness commandments'}}
+];
+
+function toggleFavorites(phone) {
+    var passages = [['Genesis', 1, '1-31'], ['Psalms', 23, '1-6'], ['John', 3, '16-16'], ['Romans', 8, '28-39']];
+    for (var i = 0; i < passages.length; i++) {
+        phone.request({request: Request.ToggleFavorite, book: passages[i][0], chapter: passages[i][1], range: passages[i][2]});
+    }
+}
+
+function readChapters(phone) {
+    for (var chapter = 1; chapter <= 10; chapter++) {
+        phone.request({request: Request.Verses, book: 'Genesis', chapter: chapter});
+    }
+    phone.settle();
+}
+
+function measure(phone, payload) {
+    var fetches = phone.api.requests;
+    var request = phone.request(payload);
+    return {
+        first: request.first >= 0 ? Math.round(request.first - request.sent) : -1,
+        complete: request.last >= 0 ? Math.round(request.last - request.sent) : -1,
+        messages: request.messages,
+        bytes: request.bytes,
+        fetches: phone.api.requests - fetches,
+        error: request.error
+    };
+}
+
+var widths = [22, 7, 8, 5, 6, 5, 7, 8, 5, 6, 5];
+console.log(args.platform + ', link ' + args.latency + ' ms latency, ' + args.mtu + ' byte MTU, ' + args.packet + ' ms per packet, ' +
+    (args.loss * 100) + '% loss, API ' + args.http + ' ms + ' + args.rate + ' bytes/ms');
+console.log(harness.formatRow(['', 'cold', '', '', '', '', 'warm', '', '', '', ''], widths));
+console.log(harness.formatRow(['request', 'first', 'complete', 'msgs', 'bytes', 'http', 'first', 'complete', 'msgs', 'bytes', 'http'], widths));
+for (var i = 0; i < BENCHMARKS.length; i++) {
+    var benchmark = BENCHMARKS[i];
+    var phone = new harness.Phone(config);
+    phone.start({compression: args.compression});
+    if (benchmark.setup) {
+        benchmark.setup(phone);
+    }
+    var cold = measure(phone, benchmark.payload);
+    phone.settle();
+    var warm = measure(phone, benchmark.payload);
+    console.log(harness.formatRow([benchmark.name,
+        cold.first, cold.complete, cold.messages, cold.bytes, cold.fetches,
+        warm.first, warm.complete, warm.messages, warm.bytes, warm.fetches], widths) +
+        (cold.error || warm.error ? '  ' + (cold.error || warm.error) : ''));
+}
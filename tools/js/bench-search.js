@@ -0,0 +1,164 @@
+/*
+ * SearchIndex build time, memory and query latency, headless. The index is
+ * built over growing parts of a Bible-shaped corpus: the verse counts of
+ * data/bible.json, about 25 words a verse drawn from a Zipf distribution
+ * over 12800 words, the most frequent of them the stop words, which is
+ * roughly how KJV text is made up. --corpus mock uses the mock API's text
+ * instead, whose few dozen words give a handful of very long posting lists.
+ * All times are real.
+ *
+ *     node tools/js/bench-search.js [--corpus zipf|mock] [--words 12800]
+ *         [--seed 1]
+ */
+var v8 = require('v8');
+var vm = require('vm');
+var harness = require('./harness');
+var sim = require('./sim');
+
+var MIN_TIMING_MS = 50;
+var WORDS_PER_VERSE = 25;
+
+var args = harness.parseArgs(process.argv.slice(2), {corpus: 'zipf', words: 12800, seed: 1});
+var phone = new harness.Phone();
+var app = phone.app;
+
+v8.setFlagsFromString('--expose-gc');
+var gc = vm.runInNewContext('gc');
+
+/*
+ * Pseudo words for ranks past the stop words, from syllables so they look
+ * like words to the tokenizer
+ */
+function vocabulary(size) {
+    var syllables = ['ba', 'ke', 'lo', 'mi', 'nu', 'ra', 'se', 'ti', 'vo', 'za', 'dor', 'gil', 'han', 'mes', 'pur', 'thy'];
+    var words = Object.keys(app.STOP_WORDS);
+    for (var i = 0; words.length < size; i++) {
+        var word = '';
+        for (var n = i + syllables.length; n > 0; n = Math.floor(n / syllables.length)) {
+            word += syllables[n % syllables.length];
+        }
+        words.push(word);
+    }
+    return words;
+}
+
+function ZipfCorpus(size, seed) {
+
+    var words = vocabulary(size);
+    var cumulative = [];
+    var total = 0;
+    for (var i = 0; i < words.length; i++) {
+        total += 1 / (i + 1);
+        cumulative.push(total);
+    }
+    var random = new sim.Random(seed);
+
+    this.word = function(rank) {
+        return words[rank];
+    };
+
+    this.verse = function() {
+        var text = [];
+        for (var i = 0; i < WORDS_PER_VERSE; i++) {
+            var target = random.next() * total;
+            var low = 0;
+            var high = cumulative.length - 1;
+            while (low < high) {
+                var middle = (low + high) >> 1;
+                if (cumulative[middle] < target) {
+                    low = middle + 1;
+                } else {
+                    high = middle;
+                }
+            }
+            text.push(words[low]);
+        }
+        return text.join(' ') + '.';
+    };
+
+    this.chapter = function(book, chapter) {
+        var verses = [];
+        var count = phone.api.books[phone.api.bookIndex(book)].verses[chapter - 1];
+        for (var verse = 1; verse <= count; verse++) {
+            verses.push({verse: verse.toString(), text: this.verse()});
+        }
+        return verses;
+    };
+
+}
+
+/*
+ * Every chapter of the Bible as records, in canonical order
+ */
+function chapters(corpus) {
+    var records = [];
+    var books = phone.api.books;
+    for (var book = 0; book < books.length; book++) {
+        for (var chapter = 1; chapter <= books[book].verses.length; chapter++) {
+            var verses = corpus.chapter(books[book].name, chapter);
+            records.push({book: books[book].name, chapter: chapter, record: app.chapterRecord(verses)});
+        }
+    }
+    return records;
+}
+
+function timed(fn) {
+    fn();
+    var rounds = 0;
+    var started = process.hrtime();
+    var elapsed = 0;
+    do {
+        fn();
+        rounds++;
+        var time = process.hrtime(started);
+        elapsed = time[0] * 1e3 + time[1] / 1e6;
+    } while (elapsed < MIN_TIMING_MS);
+    return elapsed / rounds;
+}
+
+var corpus = args.corpus === 'mock' ? phone.api : new ZipfCorpus(args.words, args.seed);
+var all = chapters(corpus);
+var QUERIES = args.corpus === 'mock' ? [
+    ['rare word', 'commandments'],
+    ['common word', 'lord'],
+    ['two words', 'righteousness king'],
+    ['four words', 'jacobs house israel land']
+] : [
+    ['rare word', corpus.word(8000)],
+    ['common word', corpus.word(60)],
+    ['two words', corpus.word(200) + ' ' + corpus.word(3000)],
+    ['four words', [corpus.word(100), corpus.word(500), corpus.word(2000), corpus.word(6000)].join(' ')]
+];
+QUERIES.push(['reference', 'Jn 3:16']);
+
+console.log(args.corpus + ' corpus, ' + all.length + ' chapters');
+var widths = [9, 7, 7, 9, 10, 10, 9].concat(QUERIES.map(function() {
+    return 11;
+}));
+console.log(harness.formatRow(['chapters', 'verses', 'words', 'refs', 'estimate', 'heap', 'build ms'].concat(QUERIES.map(function(query) {
+    return query[0];
+})), widths));
+
+[10, 100, 300, all.length].forEach(function(count) {
+    gc();
+    var heap = process.memoryUsage().heapUsed;
+    var index = new app.SearchIndex(app.options.search);
+    var started = process.hrtime();
+    for (var i = 0; i < count; i++) {
+        index.addChapter(all[i].book, all[i].chapter, all[i].record);
+    }
+    var elapsed = process.hrtime(started);
+    gc();
+    var held = process.memoryUsage().heapUsed - heap;
+    var stats = index.stats();
+    var row = [count, stats.verses, stats.words, stats.refs, stats.bytes, held, elapsed[0] * 1e3 + elapsed[1] / 1e6];
+    QUERIES.forEach(function(query) {
+        var ms = query[0] === 'reference' ? timed(function() {
+            app.parseReference(query[1]);
+        }) : timed(function() {
+            index.search(query[1]);
+        });
+        row.push(ms < 1 ? (ms * 1000).toFixed(1) + ' us' : ms.toFixed(2) + ' ms');
+    });
+    console.log(harness.formatRow(row, widths));
+});
@@ -0,0 +1,110 @@
+/*
+ * Verse ranges out of the longest chapters, the way requestVerseText() took
+ * them before chapters were cached as records, scanning every verse of the
+ * API's response and cleaning the text on each request, against
+ * recordSlice() on the chapter's record. A slice is a substring, which V8
+ * makes without copying, so the time toUtf8Bytes() then takes over it, as
+ * a passage stream does next with either, is shown on its own. The text is
+ * the mock API's; times are real, in µs per range.
+ *
+ *     node tools/js/bench-slice.js [--chapters 5]
+ */
+var harness = require('./harness');
+
+var MIN_TIMING_MS = 50;
+
+var args = harness.parseArgs(process.argv.slice(2), {chapters: 5});
+var phone = new harness.Phone();
+var app = phone.app;
+
+/*
+ * requestVerseText() before chapter records: a range of the response as
+ * "<verse>) <text> " runs, cleaned
+ */
+function legacySlice(response, first, last) {
+    var verseText = "";
+    for (var i in response)
+    {
+        if (parseInt(response[i].verse) >= parseInt(first) && parseInt(response[i].verse) <= parseInt(last))
+        {
+            verseText += response[i].verse + ") " + response[i].text + " ";
+        }
+    }
+    return app.cleanString(verseText);
+}
+
+/*
+ * Real ms per call of fn, repeated until the clock can be trusted
+ */
+function timed(fn) {
+    fn();
+    var rounds = 0;
+    var started = process.hrtime();
+    var elapsed = 0;
+    do {
+        fn();
+        rounds++;
+        var time = process.hrtime(started);
+        elapsed = time[0] * 1e3 + time[1] / 1e6;
+    } while (elapsed < MIN_TIMING_MS);
+    return elapsed / rounds;
+}
+
+/*
+ * The chapters with the most verses, most first
+ */
+function longest(count) {
+    var chapters = [];
+    phone.api.books.forEach(function(book) {
+        book.verses.forEach(function(verses, i) {
+            chapters.push({book: book.name, chapter: i + 1, verses: verses});
+        });
+    });
+    chapters.sort(function(a, b) {
+        return b.verses - a.verses;
+    });
+    return chapters.slice(0, count);
+}
+
+var chapters = longest(args.chapters).map(function(chapter) {
+    chapter.response = phone.api.chapter(chapter.book, chapter.chapter);
+    return chapter;
+});
+
+// one round for the JIT to settle before anything counts
+chapters.forEach(function(chapter) {
+    timed(function() {
+        app.toUtf8Bytes(app.recordSlice(app.chapterRecord(chapter.response), 1, chapter.verses));
+        legacySlice(chapter.response, 1, chapter.verses);
+    });
+});
+
+var widths = [14, 7, 8, 10, 8, 9, 10, 9];
+console.log(harness.formatRow(['chapter', 'verses', 'range', 'before', 'slice', 'faster', 'to bytes', 'record'], widths));
+chapters.forEach(function(chapter) {
+    var response = chapter.response;
+    var record = app.chapterRecord(response);
+    var build = timed(function() {
+        app.chapterRecord(response);
+    });
+    var middle = Math.floor(chapter.verses / 2);
+    var ranges = [[1, chapter.verses], [middle - 4, middle + 5], [chapter.verses, chapter.verses]];
+    ranges.forEach(function(range, i) {
+        if (app.recordSlice(record, range[0], range[1]).split('\n').length !== range[1] - range[0] + 1) {
+            throw new Error('recordSlice() gave the wrong verses of ' + chapter.book + ' ' + chapter.chapter);
+        }
+        var before = timed(function() {
+            legacySlice(response, range[0], range[1]);
+        });
+        var slice = timed(function() {
+            app.recordSlice(record, range[0], range[1]);
+        });
+        var bytes = timed(function() {
+            app.toUtf8Bytes(app.recordSlice(record, range[0], range[1]));
+        });
+        console.log(harness.formatRow([i === 0 ? chapter.book + ' ' + chapter.chapter : '', i === 0 ? chapter.verses : '',
+            range[0] === range[1] ? range[0] : range[0] + '-' + range[1], (1000 * before).toFixed(2), (1000 * slice).toFixed(2),
+            Math.round(before / slice) + 'x', (1000 * bytes).toFixed(2), i === 0 ? (1000 * build).toFixed(1) : ''], widths));
+    });
+});
+console.log('record is the µs chapterRecord() takes once, when a chapter enters the cache');
@@ -0,0 +1,92 @@
+/*
+ * AppMessageTransport's adaptive window against fixed ones, stop-and-wait
+ * among them, over a lossy link. Each run reads --bytes of Psalms 119 as a
+ * single viewer request, so the reply is many messages, once to fetch and
+ * cache the chapter and once more to measure. Compression is off so the
+ * message count does not depend on how well the text packs.
+ *
+ *     node tools/js/bench-transport.js [--platform aplite] [--bytes 16384]
+ *         [--latency 40] [--mtu 158] [--packet 8] [--losses 0,0.01,0.05]
+ *         [--runs 5]
+ *
+ * Every cell is the mean over --runs link seeds: the time to the last
+ * message in simulated ms / messages sent beyond the ones needed / the
+ * window the transport ended on.
+ */
+var harness = require('./harness');
+
+var args = harness.parseArgs(process.argv.slice(2), {
+    platform: 'aplite', bytes: 16384, latency: 40, mtu: 158, packet: 8, losses: '0,0.01,0.05', runs: 5
+});
+var losses = args.losses.split(',').map(Number);
+
+var WINDOWS = [
+    {name: 'stop-and-wait', fixed: 1},
+    {name: 'fixed 2', fixed: 2},
+    {name: 'fixed 4', fixed: 4},
+    {name: 'fixed 8', fixed: 8},
+    {name: 'adaptive', fixed: 0}
+];
+
+function run(window, loss, seed) {
+    var phone = new harness.Phone({
+        platform: args.platform,
+        link: {latency: args.latency, mtu: args.mtu, packetMs: args.packet, loss: loss, seed: seed}
+    });
+    var transport = phone.app.transport;
+    if (window.fixed) {
+        // the config object is options.appMessage, shared with the app
+        transport.config.maxWindow = window.fixed;
+        transport.window = window.fixed;
+        var sampleRtt = transport.sampleRtt;
+        transport.sampleRtt = function(rtt) {
+            sampleRtt.call(transport, rtt);
+            transport.window = window.fixed;
+        };
+        var nacked = transport.nacked;
+        transport.nacked = function(entry, e) {
+            nacked.call(transport, entry, e);
+            transport.window = window.fixed;
+        };
+    }
+    phone.start({compression: 0});
+    var payload = {request: 2, book: 'Psalms', chapter: 119, range: '1-', offset: 0, length: args.bytes};
+    phone.request(payload);
+    phone.settle();
+    var sent = phone.link.stats.messagesOut;
+    var request = phone.request(payload);
+    return {
+        complete: request.last - request.sent,
+        extra: phone.link.stats.messagesOut - sent - request.messages,
+        window: transport.window,
+        failed: request.replies.length === 0 || !request.replies.some(function(reply) {
+            return reply.index === 0;
+        })
+    };
+}
+
+var widths = [14];
+var header = ['window'];
+for (var i = 0; i < losses.length; i++) {
+    widths.push(20);
+    header.push((losses[i] * 100) + '% loss');
+}
+console.log(args.platform + ', ' + args.bytes + ' bytes in one request, link ' + args.latency + ' ms latency, ' + args.mtu +
+    ' byte MTU, ' + args.packet + ' ms per packet, mean of ' + args.runs + ' runs');
+console.log(harness.formatRow(header, widths));
+for (var w = 0; w < WINDOWS.length; w++) {
+    var row = [WINDOWS[w].name];
+    for (var l = 0; l < losses.length; l++) {
+        var total = {complete: 0, extra: 0, window: 0, failed: 0};
+        for (var seed = 1; seed <= args.runs; seed++) {
+            var result = run(WINDOWS[w], losses[l], seed);
+            total.complete += result.complete;
+            total.extra += result.extra;
+            total.window += result.window;
+            total.failed += result.failed ? 1 : 0;
+        }
+        row.push(Math.round(total.complete / args.runs) + ' / ' + (total.extra / args.runs).toFixed(1) + ' / ' +
+            (total.window / args.runs).toFixed(1) + (total.failed ? ' !' + total.failed : ''));
+    }
+    console.log(harness.formatRow(row, widths));
+}
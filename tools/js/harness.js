@@ -0,0 +1,549 @@
+/*
+ * PebbleKit JS harness
+ * Runs js/*.js in a Node vm context the way the phone does: concatenated in
+ * the order wscript hands them to uglifyjs, after the generated tables, with
+ * the globals PebbleKit JS provides shimmed on a simulated clock. The bundle
+ * runs inside a function, globals of a vm context are slow to reach and
+ * would skew anything timed for real; its top level names are exported as
+ * Phone.app.
+ *
+ * - Pebble talks to a simulated watch over a Bluetooth link with latency,
+ *   an MTU, a time per packet and packet loss. A lost message is nacked
+ *   once the ack timeout runs out, a message bigger than the watch's inbox
+ *   is nacked the way the firmware drops it.
+ * - XMLHttpRequest is answered by MockApi after a latency plus the time
+ *   the body takes at a byte rate.
+ * - localStorage is a map with a quota, like the phone's.
+ *
+ * The watch end records every message per request token, see SimWatch.
+ */
+var fs = require('fs');
+var path = require('path');
+var vm = require('vm');
+var childProcess = require('child_process');
+var sim = require('./sim');
+var MockApi = require('./mock-api');
+
+var TOP = path.join(__dirname, '..', '..');
+
+var PLATFORMS = {
+    aplite: {inboxSize: 1024, rangeBytes: 2048, windowBytes: 1024, microphone: false},
+    basalt: {inboxSize: 4096, rangeBytes: 4096, windowBytes: 2048, microphone: true},
+    chalk: {inboxSize: 4096, rangeBytes: 4096, windowBytes: 2048, microphone: true}
+};
+
+// Bump together with PROTOCOL_VERSION in src/common.h
+var PROTOCOL_VERSION = 1;
+
+var DEFAULTS = {
+    platform: 'basalt',
+    link: {latency: 40, mtu: 158, packetMs: 8, loss: 0, ackTimeout: 1000, seed: 1},
+    http: {latency: 150, bytesPerMs: 50, failure: 0},
+    storageQuota: 5 * 1024 * 1024,
+    storage: null,
+    cpuScale: 0,
+    verbose: false
+};
+
+/*
+ * The app's source as the build bundles it, generating the tables first,
+ * as a function expression returning getters for its top level names
+ */
+function appSource() {
+    var python = process.env.PYTHON || 'python3';
+    childProcess.execFileSync(python, [path.join(TOP, 'tools', 'generate.py')], {cwd: TOP, stdio: 'ignore'});
+    var files = [path.join(TOP, 'build', 'generated', 'bible-data.js'), path.join(TOP, 'build', 'generated', 'lz-dictionary.js')];
+    var scripts = fs.readdirSync(path.join(TOP, 'js')).filter(function(name) {
+        return /\.js$/.test(name);
+    }).sort();
+    for (var i = 0; i < scripts.length; i++) {
+        files.push(path.join(TOP, 'js', scripts[i]));
+    }
+    var bundle = files.map(function(file) {
+        return fs.readFileSync(file, 'utf8');
+    }).join('\n;\n');
+    var names = [];
+    var declaration = /^(?:var|function)\s+([A-Za-z_$][\w$]*)/gm;
+    var match;
+    while ((match = declaration.exec(bundle)) !== null) {
+        if (names.indexOf(match[1]) < 0) {
+            names.push(match[1]);
+        }
+    }
+    return '(function() {\n' + bundle + '\n;\nreturn {' + names.map(function(name) {
+        return 'get ' + name + '() { return ' + name + '; }';
+    }).join(', ') + '};\n})()';
+}
+
+var source = null;
+
+function LocalStorage(quota, items) {
+
+    var map = new Map();
+    var bytes = 0;
+    this.writes = 0;
+    this.bytesWritten = 0;
+
+    this.getItem = function(key) {
+        return map.has(String(key)) ? map.get(String(key)) : null;
+    };
+
+    this.setItem = function(key, value) {
+        key = String(key);
+        value = String(value);
+        var grown = bytes - (map.has(key) ? key.length + map.get(key).length : 0) + key.length + value.length;
+        if (grown > quota) {
+            var error = new Error('QuotaExceededError');
+            error.name = 'QuotaExceededError';
+            throw error;
+        }
+        map.set(key, value);
+        bytes = grown;
+        this.writes++;
+        this.bytesWritten += key.length + value.length;
+    };
+
+    this.removeItem = function(key) {
+        key = String(key);
+        if (map.has(key)) {
+            bytes -= key.length + map.get(key).length;
+            map.delete(key);
+        }
+    };
+
+    this.key = function(index) {
+        var keys = Array.from(map.keys());
+        return index < keys.length ? keys[index] : null;
+    };
+
+    this.clear = function() {
+        map.clear();
+        bytes = 0;
+    };
+
+    /*
+     * Characters stored, keys included
+     */
+    this.bytes = function() {
+        return bytes;
+    };
+
+    /*
+     * Everything stored, to start another phone with
+     */
+    this.dump = function() {
+        var items = {};
+        map.forEach(function(value, key) {
+            items[key] = value;
+        });
+        return items;
+    };
+
+    Object.defineProperty(this, 'length', {
+        get: function() {
+            return map.size;
+        }
+    });
+
+    for (var key in items || {}) {
+        this.setItem(key, items[key]);
+    }
+    // what the phone starts with was not written by the app
+    this.writes = 0;
+    this.bytesWritten = 0;
+}
+
+/*
+ * Bytes a message takes in the watch's inbox, see dictSize() in
+ * js/transport.js
+ */
+function dictSize(message) {
+    var size = 1;
+    for (var key in message) {
+        var value = message[key];
+        size += 7;
+        if (typeof value === 'string') {
+            size += Buffer.byteLength(value) + 1;
+        } else if (Array.isArray(value)) {
+            // arrays made in the app's vm context are not instances of ours
+            size += value.length;
+        } else {
+            size += 4;
+        }
+    }
+    return size;
+}
+
+/*
+ * The watch end of the link. It keeps what arrived for every request
+ * token: when the first and last message came in, how many and how big.
+ */
+function SimWatch(phone, platform) {
+
+    this.platform = platform;
+    this.info = PLATFORMS[platform];
+    this.nextToken = 1;
+    this.requests = {};
+    this.received = [];
+    this.configured = false;
+
+    /*
+     * Send a request to the phone
+     * @return Returns the request's token
+     */
+    this.request = function(payload) {
+        var token = payload.token || this.nextToken++;
+        var message = {token: token};
+        for (var key in payload) {
+            message[key] = payload[key];
+        }
+        this.requests[token] = {
+            sent: phone.clock.now, first: -1, last: -1, messages: 0, bytes: 0, end: false, error: null, replies: []
+        };
+        phone.link.toPhone(message);
+        return token;
+    };
+
+    this.receive = function(message) {
+        this.received.push({time: phone.clock.now, message: message});
+        if (message.messageType === 5) {
+            // PebbleJSInitialized, answer with the handshake
+            if (!this.configured) {
+                this.configured = true;
+                this.request(phone.configure());
+            }
+            return;
+        }
+        var request = this.requests[message.token];
+        if (!request) {
+            return;
+        }
+        if (request.first < 0) {
+            request.first = phone.clock.now;
+        }
+        request.last = phone.clock.now;
+        request.messages++;
+        request.bytes += dictSize(message);
+        request.end = request.end || message.end === 1;
+        request.error = message.error || request.error;
+        request.replies.push(message);
+    };
+
+}
+
+/*
+ * The Bluetooth link between the phone and the watch, one packet on the air
+ * at a time each way
+ */
+function SimLink(phone, config) {
+
+    var random = new sim.Random(config.seed);
+    var downFree = 0;
+    var upFree = 0;
+    this.stats = {messagesOut: 0, bytesOut: 0, packetsOut: 0, lost: 0, overflows: 0, messagesIn: 0, bytesIn: 0};
+
+    this.airtime = function(size) {
+        return Math.ceil(size / config.mtu) * config.packetMs;
+    };
+
+    this.lost = function(size) {
+        for (var i = 0; i < Math.ceil(size / config.mtu); i++) {
+            if (random.next() < config.loss) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    /*
+     * Pebble.sendAppMessage()
+     */
+    this.toWatch = function(message, ack, nack) {
+        var clock = phone.clock;
+        var size = dictSize(message);
+        var start = Math.max(clock.now, downFree);
+        downFree = start + this.airtime(size);
+        this.stats.messagesOut++;
+        this.stats.bytesOut += size;
+        this.stats.packetsOut += Math.ceil(size / config.mtu);
+        var copy = JSON.parse(JSON.stringify(message));
+        var failed = function(error) {
+            if (nack) {
+                nack({data: {transactionId: -1}, error: {message: error}});
+            }
+        };
+        if (this.lost(size)) {
+            this.stats.lost++;
+            clock.schedule(downFree + config.ackTimeout - clock.now, function() {
+                failed('APP_MSG_SEND_TIMEOUT');
+            });
+        } else if (size > phone.watch.info.inboxSize) {
+            this.stats.overflows++;
+            clock.schedule(downFree + 2 * config.latency - clock.now, function() {
+                failed('APP_MSG_BUFFER_OVERFLOW');
+            });
+        } else {
+            clock.schedule(downFree + config.latency - clock.now, function() {
+                phone.watch.receive(copy);
+                clock.schedule(config.latency, function() {
+                    if (ack) {
+                        ack({data: {transactionId: -1}});
+                    }
+                });
+            });
+        }
+    };
+
+    /*
+     * A message from the watch, dispatched as an appmessage event
+     */
+    this.toPhone = function(message) {
+        var clock = phone.clock;
+        var size = dictSize(message);
+        var start = Math.max(clock.now, upFree);
+        upFree = start + this.airtime(size);
+        this.stats.messagesIn++;
+        this.stats.bytesIn += size;
+        clock.schedule(upFree + config.latency - clock.now, function() {
+            phone.dispatch('appmessage', {payload: message});
+        });
+    };
+
+}
+
+/*
+ * A phone running the app, see DEFAULTS for the configuration
+ * @param config Overrides of DEFAULTS, link and http merge key by key
+ */
+function Phone(config) {
+
+    config = merge(DEFAULTS, config || {});
+    var self = this;
+    this.config = config;
+    this.clock = new sim.Clock();
+    this.clock.cpuScale = config.cpuScale;
+    this.api = new MockApi();
+    this.localStorage = new LocalStorage(config.storageQuota, config.storage);
+    this.link = new SimLink(this, config.link);
+    this.watch = new SimWatch(this, config.platform);
+    this.listeners = {};
+    this.notifications = 0;
+    this.httpStats = {requests: 0, bytes: 0, failures: 0};
+    this.handshake = {};
+
+    var random = new sim.Random(config.link.seed + 1);
+    var clock = this.clock;
+
+    var Pebble = {
+        addEventListener: function(type, listener) {
+            (self.listeners[type] = self.listeners[type] || []).push(listener);
+        },
+        sendAppMessage: function(message, ack, nack) {
+            self.link.toWatch(message, ack, nack);
+        },
+        showSimpleNotificationOnPebble: function(title, body) {
+            self.notifications++;
+        }
+    };
+
+    var XMLHttpRequest = function() {
+        this.readyState = 0;
+        this.status = 0;
+        this.responseText = '';
+        this.timeout = 0;
+    };
+    XMLHttpRequest.prototype.open = function(method, url) {
+        this.method = method;
+        this.url = url;
+        this.readyState = 1;
+    };
+    XMLHttpRequest.prototype.send = function(body) {
+        var xhr = this;
+        var response = self.api.handle(this.url);
+        var delay = config.http.latency + Buffer.byteLength(response.body) / config.http.bytesPerMs;
+        self.httpStats.requests++;
+        if (random.next() < config.http.failure) {
+            self.httpStats.failures++;
+            clock.schedule(config.http.latency, function() {
+                if (xhr.onerror) {
+                    xhr.onerror();
+                }
+            });
+            return;
+        }
+        if (this.timeout && delay > this.timeout) {
+            self.httpStats.failures++;
+            clock.schedule(this.timeout, function() {
+                if (xhr.ontimeout) {
+                    xhr.ontimeout();
+                }
+            });
+            return;
+        }
+        clock.schedule(delay, function() {
+            self.httpStats.bytes += Buffer.byteLength(response.body);
+            xhr.readyState = 4;
+            xhr.status = response.status;
+            xhr.responseText = response.body;
+            if (xhr.onload) {
+                xhr.onload({});
+            }
+        });
+    };
+
+    // the app only ever asks for Date.now()
+    var SimDate = function() {
+        return new Date(clock.now);
+    };
+    SimDate.now = function() {
+        return Math.floor(clock.now);
+    };
+
+    var quiet = function() {};
+    var context = vm.createContext({
+        Pebble: Pebble,
+        XMLHttpRequest: XMLHttpRequest,
+        localStorage: this.localStorage,
+        Date: SimDate,
+        setTimeout: function(fn, delay) {
+            return clock.schedule(delay, fn);
+        },
+        clearTimeout: function(id) {
+            clock.cancel(id);
+        },
+        console: config.verbose ? console : {log: quiet, warn: quiet, error: quiet}
+    });
+    source = source || appSource();
+    this.app = vm.runInContext(source, context, {filename: 'pebble-js-app.js'});
+
+    /*
+     * The Configure request the watch answers PebbleJSInitialized with
+     */
+    this.configure = function() {
+        var info = this.watch.info;
+        var payload = {
+            request: this.app.Request.Configure,
+            inboxSize: info.inboxSize,
+            compression: 1,
+            rangeBytes: info.rangeBytes,
+            version: PROTOCOL_VERSION,
+            platform: config.platform,
+            outboxSize: 256
+        };
+        for (var key in this.handshake) {
+            payload[key] = this.handshake[key];
+        }
+        return payload;
+    };
+
+    this.dispatch = function(type, event) {
+        var listeners = this.listeners[type] || [];
+        for (var i = 0; i < listeners.length; i++) {
+            this.clock.call(listeners[i].bind(null, event));
+        }
+    };
+
+    /*
+     * Launch: the ready event and the handshake, settled
+     * @param handshake Extra Configure fields, e.g. the reopened passage
+     */
+    this.start = function(handshake) {
+        this.handshake = handshake || {};
+        this.clock.schedule(0, function() {
+            self.dispatch('ready', {});
+        });
+        this.settle();
+    };
+
+    /*
+     * Send a request from the watch and run until it is answered in full:
+     * the app hands all of a reply to the transport at once, so that is
+     * when something has arrived and the transport is idle again. A request
+     * that is never answered runs until nothing is left to do.
+     * @return Returns the watch's record of the request, with its token
+     */
+    this.request = function(payload) {
+        var token = this.watch.request(payload);
+        var request = this.watch.requests[token];
+        this.clock.run(function() {
+            return request.error !== null || (request.messages > 0 && self.app.transport.isIdle());
+        });
+        request.token = token;
+        return request;
+    };
+
+    /*
+     * Run until nothing is due within settle ms, 10 s by default
+     */
+    this.settle = function(settle) {
+        this.clock.run(null, settle || 10000);
+    };
+
+    /*
+     * Everything the app stored, to start another phone with
+     */
+    this.storage = function() {
+        this.settle(5 * 60 * 1000);
+        return this.localStorage.dump();
+    };
+
+}
+
+function merge(defaults, overrides) {
+    var merged = {};
+    for (var key in defaults) {
+        merged[key] = defaults[key];
+    }
+    for (key in overrides) {
+        if (defaults[key] !== null && typeof defaults[key] === 'object' && typeof overrides[key] === 'object') {
+            merged[key] = merge(defaults[key], overrides[key]);
+        } else {
+            merged[key] = overrides[key];
+        }
+    }
+    return merged;
+}
+
+/*
+ * Command line options of the form --name value, numbers where they parse
+ * @param names Object of the accepted names and their defaults
+ */
+function parseArgs(argv, names) {
+    var args = merge(names, {});
+    args._ = [];
+    for (var i = 0; i < argv.length; i++) {
+        var match = /^--(.+)$/.exec(argv[i]);
+        if (match === null) {
+            args._.push(argv[i]);
+        } else if (!names.hasOwnProperty(match[1])) {
+            throw new Error('Unknown option ' + argv[i] + ', expected one of --' + Object.keys(names).join(', --'));
+        } else if (typeof names[match[1]] === 'boolean') {
+            args[match[1]] = true;
+        } else if (typeof names[match[1]] === 'number') {
+            args[match[1]] = Number(argv[++i]);
+        } else {
+            args[match[1]] = argv[++i];
+        }
+    }
+    return args;
+}
+
+/*
+ * Right aligned table columns
+ */
+function formatRow(cells, widths) {
+    return cells.map(function(cell, i) {
+        var text = typeof cell === 'number' ? (Number.isInteger(cell) ? cell.toString() : cell.toFixed(1)) : String(cell);
+        return i === 0 ? (text + new Array(widths[0] + 1).join(' ')).substring(0, widths[0]) :
+            (new Array(widths[i] + 1).join(' ') + text).slice(-widths[i]);
+    }).join(' ');
+}
+
+module.exports = {
+    Phone: Phone,
+    PLATFORMS: PLATFORMS,
+    DEFAULTS: DEFAULTS,
+    dictSize: dictSize,
+    parseArgs: parseArgs,
+    formatRow: formatRow
+};
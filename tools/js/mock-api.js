@@ -0,0 +1,157 @@
+/*
+ * Stand-in for labs.bible.org
+ * Answers passage queries the way the API does, as a JSON array of
+ * {bookname, chapter, verse, text} objects, over fixture chapters: every
+ * verse of data/bible.json gets a line of made-up words picked by a hash of
+ * the verse, the same words tools/host/phone.c makes up for the watch. Also
+ * serves the whole fixture Bible as an offline pack, see OfflineProvider.
+ *
+ *     node tools/js/mock-api.js [port]
+ *
+ * runs it as an HTTP server, /api/?passage=...&type=json and /pack.json.
+ */
+var fs = require('fs');
+var path = require('path');
+
+var WORDS = [
+    'and', 'the', 'LORD', 'said', 'unto', 'him', 'in', 'of', 'that', 'his', 'was', 'upon', 'all', 'them',
+    'they', 'shall', 'be', 'for', 'thou', 'not', 'with', 'which', 'God', 'is', 'earth', 'heaven', 'people',
+    'land', 'day', 'son', 'house', 'king', 'Israel', 'were', 'from', 'went', 'came', 'before', 'hand',
+    'Jacob’s', '“Behold”', 'righteousness', 'commandments', 'therefore'
+];
+
+/*
+ * @param books Array of {name, testament, verses} from data/bible.json,
+ *              read from the repository when left out
+ */
+function MockApi(books) {
+
+    this.books = books || JSON.parse(fs.readFileSync(path.join(__dirname, '..', '..', 'data', 'bible.json'), 'utf8'));
+    this.requests = 0;
+    this.bytesServed = 0;
+
+    this.bookIndex = function(name) {
+        for (var i = 0; i < this.books.length; i++) {
+            if (this.books[i].name === name) {
+                return i;
+            }
+        }
+        return -1;
+    };
+
+    /*
+     * Text of a verse, without the verse number
+     */
+    this.verseText = function(book, chapter, verse) {
+        var state = Math.imul(((book + 1) * 151 + chapter) * 211 + verse, 2654435761) >>> 0;
+        var prefix = verse + ') ';
+        var target = 60 + (state >>> 8) % 140;
+        var length = prefix.length;
+        var text = '';
+        while (length < target) {
+            state = (state ^ (state << 13)) >>> 0;
+            state = (state ^ (state >>> 17)) >>> 0;
+            state = (state ^ (state << 5)) >>> 0;
+            var word = WORDS[state % WORDS.length];
+            if (text.length === 0) {
+                word = word.charAt(0).toUpperCase() + word.substring(1);
+            } else {
+                word = ' ' + word;
+            }
+            text += word;
+            length += Buffer.byteLength(word);
+        }
+        return text + '.';
+    };
+
+    /*
+     * Verses of a chapter as the API returns them, or null if there is no
+     * such chapter
+     */
+    this.chapter = function(name, chapter) {
+        var book = this.bookIndex(name);
+        if (book < 0 || chapter < 1 || chapter > this.books[book].verses.length) {
+            return null;
+        }
+        var verses = [];
+        for (var verse = 1; verse <= this.books[book].verses[chapter - 1]; verse++) {
+            verses.push({
+                bookname: name,
+                chapter: chapter.toString(),
+                verse: verse.toString(),
+                text: this.verseText(book, chapter, verse)
+            });
+        }
+        return verses;
+    };
+
+    /*
+     * Answer a request
+     * @param url Full URL or path and query
+     * @return Returns {status, body}
+     */
+    this.handle = function(url) {
+        var parsed = new URL(url, 'http://labs.bible.org');
+        var response = {status: 404, body: ''};
+        if (/\/pack\.json$/.test(parsed.pathname)) {
+            response = {status: 200, body: JSON.stringify(this.pack())};
+        } else if (/^\/api\/?$/.test(parsed.pathname)) {
+            response = this.passage(parsed.searchParams.get('passage') || '');
+        }
+        this.requests++;
+        this.bytesServed += Buffer.byteLength(response.body);
+        return response;
+    };
+
+    /*
+     * A passage query: "<book> <chapter>" or "<book> <first>-<last>"
+     */
+    this.passage = function(passage) {
+        var match = /^(.+) (\d+)(?:-(\d+))?$/.exec(passage);
+        if (match === null) {
+            return {status: 400, body: ''};
+        }
+        var first = parseInt(match[2], 10);
+        var last = match[3] ? parseInt(match[3], 10) : first;
+        var verses = [];
+        for (var chapter = first; chapter <= last; chapter++) {
+            verses = verses.concat(this.chapter(match[1], chapter) || []);
+        }
+        return {status: 200, body: JSON.stringify(verses)};
+    };
+
+    /*
+     * The whole fixture Bible as an offline pack
+     */
+    this.pack = function() {
+        var pack = [];
+        for (var book = 0; book < this.books.length; book++) {
+            var chapters = [];
+            for (var chapter = 1; chapter <= this.books[book].verses.length; chapter++) {
+                var texts = [];
+                for (var verse = 1; verse <= this.books[book].verses[chapter - 1]; verse++) {
+                    texts.push(this.verseText(book, chapter, verse));
+                }
+                chapters.push(texts);
+            }
+            pack.push({name: this.books[book].name, chapters: chapters});
+        }
+        return pack;
+    };
+
+}
+
+module.exports = MockApi;
+
+if (require.main === module) {
+    var http = require('http');
+    var api = new MockApi();
+    var port = parseInt(process.argv[2], 10) || 8080;
+    http.createServer(function(request, response) {
+        var answer = api.handle(request.url);
+        response.writeHead(answer.status, {'Content-Type': 'application/json; charset=utf-8'});
+        response.end(answer.body);
+    }).listen(port, function() {
+        console.log('Serving fixture passages on http://localhost:' + port + '/api/?passage=Genesis%201&type=json');
+    });
+}
@@ -0,0 +1,115 @@
+/*
+ * Simulated time
+ * Events run in time order on a virtual clock, so a session that takes
+ * minutes on a phone runs in milliseconds and the same way every time.
+ * Nothing here waits on the real clock.
+ */
+function Clock() {
+
+    var base = 0;
+    var started = null;
+    this.events = [];
+    this.nextId = 1;
+    // real milliseconds of handler work are charged to the clock times this
+    this.cpuScale = 0;
+
+    /*
+     * Simulated ms, moving on while a handler runs when cpuScale is set, so
+     * what the handler sends leaves after the work done before it
+     */
+    Object.defineProperty(this, 'now', {
+        get: function() {
+            return started === null ? base : base + elapsed(started) * this.cpuScale;
+        }
+    });
+
+    /*
+     * Run fn delay simulated ms from now, after everything already due then
+     * @return Returns an id for cancel()
+     */
+    this.schedule = function(delay, fn) {
+        var event = {time: this.now + Math.max(0, delay || 0), id: this.nextId++, fn: fn};
+        var i = this.events.length;
+        while (i > 0 && this.events[i - 1].time > event.time) {
+            i--;
+        }
+        this.events.splice(i, 0, event);
+        return event.id;
+    };
+
+    this.cancel = function(id) {
+        for (var i = 0; i < this.events.length; i++) {
+            if (this.events[i].id === id) {
+                this.events.splice(i, 1);
+                return;
+            }
+        }
+    };
+
+    /*
+     * Time of the next event, or Infinity if nothing is scheduled
+     */
+    this.nextTime = function() {
+        return this.events.length > 0 ? this.events[0].time : Infinity;
+    };
+
+    this.runNext = function() {
+        var event = this.events.shift();
+        base = Math.max(base, event.time);
+        this.call(event.fn);
+    };
+
+    /*
+     * Call fn now, charging its real running time when cpuScale is set
+     */
+    this.call = function(fn) {
+        if (!this.cpuScale || started !== null) {
+            fn();
+            return;
+        }
+        started = process.hrtime();
+        try {
+            fn();
+        } finally {
+            base = this.now;
+            started = null;
+        }
+    };
+
+    /*
+     * Run events until done() holds, nothing is due within settle ms or the
+     * clock passes limit ms from now
+     */
+    this.run = function(done, settle, limit) {
+        var until = this.now + (limit || 10 * 60 * 1000);
+        settle = settle || Infinity;
+        while (!(done && done()) && this.nextTime() <= Math.min(until, this.now + settle)) {
+            this.runNext();
+        }
+    };
+
+}
+
+function elapsed(started) {
+    var time = process.hrtime(started);
+    return time[0] * 1e3 + time[1] / 1e6;
+}
+
+/*
+ * Seeded pseudo random numbers in [0, 1), the same sequence for a seed
+ */
+function Random(seed) {
+
+    var state = seed >>> 0 || 1;
+
+    this.next = function() {
+        state = (state + 0x6D2B79F5) >>> 0;
+        var t = state;
+        t = Math.imul(t ^ (t >>> 15), t | 1);
+        t ^= t + Math.imul(t ^ (t >>> 7), t | 61);
+        return ((t ^ (t >>> 14)) >>> 0) / 4294967296;
+    };
+
+}
+
+module.exports = {Clock: Clock, Random: Random};